@@ -6,16 +6,28 @@
 CPP_SRCS += \
 ../include/Controller/basic.cpp \
 ../include/Controller/lqr.cpp \
+../include/Controller/lqrTuner.cpp \
+../include/Controller/mpc.cpp \
+../include/Controller/registry.cpp \
+../include/Controller/swingUp.cpp \
 ../include/Controller/velocity.cpp 
 
 OBJS += \
 ./include/Controller/basic.o \
 ./include/Controller/lqr.o \
+./include/Controller/lqrTuner.o \
+./include/Controller/mpc.o \
+./include/Controller/registry.o \
+./include/Controller/swingUp.o \
 ./include/Controller/velocity.o 
 
 CPP_DEPS += \
 ./include/Controller/basic.d \
 ./include/Controller/lqr.d \
+./include/Controller/lqrTuner.d \
+./include/Controller/mpc.d \
+./include/Controller/registry.d \
+./include/Controller/swingUp.d \
 ./include/Controller/velocity.d 
 
 
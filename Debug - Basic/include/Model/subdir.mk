@@ -0,0 +1,33 @@
+################################################################################
+# Automatically-generated file. Do not edit!
+################################################################################
+
+# Add inputs and outputs from these tool invocations to the build variables 
+CPP_SRCS += \
+../include/Model/dare.cpp \
+../include/Model/kalman.cpp \
+../include/Model/pendulumBatch.cpp \
+../include/Model/pendulumModel.cpp \
+../include/Model/pendulumSim.cpp 
+OBJS += \
+./include/Model/dare.o \
+./include/Model/kalman.o \
+./include/Model/pendulumBatch.o \
+./include/Model/pendulumModel.o \
+./include/Model/pendulumSim.o 
+CPP_DEPS += \
+./include/Model/dare.d \
+./include/Model/kalman.d \
+./include/Model/pendulumBatch.d \
+./include/Model/pendulumModel.d \
+./include/Model/pendulumSim.d 
+
+# Each subdirectory must supply rules for building sources it contributes
+include/Model/%.o: ../include/Model/%.cpp
+	@echo 'Building file: $<'
+	@echo 'Invoking: Cross G++ Compiler'
+	arm-linux-gnueabihf-g++ -std=c++0x -I"/home/troy/workspace/pendulum/include" -I/usr/arm-linux-gnueabihf/include/c++/4.7.2 -O0 -g3 -Wall -c -fmessage-length=0 -pthread -fPIC -MMD -MP -MF"$(@:%.o=%.d)" -MT"$(@:%.o=%.d)" -o "$@" "$<"
+	@echo 'Finished building: $<'
+	@echo ' '
+
+
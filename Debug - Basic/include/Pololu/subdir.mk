@@ -4,13 +4,22 @@
 
 # Add inputs and outputs from these tool invocations to the build variables 
 CPP_SRCS += \
-../include/Pololu/pololuSMC.cpp 
+../include/Pololu/commandChannel.cpp \
+../include/Pololu/pololuSMC.cpp \
+../include/Pololu/smcEmulator.cpp \
+../include/Pololu/telemetryPoller.cpp 
 
 OBJS += \
-./include/Pololu/pololuSMC.o 
+./include/Pololu/commandChannel.o \
+./include/Pololu/pololuSMC.o \
+./include/Pololu/smcEmulator.o \
+./include/Pololu/telemetryPoller.o 
 
 CPP_DEPS += \
-./include/Pololu/pololuSMC.d 
+./include/Pololu/commandChannel.d \
+./include/Pololu/pololuSMC.d \
+./include/Pololu/smcEmulator.d \
+./include/Pololu/telemetryPoller.d 
 
 
 # Each subdirectory must supply rules for building sources it contributes
@@ -4,13 +4,16 @@
 
 # Add inputs and outputs from these tool invocations to the build variables 
 CPP_SRCS += \
-../include/bbb-eqep/bbb-eqep.cpp 
+../include/bbb-eqep/bbb-eqep.cpp \
+../include/bbb-eqep/eqep-sim.cpp 
 
 OBJS += \
-./include/bbb-eqep/bbb-eqep.o 
+./include/bbb-eqep/bbb-eqep.o \
+./include/bbb-eqep/eqep-sim.o 
 
 CPP_DEPS += \
-./include/bbb-eqep/bbb-eqep.d 
+./include/bbb-eqep/bbb-eqep.d \
+./include/bbb-eqep/eqep-sim.d 
 
 
 # Each subdirectory must supply rules for building sources it contributes
@@ -23,8 +23,8 @@ CPP_DEPS :=
 
 # Every subdirectory with source files must be described here
 SUBDIRS := \
-include/BlackLib/BlackADC \
 include/BlackLib \
+include/BlackLib/BlackADC \
 include/BlackLib/BlackDirectory \
 include/BlackLib/BlackGPIO \
 include/BlackLib/BlackI2C \
@@ -35,6 +35,7 @@ include/BlackLib/BlackThread \
 include/BlackLib/BlackTime \
 include/BlackLib/BlackUART \
 include/Controller \
+include/Model \
 include/Pololu \
 include/SSD1306 \
 include/bbb-eqep \
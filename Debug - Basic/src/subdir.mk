@@ -4,19 +4,31 @@
 
 # Add inputs and outputs from these tool invocations to the build variables 
 CPP_SRCS += \
+../src/controlPipeline.cpp \
+../src/multiEQEP.cpp \
 ../src/overlays.cpp \
 ../src/pendulum.cpp \
-../src/threadedEQEP.cpp 
+../src/periodicScheduler.cpp \
+../src/positionUnwrapper.cpp \
+../src/velocityEstimator.cpp 
 
 OBJS += \
+./src/controlPipeline.o \
+./src/multiEQEP.o \
 ./src/overlays.o \
 ./src/pendulum.o \
-./src/threadedEQEP.o 
+./src/periodicScheduler.o \
+./src/positionUnwrapper.o \
+./src/velocityEstimator.o 
 
 CPP_DEPS += \
+./src/controlPipeline.d \
+./src/multiEQEP.d \
 ./src/overlays.d \
 ./src/pendulum.d \
-./src/threadedEQEP.d 
+./src/periodicScheduler.d \
+./src/positionUnwrapper.d \
+./src/velocityEstimator.d 
 
 
 # Each subdirectory must supply rules for building sources it contributes
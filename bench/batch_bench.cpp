@@ -0,0 +1,132 @@
+/**
+ *! @file batch_bench.cpp
+ *! Grid search of the control law gains on the batch pendulum simulator
+ *!
+ *! @author Troy Dack
+ *! @date Copyright (C) 2015
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ **/
+
+/*
+ * Simulates one pendulum for every point of a grid of pendulum and arm
+ * gains, the sweep the data/kp_*.csv runs did one experiment at a time.
+ * The grid is run with 1, 2, 4... up to the given number of threads to show
+ * the throughput in instance steps per second, then the gains that kept the
+ * pendulum up are ranked by the integral of the squared angles.  The LQR
+ * gains for the same parameters, in the same units, are printed to compare.
+ * Build from the repository root:
+ *
+ *   SRC="bench/batch_bench.cpp include/Model/pendulumBatch.cpp include/Model/pendulumSim.cpp \
+ *        include/Model/pendulumModel.cpp include/Model/dare.cpp include/bbb-eqep/eqep-sim.cpp \
+ *        include/bbb-eqep/bbb-eqep.cpp src/periodicScheduler.cpp \
+ *        include/BlackLib/BlackThread/BlackThread.cpp"
+ *   g++ -std=c++11 -O3 -fno-trapping-math -Iinclude -o batch_bench $SRC -pthread
+ *   ./batch_bench [threads] [seconds]
+ *
+ * -fno-trapping-math lets the compiler turn the kernels' comparisons into
+ * vector selects.  On the BeagleBone use -mfpu=neon -mfloat-abi=hard
+ * -funsafe-math-optimizations instead, NEON is not IEEE compliant so GCC
+ * only uses it for float when allowed to be unsafe.
+ */
+
+#include <Model/pendulumBatch.h>
+#include <Model/dare.h>
+#include <controlPipeline.h>
+#include <pendulum.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+const int KP_STEPS = 24;
+const int KD_STEPS = 16;
+const int ARM_KP_STEPS = 8;
+const int ARM_KD_STEPS = 8;
+const double ARM_WEIGHT = 0.01;	// arm angle weight in the ranking, as lqrWeights: (0.05 / 0.5)^2
+
+/*!
+ * @brief Gains of grid point i
+ */
+Model::batchGains gridGains(int i) {
+	Model::batchGains g = Model::batchGains();
+	g.armKd = -80.0 * (i % ARM_KD_STEPS);
+	i /= ARM_KD_STEPS;
+	g.armKp = -80.0 * (i % ARM_KP_STEPS);
+	i /= ARM_KP_STEPS;
+	g.kd = 60.0 * (i % KD_STEPS);
+	i /= KD_STEPS;
+	g.kp = 500.0 * (i + 1);
+	return g;
+}
+
+void startGrid(Model::pendulumBatch& batch) {
+	stateVector x0 = stateVector::zeros();
+	x0[0] = 0.1;
+	x0[1] = 0.3;
+	for (int i = 0; i < batch.size(); i++) {
+		batch.setGains(i, gridGains(i));
+		batch.reset(i, x0);
+	}
+}
+
+int main(int argc, char* argv[]) {
+	int maxThreads = (argc > 1) ? atoi(argv[1]) : 4;
+	double seconds = (argc > 2) ? atof(argv[2]) : 5;
+	int n = KP_STEPS * KD_STEPS * ARM_KP_STEPS * ARM_KD_STEPS;
+
+	Model::pendulumBatch batch(n, Model::measuredParameters());
+	batch.setSampleTime(SAMPLE_TIME);
+	printf("%d instances, %.0fs each, %dms sample time, %d steps per sample\n", n, seconds, SAMPLE_TIME,
+		   (int)(SAMPLE_TIME / 1000.0 / Model::SIM_STEP + 0.5));
+	printf("threads   wall s   instance steps/s   x real time\n");
+	for (int threads = 1; threads <= std::max(1, maxThreads); threads *= 2) {
+		startGrid(batch);
+		uint64_t before = batch.steps();
+		uint64_t start = monotonicNow();
+		batch.run(seconds, threads);
+		double wall = (monotonicNow() - start) / 1e9;
+		printf("%7d %8.2f %18.3g %13.0f\n", threads, wall, (batch.steps() - before) / wall, n * seconds / wall);
+	}
+
+	std::vector<std::pair<double, int> > ranked;
+	for (int i = 0; i < n; i++) {
+		Model::batchResult r = batch.result(i);
+		if (!r.fell) {
+			ranked.push_back(std::make_pair(r.cost + ARM_WEIGHT * r.armCost, i));
+		}
+	}
+	std::sort(ranked.begin(), ranked.end());
+	printf("\n%d of %d kept the pendulum up\n", (int)ranked.size(), n);
+	printf("     kp      kd   arm kp  arm kd      cost  max angle  max arm\n");
+	printf("                                            deg        rad\n");
+	for (size_t k = 0; k < std::min<size_t>(10, ranked.size()); k++) {
+		int i = ranked[k].second;
+		Model::batchGains g = gridGains(i);
+		Model::batchResult r = batch.result(i);
+		printf("%7.0f %7.0f %8.0f %7.0f %9.6f %10.2f %8.2f\n", g.kp, g.kd, g.armKp, g.armKd, ranked[k].first,
+			   r.maxAngle * 180 / M_PI, r.maxArm);
+	}
+
+	// u = -K x in volts, as the batch law in speed units
+	Model::gainVector K;
+	if (Model::designLQR(Model::pendulumModel(Model::measuredParameters()), SAMPLE_TIME / 1000.0,
+						 Model::lqrWeights(), K)) {
+		double s = Pololu::SMC_MAX_SPEED / 11.7;
+		printf("lqr     %7.0f %7.0f %8.0f %7.0f\n", K[0] * s, K[2] * s, K[1] * s, K[3] * s);
+	}
+	return 0;
+}
@@ -0,0 +1,158 @@
+/**
+ *! @file controller_bench.cpp
+ *! Cost and accuracy of the control laws in double and fixed point
+ *!
+ *! @author Troy Dack
+ *! @date Copyright (C) 2015
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ **/
+
+/*
+ * Runs the PID, velocity and LQR laws over the same pseudo random sequence
+ * of pendulum states and reports the time each step takes.  The double build
+ * writes its outputs to a reference file and the fixed point build compares
+ * its outputs with them, so build it both ways from the repository root:
+ *
+ *   SRC="bench/controller_bench.cpp include/Controller/basic.cpp include/Controller/velocity.cpp \
+ *        include/Controller/lqr.cpp include/Model/kalman.cpp include/Model/pendulumModel.cpp \
+ *        include/Model/dare.cpp src/periodicScheduler.cpp include/BlackLib/BlackThread/BlackThread.cpp"
+ *   g++ -std=c++11 -O2 -Iinclude -o controller_bench $SRC -pthread
+ *   g++ -std=c++11 -O2 -Iinclude -DCONTROLLER_FIXED_POINT=16 -o controller_bench_fixed $SRC -pthread
+ *   ./controller_bench reference.bin && ./controller_bench_fixed reference.bin
+ *
+ * On the BeagleBone add -mfpu=neon -mfloat-abi=hard.  Tick times include
+ * publishing the state, step times are the control law alone.  Times are
+ * converted to cycles at the clock given as the second argument, in MHz,
+ * default 1000.
+ */
+
+#include <Controller/basic.h>
+#include <Controller/velocity.h>
+#include <Controller/lqr.h>
+#include <pendulum.h>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+const int SAMPLES = 20000;
+const int LAWS = 3;
+const double OUTPUT_LIMIT = 3200;
+
+/*!
+ * @brief Smooth random states around upright, every few hundred pushed far enough to saturate
+ */
+std::vector<pendulumState> makeStates() {
+	std::mt19937 rng(1);
+	std::uniform_real_distribution<double> step(-1, 1);
+	std::vector<pendulumState> states(SAMPLES);
+	pendulumState x = pendulumState();
+	for (int k = 0; k < SAMPLES; k++) {
+		x.pAngle = 0.98 * x.pAngle + 0.01 * step(rng);
+		x.mAngle = 0.99 * x.mAngle + 0.05 * step(rng);
+		x.pVelocity = 0.9 * x.pVelocity + 0.3 * step(rng);
+		x.mVelocity = 0.9 * x.mVelocity + 1.0 * step(rng);
+		states[k] = x;
+		if (k % 500 == 499) {
+			states[k].pAngle *= 10;
+		}
+	}
+	return states;
+}
+
+int main(int argc, char* argv[]) {
+	const char* reference = (argc > 1) ? argv[1] : NULL;
+	double mhz = (argc > 2) ? atof(argv[2]) : 1000;
+#ifdef CONTROLLER_FIXED_POINT
+	printf("fixed point, %d fractional bits\n", CONTROLLER_FIXED_POINT);
+#else
+	printf("double\n");
+#endif
+
+	pendulumStateBuffer state;
+	std::atomic<double> output(0);
+	double setPoint = 0;
+	Controller::controllerTask* laws[LAWS];
+	laws[0] = new Controller::basic(&state, &output, &setPoint, 8000, 2000, 400, 0);
+	laws[1] = new Controller::velocity(&state, &output, &setPoint, 60, 2, 4, 0);
+	laws[2] = new Controller::lqr(&state, &output, &setPoint, Model::pendulumParameters(), Model::lqrWeights(), 0);
+
+	// Laws built with CONTROLLER_TRACE log every step to std::cout, keep that out of the times
+	std::cout.setstate(std::ios::failbit);
+
+	std::vector<pendulumState> states = makeStates();
+	std::vector<double> outputs(LAWS * SAMPLES);
+	printf("          tick mean  step p99  step max   tick mean   step max\n");
+	printf("law              ns        ns        ns      cycles     cycles\n");
+	for (int l = 0; l < LAWS; l++) {
+		Controller::controllerTask* c = laws[l];
+		c->SetOutputLimits(-OUTPUT_LIMIT, OUTPUT_LIMIT);
+		c->SetSampleTime(SAMPLE_TIME);
+		state.publish(states[0]);
+		c->SetMode(1);
+		tickInfo info = tickInfo();
+		info.dt = SAMPLE_TIME / 1000.0;
+		uint64_t start = monotonicNow();
+		for (int k = 0; k < SAMPLES; k++) {
+			state.publish(states[k]);
+			info.tick = k;
+			c->tick(info);
+			outputs[l * SAMPLES + k] = output.load();
+		}
+		double mean = (double)(monotonicNow() - start) / SAMPLES;
+		const latencyHistogram& steps = c->GetStepTimes();
+		printf("%-8s %10.0f %9lld %9lld %11.0f %10.0f\n", c->name().c_str(), mean,
+			   (long long)steps.percentile(0.99), (long long)steps.max(),
+			   mean * mhz / 1000, steps.max() * mhz / 1000);
+	}
+
+	if (reference == NULL) {
+		return 0;
+	}
+#ifdef CONTROLLER_FIXED_POINT
+	FILE* in = fopen(reference, "rb");
+	std::vector<double> expected(LAWS * SAMPLES);
+	if (in == NULL || fread(&expected[0], sizeof(double), expected.size(), in) != expected.size()) {
+		printf("Could not read %s, run the double build first\n", reference);
+		return 1;
+	}
+	fclose(in);
+	printf("law      max |error|  rms error  (output units, full scale %.0f)\n", OUTPUT_LIMIT);
+	for (int l = 0; l < LAWS; l++) {
+		double worst = 0, sum = 0;
+		for (int k = 0; k < SAMPLES; k++) {
+			double e = outputs[l * SAMPLES + k] - expected[l * SAMPLES + k];
+			worst = std::max(worst, std::abs(e));
+			sum += e * e;
+		}
+		printf("%-8s %11.4f %10.4f\n", laws[l]->name().c_str(), worst, std::sqrt(sum / SAMPLES));
+	}
+#else
+	FILE* out = fopen(reference, "wb");
+	if (out == NULL || fwrite(&outputs[0], sizeof(double), outputs.size(), out) != outputs.size()) {
+		printf("Could not write %s\n", reference);
+		return 1;
+	}
+	fclose(out);
+	printf("reference outputs written to %s\n", reference);
+#endif
+	for (int l = 0; l < LAWS; l++) {
+		delete laws[l];
+	}
+	return 0;
+}
@@ -0,0 +1,78 @@
+/**
+ *! @file eqep_sim.cpp
+ *! Drives simulated eQEP registers so the encoder code can run off target
+ *!
+ *! @author Troy Dack
+ *! @date Copyright (C) 2015
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ **/
+
+/*
+ * Moves a simulated encoder back and forth sinusoidally.  Run it alongside
+ * pendulum (or anything else using BBB::eQEP) with the same BBB_EQEP_MEM:
+ *
+ *   export BBB_EQEP_MEM=/dev/shm/eqep
+ *   ./eqep_sim 0 1600 0.5 &
+ *   ./pendulum
+ *
+ * Not part of the Eclipse build, build it from the repository root with:
+ *   g++ -std=c++11 -O2 -Iinclude -o eqep_sim bench/eqep_sim.cpp \
+ *       include/bbb-eqep/eqep-sim.cpp include/bbb-eqep/bbb-eqep.cpp
+ */
+
+#include <bbb-eqep/eqep-sim.h>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+#include <time.h>
+
+int main(int argc, char const *argv[]) {
+	if (argc < 4) {
+		std::cout << "Usage: eqep_sim <eqep 0-2> <amplitude counts> <frequency Hz> [step us]" << std::endl;
+		return 1;
+	}
+	int eqep = atoi(argv[1]);
+	double amplitude = atof(argv[2]);
+	double frequency = atof(argv[3]);
+	long step = (argc > 4) ? atol(argv[4]) : 100;
+
+	try {
+		BBB::eQEPSim sim(eqep);
+		struct timespec next;
+		clock_gettime(CLOCK_MONOTONIC, &next);
+		double t = 0;
+		long position = 0;
+		while (true) {
+			next.tv_nsec += step * 1000;
+			if (next.tv_nsec >= 1000000000L) {
+				next.tv_sec++;
+				next.tv_nsec -= 1000000000L;
+			}
+			clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+			t += step / 1e6;
+			long target = lround(amplitude * sin(2 * M_PI * frequency * t));
+			sim.step((int32_t)(target - position), step / 1e6);
+			position = target;
+		}
+	}
+	catch (std::runtime_error& err) {
+		std::cout << err.what() << std::endl;
+		return 1;
+	}
+	return 0;
+}
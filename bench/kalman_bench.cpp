@@ -0,0 +1,136 @@
+/**
+ *! @file kalman_bench.cpp
+ *! Kalman filter cost and velocity error against a position difference
+ *!
+ *! @author Troy Dack
+ *! @date Copyright (C) 2015
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ **/
+
+/*
+ * Runs the linear model as the "real" pendulum, balanced by state feedback on
+ * the filtered state plus a small excitation, with random accelerations added
+ * for the dynamics the model misses.  The encoder angles are quantised to
+ * whole counts as the eQEPs would be.  The filter's velocity estimate is
+ * compared with a position difference over the same sample period, and the
+ * time each update takes (the filter's share of the control period) is
+ * reported.
+ *
+ * Not part of the Eclipse build, build it from the repository root with:
+ *   g++ -std=c++11 -O2 -Iinclude -o kalman_bench bench/kalman_bench.cpp \
+ *       include/Model/kalman.cpp include/Model/pendulumModel.cpp src/periodicScheduler.cpp \
+ *       include/BlackLib/BlackThread/BlackThread.cpp -pthread
+ *
+ * Usage: kalman_bench [plant acceleration noise] [filter acceleration noise]
+ * both in rad/s^2, defaulting to 20 and the filter's default.
+ */
+
+#include <Model/kalman.h>
+#include <pendulum.h>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+
+/*!
+ * @brief Angle quantised to whole encoder counts
+ */
+double quantise(double angle, double ppr) {
+	return std::floor(angle / (2 * M_PI) * ppr) * 2 * M_PI / ppr;
+}
+
+/*!
+ * @brief Balancing gain for the model, by iterating the Riccati difference equation
+ */
+matrix<1, STATE_SIZE> balanceGain(const matrix<STATE_SIZE, STATE_SIZE>& Ad, const stateVector& Bd) {
+	matrix<STATE_SIZE, STATE_SIZE> Q = matrix<STATE_SIZE, STATE_SIZE>::identity();
+	double R = 1;
+	matrix<STATE_SIZE, STATE_SIZE> P = Q;
+	matrix<1, STATE_SIZE> K;
+	for (int i = 0; i < 5000; i++) {
+		matrix<1, STATE_SIZE> BtP = Bd.transpose() * P;
+		K = BtP * Ad * (1 / (R + (BtP * Bd)[0]));
+		P = Ad.transpose() * P * (Ad - Bd * K) + Q;
+	}
+	return K;
+}
+
+int main(int argc, char* argv[]) {
+	double dt = SAMPLE_TIME / 1000.0;
+	double accel = (argc > 1) ? atof(argv[1]) : 20;
+	int samples = 100000;
+
+	Model::pendulumModel model;
+	matrix<STATE_SIZE, STATE_SIZE> Ad;
+	stateVector Bd;
+	model.discretise(dt, Ad, Bd);
+	matrix<1, STATE_SIZE> K = balanceGain(Ad, Bd);
+
+	Model::kalman filter(model, dt, ENCODER_PPR, MOTOR_PPR);
+	if (argc > 2) {
+		filter.setProcessNoise(atof(argv[2]));
+	}
+	std::mt19937 rng(1);
+	std::normal_distribution<double> noise(0, accel);
+
+	stateVector x = stateVector::zeros();
+	x[0] = 0.02;
+	pendulumState measured = pendulumState();
+	measured.pAngle = quantise(x[0], ENCODER_PPR);
+	filter.reset(measured);
+	double u = 0, lastP = measured.pAngle, lastM = measured.mAngle;
+	double errFilter[2] = { 0, 0 }, errDiff[2] = { 0, 0 };
+	int n = 0;
+
+	for (int k = 0; k < samples; k++) {
+		// Plant, with random acceleration over the period on each axis
+		x = Ad * x + Bd * u;
+		for (int i = 0; i < 2; i++) {
+			double a = noise(rng);
+			x[i] += a * dt * dt / 2;
+			x[i + 2] += a * dt;
+		}
+
+		measured.pAngle = quantise(x[0], ENCODER_PPR);
+		measured.mAngle = quantise(x[1], MOTOR_PPR);
+		stateVector xf = filter.update(measured, u);
+		u = -(K * xf)[0] + 0.5 * std::sin(2 * M_PI * 0.5 * k * dt);
+
+		double pd = (measured.pAngle - lastP) / dt;
+		double md = (measured.mAngle - lastM) / dt;
+		lastP = measured.pAngle;
+		lastM = measured.mAngle;
+		if (k < 100) {
+			continue; // let the filter settle
+		}
+		errFilter[0] += (xf[2] - x[2]) * (xf[2] - x[2]);
+		errFilter[1] += (xf[3] - x[3]) * (xf[3] - x[3]);
+		errDiff[0] += (pd - x[2]) * (pd - x[2]);
+		errDiff[1] += (md - x[3]) * (md - x[3]);
+		n++;
+	}
+
+	printf("RMS velocity error (rad/s)   pendulum    motor\n");
+	printf("  position difference       %8.4f  %8.4f\n", std::sqrt(errDiff[0] / n), std::sqrt(errDiff[1] / n));
+	printf("  Kalman filter             %8.4f  %8.4f\n", std::sqrt(errFilter[0] / n), std::sqrt(errFilter[1] / n));
+
+	latenessStats timing = filter.getTiming();
+	printf("update time (ns) min/mean/max: %lld/%.0f/%lld, %llu of %llu over budget\n",
+		   (long long)timing.min, timing.mean, (long long)timing.max,
+		   (unsigned long long)timing.overruns, (unsigned long long)timing.ticks);
+	return 0;
+}
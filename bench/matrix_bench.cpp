@@ -0,0 +1,162 @@
+/**
+ *! @file matrix_bench.cpp
+ *! Per step cost of the matrix kernels against hand written scalar code
+ *!
+ *! @author Troy Dack
+ *! @date Copyright (C) 2015
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ **/
+
+/*
+ * Times the LQR control law written out by hand against the same law using
+ * matrix.h, plus the 4x4 kernels an observer or predictive controller needs.
+ * Build it twice to compare the vector kernels with the plain C++ ones:
+ *
+ *   g++ -std=c++11 -O2 -Iinclude -o matrix_bench bench/matrix_bench.cpp
+ *   g++ -std=c++11 -O2 -Iinclude -DMATRIX_SCALAR -o matrix_bench_scalar bench/matrix_bench.cpp
+ *
+ * On the BeagleBone add -mfpu=neon -mfloat-abi=hard.  Only float has vector
+ * kernels, so the double results are the same in both builds.
+ */
+
+#include <matrix.h>
+#include <pendulumState.h>
+#include <cstdio>
+#include <cstdlib>
+#include <time.h>
+
+const int ITERATIONS = 1000000;
+const int INPUTS = 256;		// inputs cycled through so nothing is loop invariant
+
+/*!
+ * @brief Current CLOCK_MONOTONIC time in nanoseconds
+ */
+uint64_t now() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/*!
+ * @brief Time fn over ITERATIONS calls and print nanoseconds per call
+ */
+template <typename F>
+void timeIt(const char* name, F fn) {
+	double sum = 0;
+	uint64_t start = now();
+	for (int i = 0; i < ITERATIONS; i++) {
+		sum += fn(i % INPUTS);
+	}
+	uint64_t ns = now() - start;
+	printf("%-28s %8.2f ns  (%g)\n", name, (double)ns / ITERATIONS, sum);
+}
+
+/*!
+ * @brief Random matrix with values in [-1, 1]
+ */
+template <int R, int C, typename T>
+matrix<R, C, T> randomMatrix() {
+	matrix<R, C, T> m;
+	for (int i = 0; i < R * C; i++) {
+		m[i] = (T)(2.0 * rand() / RAND_MAX - 1.0);
+	}
+	return m;
+}
+
+// Kept out of line so each call does the full step, as it would from tick()
+__attribute__((noinline)) double lqrScalar(const double* k, const pendulumState& s) {
+	return (k[0] * s.pAngle) + (k[1] * s.mAngle) + (k[2] * s.pVelocity) + (k[3] * s.mVelocity);
+}
+
+__attribute__((noinline)) double lqrMatrix(const matrix<1, STATE_SIZE>& K, const pendulumState& s) {
+	return (K * toVector(s))[0];
+}
+
+// Results are stored so none of the work can be discarded
+template <typename T>
+__attribute__((noinline)) T matVec(const matrix<4, 4, T>& A, const vec<4, T>& x, vec<4, T>& y) {
+	y = A * x;
+	return y[0];
+}
+
+template <typename T>
+__attribute__((noinline)) T matMat(const matrix<4, 4, T>& A, const matrix<4, 4, T>& B, matrix<4, 4, T>& C) {
+	C = A * B;
+	return C(3, 3);
+}
+
+template <typename T>
+__attribute__((noinline)) T invert(const matrix<4, 4, T>& A, matrix<4, 4, T>& inv) {
+	inverse(A, inv);
+	return inv(0, 0);
+}
+
+template <typename T>
+void kernels(const char* type) {
+	static matrix<4, 4, T> A[INPUTS], B[INPUTS];
+	static vec<4, T> x[INPUTS], y;
+	static matrix<4, 4, T> C;
+	for (int i = 0; i < INPUTS; i++) {
+		A[i] = randomMatrix<4, 4, T>() + matrix<4, 4, T>::identity() * (T)4;
+		B[i] = randomMatrix<4, 4, T>();
+		x[i] = randomMatrix<4, 1, T>();
+	}
+	char name[64];
+
+	snprintf(name, sizeof(name), "%s 4x4 * 4", type);
+	timeIt(name, [&](int i) { return matVec(A[i], x[i], y); });
+
+	snprintf(name, sizeof(name), "%s 4x4 * 4x4", type);
+	timeIt(name, [&](int i) { return matMat(A[i], B[i], C); });
+
+	snprintf(name, sizeof(name), "%s 4x4 inverse", type);
+	timeIt(name, [&](int i) { return invert(A[i], C); });
+}
+
+int main() {
+#if defined(MATRIX_NEON)
+	printf("matrix kernels: NEON\n");
+#elif defined(MATRIX_SSE2)
+	printf("matrix kernels: SSE2\n");
+#else
+	printf("matrix kernels: scalar\n");
+#endif
+
+	const double k[STATE_SIZE] = { -23.1455, 126.3112, -5.7435, 7.5213 };
+	matrix<1, STATE_SIZE> K(k);
+	static pendulumState s[INPUTS];
+	for (int i = 0; i < INPUTS; i++) {
+		vec<4> v = randomMatrix<4, 1, double>();
+		s[i].pAngle = v[0];
+		s[i].mAngle = v[1];
+		s[i].pVelocity = v[2];
+		s[i].mVelocity = v[3];
+	}
+
+	timeIt("lqr hand written", [&](int i) { return lqrScalar(k, s[i]); });
+	timeIt("lqr matrix", [&](int i) { return lqrMatrix(K, s[i]); });
+
+	kernels<double>("double");
+	kernels<float>("float");
+
+	// Check the solver against a known answer
+	matrix<4, 4> A = randomMatrix<4, 4, double>() + matrix<4, 4>::identity() * 4.0;
+	matrix<4, 4> inv;
+	inverse(A, inv);
+	printf("max |A inv(A) - I| = %g\n", (A * inv - matrix<4, 4>::identity()).maxAbs());
+	return 0;
+}
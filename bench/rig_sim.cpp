@@ -0,0 +1,180 @@
+/**
+ *! @file rig_sim.cpp
+ *! Simulated pendulum rig: pendulum, encoders and motor controller
+ *!
+ *! @author Troy Dack
+ *! @date Copyright (C) 2015
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ **/
+
+/*
+ * Runs the pendulum simulator in real time with its encoders on simulated
+ * eQEPs and its motor driven by an emulated SMC on a pseudo terminal, so
+ * pendulum runs unchanged on a dev box.  Point both at the same eQEP file
+ * and pendulum at the pty this prints:
+ *
+ *   export BBB_EQEP_MEM=/dev/shm/eqep
+ *   ./rig_sim [--up] [--baud=RATE] [--crc] [--no-current] &
+ *   ./pendulum --smc-tty=/dev/pts/N [--baud=RATE] [--crc] --controller=lqr --design
+ *
+ * The pendulum starts hanging down, or with --up held just off upright, as
+ * if raised by hand, until the motor is first driven.  The motor is the one
+ * fitted to data/motor_kt, which pendulum --design designs its gains from.
+ * The tuned LQR gains pendulum uses without --design don't balance it.
+ * Ctrl-C stops it.
+ * Build from the repository root with:
+ *   g++ -std=c++11 -O2 -Iinclude -o rig_sim bench/rig_sim.cpp include/Pololu/smcEmulator.cpp \
+ *       include/Pololu/pololuSMC.cpp include/Model/pendulumSim.cpp include/Model/pendulumModel.cpp \
+ *       include/bbb-eqep/eqep-sim.cpp include/bbb-eqep/bbb-eqep.cpp src/periodicScheduler.cpp \
+ *       include/BlackLib/BlackThread/BlackThread.cpp -pthread
+ */
+
+#include <Pololu/smcEmulator.h>
+#include <Model/pendulumSim.h>
+#include <bbb-eqep/eqep-sim.h>
+#include <pendulum.h>
+#include <cmath>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <time.h>
+
+const double SUPPLY_VOLTAGE = 11.7;
+const double HELD_ANGLE = 0.5 * M_PI / 180;	// off upright when held, so it has somewhere to fall
+
+volatile sig_atomic_t running = 1;
+
+void interrupt(int sig) {
+	running = 0;
+}
+
+/*!
+ * @brief Value of --name=VALUE in argv, or value if it isn't there
+ */
+std::string option(int argc, char const *argv[], const char* name, const char* value) {
+	size_t n = strlen(name);
+	for (int i = 1; i < argc; i++) {
+		if (strncmp(argv[i], name, n) == 0) {
+			return argv[i] + n;
+		}
+	}
+	return value;
+}
+
+bool flag(int argc, char const *argv[], const char* name) {
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], name) == 0) {
+			return true;
+		}
+	}
+	return false;
+}
+
+/*!
+ * @brief Make sure an eQEP counts over its full range
+ *  The simulator file starts zeroed, which would roll the counter over at
+ *  every count until something sets QPOSMAX.
+ */
+void fullRange(int eqep) {
+	BBB::eQEP e(eqep);
+	if (e.getMaxPos() == 0) {
+		e.setMaxPos(0xFFFFFFFF);
+	}
+}
+
+int main(int argc, char const *argv[]) {
+	int baud = atoi(option(argc, argv, "--baud=", "19200").c_str());
+	bool crc = flag(argc, argv, "--crc");
+	bool held = flag(argc, argv, "--up");
+
+	if (BBB::eQEP::memoryBackend() == EQEP_MEM_DEVMEM) {
+		std::cout << "Set " << EQEP_MEM_ENV << " to a file shared with pendulum, eg: /dev/shm/eqep" << std::endl;
+		return 1;
+	}
+
+	try {
+		fullRange(PENDULUM_EQEP);
+		fullRange(MOTOR_EQEP);
+		BBB::eQEPSim pendulumEQEP(PENDULUM_EQEP);
+		BBB::eQEPSim motorEQEP(MOTOR_EQEP);
+
+		Model::pendulumParameters p = Model::measuredParameters();
+		Model::pendulumSim sim(p, SUPPLY_VOLTAGE);
+		stateVector x0 = stateVector::zeros();
+		x0[0] = held ? HELD_ANGLE : M_PI;
+		sim.reset(x0);
+		sim.attach(&pendulumEQEP, &motorEQEP);
+
+		// The encoder counts from where it was switched on, hanging down
+		int64_t down = sim.pendulumCounts() - (int64_t)(ENCODER_PPR / 2);
+		pendulumEQEP.setCount((uint32_t)(down < 0 ? down + (int64_t)ENCODER_PPR : down));
+		motorEQEP.setCount(0);
+
+		Pololu::smcEmulator smc(baud, crc);
+		smc.setReportsCurrent(!flag(argc, argv, "--no-current"));
+		smc.setInputVoltage((int)(SUPPLY_VOLTAGE * 1000));
+		smc.run();
+		std::cout << "SMC on " << smc.ttyName() << " at " << baud << " baud" << (crc ? " with CRC" : "") << std::endl;
+
+		std::signal(SIGINT, interrupt);
+		struct timespec next;
+		clock_gettime(CLOCK_MONOTONIC, &next);
+		long stepNs = (long)(Model::SIM_STEP * 1e9);
+		int ticks = 0;
+		while (running) {
+			next.tv_nsec += stepNs;
+			if (next.tv_nsec >= 1000000000L) {
+				next.tv_sec++;
+				next.tv_nsec -= 1000000000L;
+			}
+			clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+
+			int speed = smc.motorSpeed();
+			// Let go once the controller drives the motor
+			held = held && speed == 0;
+			if (!held) {
+				sim.setCommand(speed);
+				sim.run(Model::SIM_STEP);
+			}
+			const stateVector& x = sim.state();
+			double amps = (sim.voltage() - p.backEmfConstant * x[3]) / p.motorResistance;
+			smc.setCurrent((int)std::abs(amps * 1000));
+
+			if (++ticks % 1000 == 0) {
+				printf("%6.1fs pendulum %7.1f arm %7.1f deg speed %5d%s   \r", sim.time(),
+					   x[0] * 180 / M_PI, x[1] * 180 / M_PI, speed, held ? " held" : "");
+				fflush(stdout);
+			}
+		}
+		smc.stop();
+		WAIT_THREAD_FINISH(&smc);
+
+		Pololu::emulatorStats s = smc.getStats();
+		std::cout << std::endl << "SMC received " << s.bytes << " bytes, " << s.speeds << " speeds, "
+				  << s.requests << " variable requests, " << s.crcErrors << " CRC errors, "
+				  << s.formatErrors << " format errors" << std::endl;
+	}
+	catch (std::runtime_error& err) {
+		std::cout << err.what() << std::endl;
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,287 @@
+/**
+ *! @file serial_bench.cpp
+ *! Motor command latency and throughput at each serial setting and tick rate
+ *!
+ *! @author Troy Dack
+ *! @date Copyright (C) 2015
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ **/
+
+/*
+ * Sends Set Target Speed commands as a control loop would, one per tick on
+ * absolute deadlines, for each baud rate, with and without CRC, at each tick
+ * period.  For every command it records how long the write call took, how
+ * long until the bytes had left the UART (OutputQueued() reaching 0) and,
+ * against the emulator, how long until the SMC acted on it.  A tick whose
+ * command hadn't left by the next deadline is an overrun.  Each setting is
+ * also run back to back, for the most commands per second it can carry.
+ * Build from the repository root:
+ *
+ *   g++ -std=c++11 -O2 -Iinclude -o serial_bench bench/serial_bench.cpp include/Pololu/pololuSMC.cpp \
+ *       include/Pololu/smcEmulator.cpp src/periodicScheduler.cpp \
+ *       include/BlackLib/BlackThread/BlackThread.cpp -pthread
+ *   ./serial_bench [--tty=/dev/ttyO2] [--bauds=9600,19200,...] [--crc=0,1]
+ *                  [--periods=20,10,5,2,1] [--commands=200] [--csv=serial_bench.csv]
+ *
+ * Without --tty the commands go to Pololu::smcEmulator on a pseudo terminal,
+ * which paces bytes as the wire would.  On the rig the motor is only ever
+ * sent speed 0; the SMC only detects its baud rate once after reset, so give
+ * one rate per power cycle, and enable CRC in its settings for --crc=1.
+ * Times are to within the polling interval, POLL_US.
+ */
+
+#include <Pololu/pololuSMC.h>
+#include <Pololu/smcEmulator.h>
+#include <latencyHistogram.h>
+#include <periodicScheduler.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <time.h>
+#include <vector>
+
+const int POLL_US = 20;					// between checks for the command leaving
+const int64_t GIVE_UP_NS = 200000000;	// a command not out by now is counted lost
+const double THROUGHPUT_SECONDS = 1.0;
+
+/*!
+ * @brief Value of --name=VALUE in argv, or value if it isn't there
+ */
+std::string option(int argc, char const *argv[], const char* name, const char* value) {
+	size_t n = strlen(name);
+	for (int i = 1; i < argc; i++) {
+		if (strncmp(argv[i], name, n) == 0) {
+			return argv[i] + n;
+		}
+	}
+	return value;
+}
+
+/*!
+ * @brief Comma separated numbers
+ */
+std::vector<double> numbers(std::string text) {
+	std::vector<double> values;
+	std::replace(text.begin(), text.end(), ',', ' ');
+	std::istringstream in(text);
+	double v;
+	while (in >> v) {
+		values.push_back(v);
+	}
+	return values;
+}
+
+/*!
+ * @brief Results for one baud rate, protocol and tick period
+ */
+struct tickResult {
+	latencyHistogram write;		// SetTargetSpeed() call
+	latencyHistogram drain;		// call start to OutputQueued() == 0
+	latencyHistogram act;		// call start to the emulator acting on it
+	int overruns;				// ticks whose command was still going at the next deadline
+	int lost;					// commands not out, or not acted on, within GIVE_UP_NS
+};
+
+/*!
+ * @brief Wait for the last command to leave, and be acted on if emu isn't NULL
+ *
+ * @param start time the command was written
+ * @param before emulator's speed count before the command
+ * @return False if it took longer than GIVE_UP_NS
+ */
+bool waitFor(Pololu::SMC& smc, Pololu::smcEmulator* emu, uint64_t start, uint32_t before,
+			 latencyHistogram* drain, latencyHistogram* act) {
+	bool drained = false;
+	bool acted = (emu == NULL);
+	while (true) {
+		uint64_t now = monotonicNow();
+		if (!drained && smc.OutputQueued() <= 0) {
+			drained = true;
+			if (drain != NULL) {
+				drain->record(now - start);
+			}
+		}
+		if (!acted && emu->getStats().speeds != before) {
+			acted = true;
+			if (act != NULL) {
+				act->record(now - start);
+			}
+		}
+		if (drained && acted) {
+			return true;
+		}
+		if ((int64_t)(now - start) > GIVE_UP_NS) {
+			return false;
+		}
+		usleep(POLL_US);
+	}
+}
+
+uint32_t speedsActed(Pololu::smcEmulator* emu) {
+	return (emu != NULL) ? emu->getStats().speeds : 0;
+}
+
+/*!
+ * @brief One command per tick for commands ticks
+ */
+void runTicks(Pololu::SMC& smc, Pololu::smcEmulator* emu, double periodMs, int commands, tickResult& r) {
+	r.overruns = 0;
+	r.lost = 0;
+	int64_t period = (int64_t)(periodMs * 1e6);
+	uint64_t deadline = monotonicNow() + period;
+	for (int i = 0; i < commands; i++) {
+		struct timespec at = { (time_t)(deadline / 1000000000), (long)(deadline % 1000000000) };
+		clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &at, NULL);
+
+		uint32_t before = speedsActed(emu);
+		uint64_t start = monotonicNow();
+		smc.SetTargetSpeed(0);
+		r.write.record(monotonicNow() - start);
+		if (!waitFor(smc, emu, start, before, &r.drain, &r.act)) {
+			r.lost++;
+		}
+
+		// Skip the deadlines already missed, as a periodic task would
+		deadline += period;
+		uint64_t now = monotonicNow();
+		if (now > deadline) {
+			r.overruns++;
+			deadline += ((now - deadline) / period + 1) * period;
+		}
+	}
+}
+
+/*!
+ * @brief Commands per second sent back to back, each once the last has left
+ */
+double throughput(Pololu::SMC& smc, Pololu::smcEmulator* emu) {
+	uint64_t start = monotonicNow();
+	uint64_t end = start + (uint64_t)(THROUGHPUT_SECONDS * 1e9);
+	int sent = 0;
+	uint64_t now;
+	while ((now = monotonicNow()) < end) {
+		uint32_t before = speedsActed(emu);
+		smc.SetTargetSpeed(0);
+		waitFor(smc, emu, now, before, NULL, NULL);
+		sent++;
+	}
+	return sent / ((monotonicNow() - start) / 1e9);
+}
+
+double us(int64_t ns) {
+	return ns / 1000.0;
+}
+
+int main(int argc, char const *argv[]) {
+	std::string tty = option(argc, argv, "--tty=", "");
+	std::vector<double> bauds = numbers(option(argc, argv, "--bauds=", "9600,19200,38400,57600,115200"));
+	std::vector<double> crcs = numbers(option(argc, argv, "--crc=", "0,1"));
+	std::vector<double> periods = numbers(option(argc, argv, "--periods=", "20,10,5,2,1"));
+	int commands = atoi(option(argc, argv, "--commands=", "200").c_str());
+	std::string csvName = option(argc, argv, "--csv=", "serial_bench.csv");
+
+	std::ofstream csv(csvName.c_str());
+	csv << "baud,crc,frame_bytes,wire_us,period_ms,commands,write_p50_us,write_p99_us,"
+		<< "drain_p50_us,drain_p90_us,drain_p99_us,drain_max_us,act_p50_us,act_p99_us,"
+		<< "overruns,lost,max_rate_per_s\n";
+
+	printf("%s\n", tty.empty() ? "emulated SMC on a pseudo terminal" : tty.c_str());
+	printf("\n  baud crc  wire | period   write us     drain us (p50/p99/max)     act us (p50/p99)  overruns\n");
+	std::vector<std::string> summary;
+	for (size_t b = 0; b < bauds.size(); b++) {
+		for (size_t c = 0; c < crcs.size(); c++) {
+			int baud = (int)bauds[b];
+			bool crc = crcs[c] != 0;
+			try {
+				Pololu::smcEmulator* emu = NULL;
+				if (tty.empty()) {
+					emu = new Pololu::smcEmulator(baud, crc);
+					emu->run();
+				}
+				Pololu::SMC* smc = new Pololu::SMC(tty.empty() ? emu->ttyName().c_str() : tty.c_str(), baud, crc);
+				// Let the start up commands go
+				waitFor(*smc, NULL, monotonicNow(), 0, NULL, NULL);
+				usleep(10000);
+
+				unsigned char frame[4];
+				int length = smc->GetFrame(0, frame);
+				double wire = length * 10e6 / baud;
+				double rate = throughput(*smc, emu);
+				double fastest = 0;		// shortest period with no overruns or losses
+
+				for (size_t p = 0; p < periods.size(); p++) {
+					tickResult r;
+					runTicks(*smc, emu, periods[p], commands, r);
+					if (r.overruns == 0 && r.lost == 0 && (fastest == 0 || periods[p] < fastest)) {
+						fastest = periods[p];
+					}
+					printf("%6d %3s %5.0f | %6g %5.0f/%-5.0f %6.0f/%-6.0f/%-7.0f", baud, crc ? "yes" : "no", wire,
+						   periods[p], us(r.write.percentile(0.5)), us(r.write.percentile(0.99)),
+						   us(r.drain.percentile(0.5)), us(r.drain.percentile(0.99)), us(r.drain.max()));
+					if (emu != NULL) {
+						printf(" %7.0f/%-7.0f", us(r.act.percentile(0.5)), us(r.act.percentile(0.99)));
+					} else {
+						printf(" %15s", "-");
+					}
+					printf("  %d%s\n", r.overruns, r.lost > 0 ? " lost" : "");
+
+					csv << baud << "," << crc << "," << length << "," << wire << "," << periods[p] << ","
+						<< commands << "," << us(r.write.percentile(0.5)) << "," << us(r.write.percentile(0.99)) << ","
+						<< us(r.drain.percentile(0.5)) << "," << us(r.drain.percentile(0.9)) << ","
+						<< us(r.drain.percentile(0.99)) << "," << us(r.drain.max()) << ",";
+					if (emu != NULL) {
+						csv << us(r.act.percentile(0.5)) << "," << us(r.act.percentile(0.99));
+					} else {
+						csv << ",";
+					}
+					csv << "," << r.overruns << "," << r.lost << "," << rate << "\n";
+				}
+
+				char line[128];
+				if (fastest > 0) {
+					snprintf(line, sizeof line, "%6d %3s %9.0f %12g", baud, crc ? "yes" : "no", rate, fastest);
+				} else {
+					snprintf(line, sizeof line, "%6d %3s %9.0f %12s", baud, crc ? "yes" : "no", rate, "none");
+				}
+				summary.push_back(line);
+
+				delete smc;
+				if (emu != NULL) {
+					emu->stop();
+					WAIT_THREAD_FINISH(emu);
+					delete emu;
+				}
+			}
+			catch (std::runtime_error& err) {
+				printf("%6d %3s  %s\n", baud, crc ? "yes" : "no", err.what());
+			}
+		}
+	}
+
+	printf("\n  baud crc  cmds/sec  fastest tick ms (no overruns)\n");
+	for (size_t i = 0; i < summary.size(); i++) {
+		printf("%s\n", summary[i].c_str());
+	}
+	printf("\nwrote %s\n", csvName.c_str());
+	return 0;
+}
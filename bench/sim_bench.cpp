@@ -0,0 +1,174 @@
+/**
+ *! @file sim_bench.cpp
+ *! Closed loop runs of the controllers against the pendulum simulator
+ *!
+ *! @author Troy Dack
+ *! @date Copyright (C) 2015
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ **/
+
+/*
+ * Runs each balancing controller from a spread of starting states, ticking
+ * it through the registry exactly as the control pipeline does, with
+ * motorCommand() between the controller and the simulated SMC.  Reports how
+ * many runs ended balanced near the centre, the worst pendulum angle and arm
+ * travel, and how much faster than real time the runs went.  The laws are
+ * designed once from the parameters the simulator uses and once from the
+ * defaults, to show what the model mismatch costs.  Build from the
+ * repository root:
+ *
+ *   SRC="bench/sim_bench.cpp include/Model/pendulumSim.cpp include/Model/pendulumModel.cpp \
+ *        include/Model/kalman.cpp include/Model/dare.cpp include/Controller/basic.cpp \
+ *        include/Controller/velocity.cpp include/Controller/lqr.cpp include/Controller/lqrTuner.cpp \
+ *        include/Controller/mpc.cpp include/Controller/swingUp.cpp include/Controller/registry.cpp \
+ *        include/bbb-eqep/eqep-sim.cpp include/bbb-eqep/bbb-eqep.cpp src/controlPipeline.cpp \
+ *        src/multiEQEP.cpp src/velocityEstimator.cpp src/positionUnwrapper.cpp \
+ *        include/Pololu/pololuSMC.cpp src/periodicScheduler.cpp \
+ *        include/BlackLib/BlackThread/BlackThread.cpp"
+ *   g++ -std=c++11 -O2 -Iinclude -o sim_bench $SRC -pthread
+ *   ./sim_bench [runs] [seconds]
+ *
+ * Defaults are 200 runs of 10 simulated seconds per controller.
+ */
+
+#include <Model/pendulumSim.h>
+#include <Controller/registry.h>
+#include <Controller/swingUp.h>
+#include <controlPipeline.h>
+#include <pendulum.h>
+#include <fastTrig.h>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+
+const double SUPPLY_VOLTAGE = 11.7;
+const double BALANCED_ANGLE = 5 * M_PI / 180;	// final |pAngle| counted as balanced
+const double CENTRED_ARM = M_PI / 2;			// final |mAngle| counted as centred
+
+struct runResult {
+	bool balanced;
+	double maxAngle;
+	double maxArm;
+};
+
+/*!
+ * @brief Tick the selected controller against the simulator from x0
+ */
+runResult runOnce(Controller::registry& reg, Model::pendulumSim& sim, pendulumStateBuffer& state,
+				  std::atomic<double>& output, std::atomic<double>& cutoff,
+				  const stateVector& x0, double seconds, double dt) {
+	runResult r = runResult();
+	sim.reset(x0);
+	sim.setCommand(0);
+	output.store(0);
+	sim.publish(&state);
+	reg.SetMode(1);
+	tickInfo info = tickInfo();
+	info.dt = dt;
+	int ticks = (int)(seconds / dt);
+	for (int k = 0; k < ticks; k++) {
+		sim.run(dt);
+		sim.publish(&state);
+		info.tick = k;
+		reg.tick(info);
+		double angle = wrapAngle(sim.state()[0]);
+		sim.setCommand(motorCommand(output.load(), angle * 180 / M_PI, cutoff.load()));
+		r.maxAngle = std::max(r.maxAngle, std::abs(angle));
+		r.maxArm = std::max(r.maxArm, std::abs(sim.state()[1]));
+	}
+	reg.SetMode(0);
+	r.balanced = std::abs(wrapAngle(sim.state()[0])) < BALANCED_ANGLE
+				 && std::abs(sim.state()[1]) < CENTRED_ARM;
+	return r;
+}
+
+/*!
+ * @brief Run every balancing controller, designed from the given parameters, against sim
+ *  With designLQR false the LQR uses the tuned gains and only its filter comes from design.
+ */
+void runControllers(const char* title, const Model::pendulumParameters& design, bool designLQR, Model::pendulumSim& sim,
+					int runs, double seconds) {
+	double dt = SAMPLE_TIME / 1000.0;
+	pendulumStateBuffer state;
+	std::atomic<double> output(0);
+	std::atomic<double> cutoff(MOTOR_CUTOFF_ANGLE);
+	double setPoint = 0;
+
+	Controller::registry reg;
+	Controller::addBuiltinControllers(reg, &state, &output, &setPoint, &cutoff, 1, 0, 0, 0,
+									  design, Model::lqrWeights(), designLQR);
+	reg.SetOutputLimits(-Pololu::SMC_MAX_SPEED, Pololu::SMC_MAX_SPEED);
+	reg.SetSampleTime(SAMPLE_TIME);
+	reg.SetSupplyVoltage(SUPPLY_VOLTAGE);
+
+	const char* names[] = { "lqr", "mpc", "swingup" };
+	printf("\n%s\n", title);
+	printf("controller  balanced  worst angle  worst arm  x real time\n");
+	printf("                            deg        rad\n");
+	for (int c = 0; c < 3; c++) {
+		int id = reg.find(names[c]);
+		if (id < 0) {
+			continue;
+		}
+		reg.select(id);
+		std::mt19937 rng(1);
+		std::uniform_real_distribution<double> spread(-1, 1);
+		bool swing = (std::string(names[c]) == "swingup");
+		int balanced = 0;
+		double worstAngle = 0, worstArm = 0;
+		uint64_t start = monotonicNow();
+		for (int n = 0; n < runs; n++) {
+			stateVector x0 = stateVector::zeros();
+			if (swing) {
+				x0[0] = M_PI + 0.05 * spread(rng);
+			} else {
+				x0[0] = 0.15 * spread(rng);
+				x0[2] = 0.5 * spread(rng);
+			}
+			x0[1] = 0.3 * spread(rng);
+			runResult r = runOnce(reg, sim, state, output, cutoff, x0, seconds, dt);
+			balanced += r.balanced;
+			worstAngle = std::max(worstAngle, r.maxAngle);
+			worstArm = std::max(worstArm, r.maxArm);
+		}
+		double wall = (monotonicNow() - start) / 1e9;
+		// Swing up starts hanging, so its worst angle says nothing
+		printf("%-10s %5d/%-4d %10.1f %10.2f %12.0f\n", names[c], balanced, runs,
+			   swing ? 0.0 : worstAngle * 180 / M_PI, worstArm, runs * seconds / wall);
+	}
+}
+
+int main(int argc, char* argv[]) {
+	int runs = (argc > 1) ? atoi(argv[1]) : 200;
+	double seconds = (argc > 2) ? atof(argv[2]) : 10;
+
+	// Laws built with CONTROLLER_TRACE log every step to std::cout
+	std::cout.setstate(std::ios::failbit);
+
+	Model::pendulumSim sim(Model::measuredParameters(), SUPPLY_VOLTAGE);
+	printf("%d runs of %.0fs, %dms sample time, simulator fitted to data/motor_kt\n",
+		   runs, seconds, SAMPLE_TIME);
+	runControllers("controllers designed from the fitted parameters",
+				   Model::measuredParameters(), true, sim, runs, seconds);
+	runControllers("controllers designed from the default parameters",
+				   Model::pendulumParameters(), true, sim, runs, seconds);
+	runControllers("tuned LQR gains, the rest designed from the fitted parameters",
+				   Model::measuredParameters(), false, sim, runs, seconds);
+	return 0;
+}
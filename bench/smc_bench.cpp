@@ -0,0 +1,174 @@
+/**
+ *! @file smc_bench.cpp
+ *! Cost of building and sending Set Target Speed commands at each baud rate
+ *!
+ *! @author Troy Dack
+ *! @date Copyright (C) 2015
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ **/
+
+/*
+ * First checks the frame table against the branching encoder it replaced,
+ * for every speed with and without CRC, and times both.  Then, for each baud
+ * rate, sends Set Target Speed commands and times each from the start of the
+ * call until the frame has left the UART (tcdrain).  Build from the
+ * repository root:
+ *
+ *   g++ -std=c++11 -O2 -Iinclude -o smc_bench bench/smc_bench.cpp include/Pololu/pololuSMC.cpp \
+ *       src/periodicScheduler.cpp include/BlackLib/BlackThread/BlackThread.cpp -pthread -lutil
+ *   ./smc_bench [tty] [commands]
+ *
+ * With the SMC on /dev/ttyO2 the SMC must be set to auto detect its baud
+ * rate, and to use CRC for the CRC rows; the motor is only ever sent speed 0.
+ * Without a tty the commands go to a pseudo terminal, which has no baud rate,
+ * so only the software cost is measured.
+ */
+
+#include <Pololu/pololuSMC.h>
+#include <latencyHistogram.h>
+#include <periodicScheduler.h>
+#include <fcntl.h>
+#include <pty.h>
+#include <unistd.h>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+
+const int ENCODE_ROUNDS = 200;
+
+/*!
+ * @brief The Set Target Speed encoder SMC used before the frame table
+ */
+int branchingFrame(int speed, bool crc, unsigned char* command) {
+	if (speed < 0) {
+		command[0] = 0x86; // Motor Reverse
+		speed = -speed;
+	} else {
+		command[0] = 0x85; // Motor Forward
+	}
+	command[1] = speed & 0x1F;
+	command[2] = speed >> 5 & 0x7F;
+	if (crc) {
+		command[3] = Pololu::crc7(command, 3);
+		return 4;
+	}
+	return 3;
+}
+
+/*!
+ * @brief Compare the frame table with the branching encoder and time both
+ */
+bool checkEncoders(const char* tty, bool crc) {
+	Pololu::SMC smc(tty, Pololu::SMC_DEFAULT_BAUD, crc);
+	unsigned char a[4], b[4];
+	for (int speed = -Pololu::SMC_MAX_SPEED; speed <= Pololu::SMC_MAX_SPEED; speed++) {
+		int na = branchingFrame(speed, crc, a);
+		int nb = smc.GetFrame(speed, b);
+		if (na != nb || memcmp(a, b, na) != 0) {
+			printf("frame mismatch at speed %d\n", speed);
+			return false;
+		}
+	}
+
+	// Pseudo random speeds so the branch predictor can't learn the sign
+	unsigned sum = 0;
+	uint32_t x = 1;
+	uint64_t start = monotonicNow();
+	for (int r = 0; r < ENCODE_ROUNDS; r++) {
+		for (int i = 0; i < 2 * Pololu::SMC_MAX_SPEED; i++) {
+			x = x * 1664525 + 1013904223;
+			sum += branchingFrame((int)((x >> 16) % (2 * Pololu::SMC_MAX_SPEED + 1)) - Pololu::SMC_MAX_SPEED, crc, a) + a[1];
+		}
+	}
+	double branching = (double)(monotonicNow() - start) / (ENCODE_ROUNDS * 2 * Pololu::SMC_MAX_SPEED);
+	x = 1;
+	start = monotonicNow();
+	for (int r = 0; r < ENCODE_ROUNDS; r++) {
+		for (int i = 0; i < 2 * Pololu::SMC_MAX_SPEED; i++) {
+			x = x * 1664525 + 1013904223;
+			sum += smc.GetFrame((int)((x >> 16) % (2 * Pololu::SMC_MAX_SPEED + 1)) - Pololu::SMC_MAX_SPEED, b) + b[1];
+		}
+	}
+	double table = (double)(monotonicNow() - start) / (ENCODE_ROUNDS * 2 * Pololu::SMC_MAX_SPEED);
+	printf("%-7s every frame matches, encode ns branching %.1f table %.1f (%u)\n", crc ? "crc" : "compact",
+		   branching, table, sum & 1);
+	return true;
+}
+
+int main(int argc, char* argv[]) {
+	const char* tty = (argc > 1) ? argv[1] : NULL;
+	int commands = (argc > 2) ? atoi(argv[2]) : 500;
+
+	// No SMC given, read everything written to a pseudo terminal and throw it away
+	int master = -1, slave = -1;
+	char ptyName[64];
+	std::atomic<bool> done(false);
+	std::thread reader;
+	if (tty == NULL) {
+		if (openpty(&master, &slave, ptyName, NULL, NULL) != 0) {
+			perror("openpty");
+			return 1;
+		}
+		tty = ptyName;
+		fcntl(master, F_SETFL, O_NONBLOCK);
+		reader = std::thread([&]() {
+			unsigned char buffer[256];
+			while (!done.load()) {
+				if (read(master, buffer, sizeof buffer) <= 0) {
+					usleep(100);
+				}
+			}
+		});
+		printf("pseudo terminal %s, latencies are software only\n", tty);
+	}
+
+	if (!checkEncoders(tty, false) || !checkEncoders(tty, true)) {
+		return 1;
+	}
+
+	const int rates[] = { 9600, 19200, 38400, 57600, 115200 };
+	printf("\n  baud  frame  wire us   p50 us   p99 us   max us  serial errors\n");
+	for (int r = 0; r < (int)(sizeof rates / sizeof rates[0]); r++) {
+		for (int crc = 0; crc < 2; crc++) {
+			Pololu::SMC smc(tty, rates[r], crc != 0);
+			smc.Drain();
+			latencyHistogram latency;
+			unsigned char frame[4];
+			int length = smc.GetFrame(0, frame);
+			for (int i = 0; i < commands; i++) {
+				uint64_t start = monotonicNow();
+				smc.SetTargetSpeed(0);
+				smc.Drain();
+				latency.record(monotonicNow() - start);
+			}
+			int errors = (master == -1) ? smc.GetSerialErrors() : 0;
+			printf("%6d %6d %8.0f %8.1f %8.1f %8.1f  %#x\n", rates[r], length, length * 10e6 / rates[r],
+				   latency.percentile(0.5) / 1000.0, latency.percentile(0.99) / 1000.0,
+				   latency.max() / 1000.0, errors);
+		}
+	}
+
+	if (master != -1) {
+		done.store(true);
+		reader.join();
+		close(master);
+		close(slave);
+	}
+	return 0;
+}
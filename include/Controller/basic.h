@@ -24,50 +24,27 @@
 #ifndef INCLUDE_CONTROLLER_BASIC_H_
 #define INCLUDE_CONTROLLER_BASIC_H_
 
-//#define DEBUG
-
-#ifdef DEBUG
-#define D(x) x
-#else
-#define D(x)
-#endif
-
-#include <BlackLib/BlackThread/BlackThread.h>
-#include <atomic>
-#include <chrono>
 #include <cstdbool>
 #include <string>
+#include <iostream>
+#include <Controller/controllerBase.h>
 
 namespace Controller {
-class basic: public BlackLib::BlackThread {
+class basic : public controllerBase<basic> {
 
 public:
 
 	/**
 	 * Proportional-Integral-Derivative controller for inverted pendulum
 	 */
-	basic(double* Input, double* Output, double* SetPoint, double _kp,
+	basic(const pendulumStateBuffer* State, std::atomic<double>* Output, double* SetPoint, double _kp,
 			double _ki, double _kd, int dir);
 
-	void SetMode(int Mode); // * sets pid-new to either Manual (0) or Auto (non-0)
-
-	void SetOutputLimits(double Min, double Max); //clamps the output to a specific range. 0-255 by default, but
-												  //it's likely the user will want to change this depending on
-												  //the application
-
 	//available but not commonly used functions ********************************************************
 	void SetTunings(double kp, double ki, // * While most users will set the tunings once in the
 			double kd); 				  //   constructor, this function gives the user the option
 										  //   of changing tunings during runtime for Adaptive control
 
-	void SetControllerDirection(int);// * Sets the Direction, or "Action" of the controller. DIRECT
-									 //   means the output will increase when error is positive. REVERSE
-									 //   means the opposite.  it's very unlikely that this will be needed
-									 //   once it is set in the constructor.
-
-	void SetSampleTime(int); // * sets the frequency, in Milliseconds, with which
-							 //   the pid-new calculation is performed.  default is 100
-
 	/* Status Funcions*************************************************************
 	 * Just because you set the Kp=-1 doesn't mean it actually happened.  these
 	 * functions query the internal state of the PID.  they're here for display
@@ -82,49 +59,50 @@ public:
 	inline double GetKd() {
 		return dispKd;
 	}
-	inline int GetMode() {
-		return inAuto ? 1 : 0;
-	}
-	inline int GetDirection() {
-		return controllerDirection;
-	}
 
-	void onStartHandler();  // called by run() to do the work in the thread
+	inline double step(const pendulumState& x); // does the actual PID calculations
 
 	std::string name();
 
-	void stop();			// stops the thread running.
-
 private:
-	void Initialize();
-	void Compute(); // does the actual PID calculations
+	friend class controllerBase<basic>;
 
-	std::atomic<bool> bExit; 	// flag to tell thread to quit
-	std::string _name = "Basic";
+	void Initialize(const pendulumState& x);
+	void SampleTimeChanged(double ratio);
+	void DirectionChanged();
+	void OutputLimitsChanged();
 
 	double dispKp;				// * we'll hold on to the tuning parameters in user-entered
 	double dispKi;				//   format for display purposes
 	double dispKd;				//
 
-	double kp;                  // * (P)roportional Tuning Parameter
-	double ki;                  // * (I)ntegral Tuning Parameter
-	double kd;                  // * (D)erivative Tuning Parameter
-
-	int controllerDirection;
-
-	double *myInput;  // * Pointers to the Input, Output, and Setpoint variables
-	double *myOutput; //   This creates a hard link between the variables and the
-	double *mySetPoint; //   pid, freeing the user from having to constantly tell us
-						//   what these values are.  with pointers we'll just know.
+	real kp;                    // * (P)roportional Tuning Parameter
+	real ki;                    // * (I)ntegral Tuning Parameter
+	real kd;                    // * (D)erivative Tuning Parameter
 
-	std::chrono::high_resolution_clock::time_point lastTime;
-	double ITerm, lastInput;
-
-	bool inAuto;
-	double SampleTime;
-	double outMin, outMax;
+	real ITerm, lastInput;
 };
 
+double basic::step(const pendulumState& x) {
+	/*Compute all the working error variables*/
+	real input(x.pAngle);
+	real error = real(*mySetPoint) - input;
+	ITerm = clampReal(ITerm + ki * error);
+	real dInput = (input - lastInput);
+
+	/*Compute PID Output*/
+	real output = kp * error + ITerm - kd * dInput;
+
+	/*Remember some variables for next time*/
+	lastInput = input;
+	STEP_TRACE(const tickInfo& info = currentTick();)
+	STEP_TRACE(std::cout << info.dt + info.lateness / 1e9 << ",";)
+	STEP_TRACE(std::cout << std::to_string(toDouble(input)) << ",";)
+	STEP_TRACE(std::cout << std::to_string(toDouble(error)) << ",";)
+	STEP_TRACE(std::cout << std::to_string(toDouble(clampReal(output))) << std::endl;)
+	return toDouble(output);
+}
+
 }
 ;
 /* namespace Controller */
@@ -0,0 +1,416 @@
+/**
+ *! @file controllerBase.h
+ *! Common lifecycle, clamping and telemetry for the pendulum controllers
+ *!
+ *! @author troy
+ *! @date Copyright (C) 2015
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ **/
+
+#ifndef INCLUDE_CONTROLLER_CONTROLLERBASE_H_
+#define INCLUDE_CONTROLLER_CONTROLLERBASE_H_
+
+#include <atomic>
+#include <string>
+#include <periodicScheduler.h>
+#include <pendulumState.h>
+#include <latencyHistogram.h>
+#include <fixedPoint.h>
+
+namespace Controller {
+
+const double SUPPLY_VOLTAGE = 11.7;	/*!< @brief Default motor supply voltage, the motor voltage at full scale output */
+
+/*!
+ * @brief Number type the PID, velocity and LQR laws compute with each step
+ *  Build with -DCONTROLLER_FIXED_POINT=16 for saturating Q15.16 arithmetic
+ *  in place of double, which takes the same time whatever the values.
+ *  Gains are still designed in double and converted when they change.
+ *  bench/controller_bench.cpp measures how far the outputs are from the
+ *  double build.
+ */
+#ifdef CONTROLLER_FIXED_POINT
+typedef fixed<CONTROLLER_FIXED_POINT> real;
+#else
+typedef double real;
+#endif
+
+/*!
+ * @brief Per step trace of the control laws to std::cout
+ *  step() is inline in each law's header, so the trace is switched for the
+ *  whole build with -DCONTROLLER_TRACE, never per file; every copy of step()
+ *  has to be the same.  The trace is written on the control thread inside
+ *  the measured step time, so leave it off when measuring step times.
+ */
+#ifdef CONTROLLER_TRACE
+#define STEP_TRACE(x) x
+#else
+#define STEP_TRACE(x)
+#endif
+
+/*!
+ * @brief Values passed to a telemetry hook after every controller step
+ */
+struct controllerTelemetry {
+	uint64_t tick;			/*!< Tick number from the scheduler */
+	double dt;				/*!< Actual time since the previous deadline in seconds */
+	pendulumState state;	/*!< State the output was computed from */
+	double u;				/*!< Control law output before clamping */
+	double output;			/*!< Output after clamping */
+};
+
+typedef void (*telemetryHook)(void* context, const controllerTelemetry& t); /*!< @brief Telemetry callback */
+
+/*!
+ * @brief Controller operations that can be called without knowing the control law
+ *  Used by the registry to switch laws at run time.  Only tick() is called per
+ *  sample; the rest are called on mode changes.
+ */
+class controllerTask : public periodicTask {
+public:
+	virtual void SetMode(int Mode) = 0;
+	virtual int GetMode() = 0;
+	virtual void SetOutputLimits(double Min, double Max) = 0;
+	virtual void SetSampleTime(int NewSampleTime) = 0;
+	virtual void SetTransferTicks(int ticks) = 0;
+	virtual void SetSupplyVoltage(double volts) = 0;
+	virtual std::string name() = 0;
+
+	/*!
+	 * @brief Time taken by each step of the control law, in nanoseconds
+	 */
+	virtual const latencyHistogram& GetStepTimes() = 0;
+};
+
+/*!
+ * @brief Shared controller plumbing, specialised at compile time for each control law
+ *
+ * Derived is the control law and must provide
+ *
+ *     double step(const pendulumState& x);	// output before clamping
+ *     std::string name();
+ *
+ * and may hide any of the hooks below to be told about changes:
+ *
+ *     void Initialize(const pendulumState& x);	// manual -> auto, for bumpless transfer
+ *     void Stopped();							// auto -> manual
+ *     void SampleTimeChanged(double ratio);	// new / old sample time
+ *     void DirectionChanged();
+ *     void OutputLimitsChanged();
+ *
+ * step() is called through the derived type, so it is inlined into tick() and
+ * the only virtual call per sample is the call to tick() itself.
+ */
+template <typename Derived>
+class controllerBase : public controllerTask {
+
+public:
+	/*!
+	 * @param[in] State pendulum state to read each sample
+	 * @param[out] Output controller output
+	 * @param[in] SetPoint target for controller
+	 * @param[in] dir Direction controller is to operate in. 0=normal, 1=inverse
+	 */
+	controllerBase(const pendulumStateBuffer* State, std::atomic<double>* Output, double* SetPoint, int dir)
+		: myState(State)
+		, myOutput(Output)
+		, mySetPoint(SetPoint)
+		, inAuto(false)
+		, SampleTime(0.1)
+		, outMin(0)
+		, outMax(100)
+		, realMin(0)
+		, realMax(100)
+		, controllerDirection(dir)
+		, supplyVoltage(SUPPLY_VOLTAGE)
+		, outputScale(100 / SUPPLY_VOLTAGE)
+		, voltMin(0)
+		, voltMax(SUPPLY_VOLTAGE)
+		, transferTicks(0)
+		, transferLeft(0)
+		, transferStart(false)
+		, transferFrom(0)
+		, transferOffset(0)
+		, telemetry(NULL)
+		, telemetryContext(NULL)
+	{
+		current = tickInfo();
+	}
+
+	/*!
+	 * @brief Called by periodicScheduler once per sample period
+	 *
+	 * @param[in] info timing information for this tick
+	 */
+	void tick(const tickInfo& info) {
+		if (!inAuto)
+			return;
+		pendulumState x = myState->read(); // one consistent snapshot per sample
+		current = info;
+		uint64_t start = monotonicNow();
+		double u = derived().step(x);
+		stepTimes.record(monotonicNow() - start);
+		if (transferLeft > 0) {
+			// Start from the output the previous law left behind and fade the difference out
+			if (transferStart) {
+				transferOffset = transferFrom - u;
+				transferStart = false;
+			}
+			u += transferOffset * transferLeft / transferTicks;
+			transferLeft--;
+		}
+		double output = clamp(u);
+		myOutput->store(output);
+		if (telemetry != NULL) {
+			controllerTelemetry t;
+			t.tick = info.tick;
+			t.dt = info.dt + info.lateness / 1e9;
+			t.state = x;
+			t.u = u;
+			t.output = output;
+			telemetry(telemetryContext, t);
+		}
+	}
+
+	/*!
+	 * @brief Set Controller operating mode
+	 *  In auto mode the controller will alter the Output to drive towards
+	 * 				the SetPoint.
+	 * 				In manual mode the controller is disabled and control of the Output
+	 * 				is handled external to the controller
+	 *
+	 * @param[in] Mode controller mode 0=manual, 1=auto
+	 */
+	void SetMode(int Mode) {
+		bool newAuto = (Mode == 1);
+		if (newAuto && !inAuto) { /*we just went from manual to auto*/
+			derived().Initialize(myState->read());
+			transferFrom = myOutput->load();
+			transferStart = true;
+			transferLeft = transferTicks;
+		} else if (!newAuto && inAuto) {
+			derived().Stopped();
+		}
+		inAuto = newAuto;
+	}
+
+	/*!
+	 * @brief Set output limits for controller
+	 *  Clamps the output to a specific range, 0-100 by default.
+	 *
+	 * @param[in] Min Minimum limit
+	 * @param[in] Max Maximum limit
+	 */
+	void SetOutputLimits(double Min, double Max) {
+		if (Min >= Max)
+			return;
+		outMin = Min;
+		outMax = Max;
+		realMin = real(Min);
+		realMax = real(Max);
+		outputScale = real(outMax / supplyVoltage);
+		voltMin = real(toVolts(outMin));
+		voltMax = real(toVolts(outMax));
+
+		if (inAuto) {
+			myOutput->store(clamp(myOutput->load()));
+		}
+		derived().OutputLimitsChanged();
+	}
+
+	/*!
+	 * @brief Set the sample time the controller is run at
+	 *  This must match the period the controller is scheduled with.
+	 *
+	 * @param[in] NewSampleTime sample time in milliseconds
+	 */
+	void SetSampleTime(int NewSampleTime) {
+		if (NewSampleTime > 0) {
+			double newSampleTime = NewSampleTime / 1000.0;
+			double ratio = newSampleTime / SampleTime;
+			SampleTime = newSampleTime;
+			derived().SampleTimeChanged(ratio);
+		}
+	}
+
+	/*!
+	 * @brief Set controller direction
+	 *  Sets the Direction, or "Action" of the controller. DIRECT
+	 *				means the output will increase when error is positive. REVERSE
+	 *				means the opposite.  it's very unlikely that this will be needed
+	 *				once it is set in the constructor.
+	 *
+	 * @param[in] Direction 0=normal, 1=inverse
+	 */
+	void SetControllerDirection(int Direction) {
+		if (Direction != controllerDirection) {
+			controllerDirection = Direction;
+			derived().DirectionChanged();
+		}
+	}
+
+	/*!
+	 * @brief Blend from the previous output when switched to auto
+	 *  The difference between the output when the controller was switched on
+	 *  and its first computed output is added to the output and faded out
+	 *  linearly, so the motor does not step when control laws are swapped.
+	 *
+	 * @param[in] ticks number of samples to fade over, 0 to disable
+	 */
+	void SetTransferTicks(int ticks) {
+		transferTicks = (ticks > 0) ? ticks : 0;
+	}
+
+	/*!
+	 * @brief Set the motor supply voltage
+	 *  Laws that work in volts use it to scale to and from the output range,
+	 *  full scale output being the supply voltage.
+	 *
+	 * @param[in] volts supply voltage
+	 */
+	void SetSupplyVoltage(double volts) {
+		if (volts > 0) {
+			supplyVoltage = volts;
+			outputScale = real(outMax / supplyVoltage);
+			voltMin = real(toVolts(outMin));
+			voltMax = real(toVolts(outMax));
+		}
+	}
+
+	/*!
+	 * @brief Call hook with the state and output after every sample
+	 *  Set before the controller is started.
+	 *
+	 * @param[in] hook function to call, or NULL for none
+	 * @param[in] context passed to hook
+	 */
+	void SetTelemetry(telemetryHook hook, void* context) {
+		telemetryContext = context;
+		telemetry = hook;
+	}
+
+	inline int GetMode() {
+		return inAuto ? 1 : 0;
+	}
+
+	inline int GetDirection() {
+		return controllerDirection;
+	}
+
+	inline double GetSampleTime() {
+		return SampleTime;
+	}
+
+	const latencyHistogram& GetStepTimes() {
+		return stepTimes;
+	}
+
+	// Default hooks, hidden by control laws that need them
+	void Initialize(const pendulumState& x) {}
+	void Stopped() {}
+	void SampleTimeChanged(double ratio) {}
+	void DirectionChanged() {}
+	void OutputLimitsChanged() {}
+
+protected:
+	Derived& derived() {
+		return static_cast<Derived&>(*this);
+	}
+
+	inline double clamp(double value) const {
+		if (value > outMax) {
+			return outMax;
+		} else if (value < outMin) {
+			return outMin;
+		}
+		return value;
+	}
+
+	/*!
+	 * @brief clamp() in the control law number type
+	 */
+	inline real clampReal(real value) const {
+		if (value > realMax) {
+			return realMax;
+		} else if (value < realMin) {
+			return realMin;
+		}
+		return value;
+	}
+
+	/*!
+	 * @brief Clamp a motor voltage to the output limits, in real
+	 */
+	inline real clampVolts(real volts) const {
+		if (volts > voltMax) {
+			return voltMax;
+		} else if (volts < voltMin) {
+			return voltMin;
+		}
+		return volts;
+	}
+
+	/*!
+	 * @brief Output for a motor voltage
+	 */
+	inline double toOutput(double volts) const {
+		return outMax / supplyVoltage * volts;
+	}
+
+	/*!
+	 * @brief Motor voltage for an output
+	 */
+	inline double toVolts(double output) const {
+		return output * supplyVoltage / outMax;
+	}
+
+	/*!
+	 * @brief Timing of the tick being computed, for logging from step()
+	 */
+	inline const tickInfo& currentTick() const {
+		return current;
+	}
+
+	const pendulumStateBuffer *myState;	/*!< Pendulum & motor angle and velocity */
+	std::atomic<double> *myOutput;		/*!< Controller output */
+	double *mySetPoint;					/*!< Controller set point */
+
+	bool inAuto;
+	double SampleTime;					/*!< Sample time in seconds */
+	double outMin, outMax;
+	real realMin, realMax;				/*!< Output limits as real */
+	int controllerDirection;
+	double supplyVoltage;				/*!< Motor supply voltage in volts */
+	real outputScale;					/*!< Output per volt, toOutput() as real */
+	real voltMin, voltMax;				/*!< Output limits in volts, as real */
+
+private:
+	int transferTicks;
+	int transferLeft;
+	bool transferStart;
+	double transferFrom;
+	double transferOffset;
+
+	tickInfo current;
+	latencyHistogram stepTimes;
+	telemetryHook telemetry;
+	void *telemetryContext;
+};
+
+} /* namespace Controller */
+
+#endif /* INCLUDE_CONTROLLER_CONTROLLERBASE_H_ */
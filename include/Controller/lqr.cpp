@@ -13,66 +13,41 @@
 #include <Controller/lqr.h>
 #include <pendulum.h>
 #include <Pololu/pololuSMC.h>
-#include <threadedEQEP.h>
 #include <iostream>
 
 
 namespace Controller {
 
-lqr::lqr(double* _pAngle, double* _pVelocity, double* _mAngle, double* _mVelocity, double* Output,
+lqr::lqr(const pendulumStateBuffer* State, std::atomic<double>* Output,
 		 double* SetPoint, double _k1, double _k2, double _k3, double _k4, int dir) :
-		pAngle(_pAngle), pVelocity(_pVelocity),
-		mAngle(_mAngle), mVelocity(_mVelocity),
-		myOutput(Output), mySetPoint(SetPoint),
-		inAuto(false), SampleTime(10)
+		controllerBase<lqr>(State, Output, SetPoint, dir),
+		gainVersion(0),
+		K(Model::gainVector::zeros()),
+		designed(false),
+		filter(model, SampleTime, ENCODER_PPR, MOTOR_PPR),
+		lastVoltage(0)
 {
-	bExit.store(false);
-	SetOutputLimits(0, 100);
-	SetControllerDirection(dir);
+	Kr = matrix<1, STATE_SIZE, real>::zeros();
+	xr = vec<STATE_SIZE, real>::zeros();
+	SetEstimator();
 	SetTunings(_k1, _k2, _k3, _k4);
-	lastTime = std::chrono::high_resolution_clock::now();
 }
 
-void lqr::Compute() {
-	if (!inAuto)
-		return;
-	std::chrono::duration<float, std::deci> timeChange;
-	std::chrono::high_resolution_clock::time_point now = std::chrono::high_resolution_clock::now();
-	timeChange = (now - lastTime);
-	if (timeChange.count() >= SampleTime) {
-		/*Compute all the working error variables*/
-		double pA = *pAngle;
-		double pV = *pVelocity;
-		double mA = *mAngle;
-		double mV = *mVelocity;
-		double u = ( (k1 * pA) + (k2 * mA) + (k3 * pV) + (k4 * mV) );
-
-		double output = outMax / 11.7 * u;
-
-		if (output > outMax) {
-			output = outMax;
-		} else if (output < outMin) {
-			output = outMin;
-		}
-		*myOutput = output;
-		lastTime = now;
-
-		D(std::cout << timeChange.count() << ",";)
-		D(std::cout << pA << ",";)
-		D(std::cout << pV  << ",";)
-		D(std::cout << mA << ",";)
-		D(std::cout << mV << ",";)
-		D(std::cout << u << ",";)
-		D(std::cout << output << std::endl;)
-	}
-}
-
-void lqr::onStartHandler() {
-	Initialize();
-	D(std::cout << "pA,pV,mA,mV,u,dt"<< std::endl;)
-	while (!bExit.load()) {
-		this->Compute();
-		yield();
+lqr::lqr(const pendulumStateBuffer* State, std::atomic<double>* Output, double* SetPoint,
+		 const Model::pendulumParameters& params, const Model::lqrWeights& weights, int dir) :
+		controllerBase<lqr>(State, Output, SetPoint, dir),
+		gainVersion(0),
+		K(Model::gainVector::zeros()),
+		designed(false),
+		model(params),
+		filter(model, SampleTime, ENCODER_PPR, MOTOR_PPR),
+		lastVoltage(0)
+{
+	Kr = matrix<1, STATE_SIZE, real>::zeros();
+	xr = vec<STATE_SIZE, real>::zeros();
+	SetEstimator();
+	if (!Design(weights)) {
+		std::cerr << "LQR design failed, gains are zero" << std::endl;
 	}
 }
 
@@ -80,84 +55,75 @@ std::string lqr::name() {
 	return std::string("LQR");
 }
 
-void lqr::stop() {
-	bExit.store(true);
-}
 /* SetTunings(...)*************************************************************
  * This function allows the controller's dynamic performance to be adjusted.
  * it's called automatically from the constructor, but tunings can also
  * be adjusted on the fly during normal operation
  ******************************************************************************/
 void lqr::SetTunings(double _k1, double _k2, double _k3, double _k4) {
-
-	k1 = dispK1 = _k1;
-	k2 = dispK2 = _k2;
-	k3 = dispK3 = _k3;
-	k4 = dispK4 = _k4;
+	Model::gainVector k;
+	k[0] = _k1;
+	k[1] = _k2;
+	k[2] = _k3;
+	k[3] = _k4;
+	designed = false;
+	SetGains(k);
 }
 
-/* SetSampleTime(...) *********************************************************
- * sets the period, in Milliseconds, at which the calculation is performed
+/* Design(...) ****************************************************************
+ * solve the Riccati equation for the model at the current sample time.  the
+ * solver gives u = -K x, this controller uses u = K x
  ******************************************************************************/
-void lqr::SetSampleTime(int NewSampleTime) {
-	if (NewSampleTime > 0) {
-		SampleTime = (double) NewSampleTime / 1000.0;
+bool lqr::Design(const Model::lqrWeights& w) {
+	Model::gainVector k;
+	if (!Model::designLQR(model, SampleTime, w, k)) {
+		return false;
 	}
+	weights = w;
+	designed = true;
+	SetGains(-k);
+	return true;
 }
 
-/* SetOutputLimits(...)****************************************************
- *     This function will be used far more often than SetInputLimits.  while
- *  the input to the controller will generally be in the 0-1023 range (which is
- *  the default already,)  the output will be a little different.  maybe they'll
- *  be doing a time window and will need 0-8000 or something.  or maybe they'll
- *  want to clamp it from 0-125.  who knows.  at any rate, that can all be done
- *  here.
- **************************************************************************/
-void lqr::SetOutputLimits(double Min, double Max) {
-	if (Min >= Max)
-		return;
-	outMin = Min;
-	outMax = Max;
+void lqr::SetGains(const Model::gainVector& k) {
+	gains.publish(k);
+}
 
-	if (inAuto) {
-		if (*myOutput > outMax) {
-			*myOutput = outMax;
-		} else if (*myOutput < outMin) {
-			*myOutput = outMin;
-		}
-	}
+Model::gainVector lqr::GetGains() {
+	return gains.read();
 }
 
-/* SetMode(...)****************************************************************
- * Allows the controller Mode to be set to manual (0) or Automatic (non-zero)
- * when the transition from manual to auto occurs, the controller is
- * automatically initialized
+/* SampleTimeChanged(...) *****************************************************
+ * the filter's model and designed gains are discrete, redo them at the new
+ * period
  ******************************************************************************/
-void lqr::SetMode(int Mode) {
-	bool newAuto = (Mode == 1);
-	if (newAuto == !inAuto) { /*we just went from manual to auto*/
-		Initialize();
+void lqr::SampleTimeChanged(double ratio) {
+	filter.setModel(model, SampleTime);
+	SetEstimator();
+	if (designed) {
+		Design(weights);
 	}
-	inAuto = newAuto;
 }
 
 /* Initialize()****************************************************************
- *	does all the things that need to happen to ensure a bumpless transfer
- *  from manual to automatic mode.
+ *	restart the state estimate from the measured angles, at rest, and the
+ *  output the motor is currently being driven with
  ******************************************************************************/
-void lqr::Initialize() {
-	// reset lastTime in case thread wasn't run straight after being created.
-	lastTime = std::chrono::high_resolution_clock::now();
+void lqr::Initialize(const pendulumState& x) {
+	xr[0] = real(x.pAngle);
+	xr[1] = real(x.mAngle);
+	xr[2] = xr[3] = real(0);
+	lastVoltage = real(toVolts(clamp(myOutput->load())));
 }
 
-/* SetControllerDirection(...)*************************************************
- * The LQR will either be connected to a DIRECT acting process (+Output leads
- * to +Input) or a REVERSE acting process(+Output leads to -Input.)  we need to
- * know which one, because otherwise we may increase the output when we should
- * be decreasing.  This is called from the constructor.
+/* SetEstimator() *************************************************************
+ * the estimator runs in real with the gain the filter converges to, work it
+ * out in double and convert once
  ******************************************************************************/
-void lqr::SetControllerDirection(int Direction) {
-	controllerDirection = Direction;
+void lqr::SetEstimator() {
+	Ar = filter.transition().as<real>();
+	Br = filter.input().as<real>();
+	Lr = filter.steadyStateGain().as<real>();
 }
 
 }; /* namespace CONTROLLER */
@@ -24,49 +24,80 @@
 #ifndef INCLUDE_CONTROLLER_LQR_H_
 #define INCLUDE_CONTROLLER_LQR_H_
 
-#define DEBUG
-
-#ifdef DEBUG
-#define D(x) x
-#else
-#define D(x)
-#endif
-
-#include <BlackLib/BlackThread/BlackThread.h>
-#include <atomic>
 #include <cstdbool>
-#include <chrono>
 #include <string>
+#include <iostream>
+#include <Controller/controllerBase.h>
+#include <Model/kalman.h>
+#include <Model/dare.h>
+#include <seqlock.h>
+#include <fastTrig.h>
 
 namespace Controller {
 
-class lqr : public BlackLib::BlackThread {
+/*!
+ * @brief Gains tuned on the rig, u = K x in volts in stateVector order
+ *
+ * The LQR runs with these until the model parameters are identified well
+ * enough for the designed gains to balance the pendulum.  They don't balance
+ * the simulator with the motor fitted to data/motor_kt.
+ */
+const double LQR_TUNED_GAINS[STATE_SIZE] = { -23.1455, 126.3112, -5.7435, 7.5213 };
+
+class lqr : public controllerBase<lqr> {
 
 public:
 
 	/**
 	 * Linear Quadrature Regulator controller for inverted pendulum
 	 *
-	 * Uses pendulum and motor angle and velocities
+	 * Uses pendulum and motor angle and velocities.  The state is estimated
+	 * from the encoder angles and the motor voltage by a Kalman filter rather
+	 * than taken from the encoder velocity estimates.  The filter runs with
+	 * its steady state gain, computed in double when the model or sample
+	 * time changes, so each step is a fixed number of real operations.
 	 */
-	lqr(double* PendulumAngle, double* PendulumVelocity, double* MotorAngle, double* MotorVelocity, double* Output, double* SetPoint, double _k1,	double _k2, double _k3, double _k4, int dir);
+	lqr(const pendulumStateBuffer* State, std::atomic<double>* Output, double* SetPoint, double _k1,	double _k2, double _k3, double _k4, int dir);
 
-	void SetMode(int Mode); // * sets pid-new to either Manual (0) or Auto (non-0)
-
-	void SetOutputLimits(double Min, double Max); //clamps the output to a specific range. 0-255 by default, but
-												  //it's likely the user will want to change this depending on
-												  //the application
+	/**
+	 * Linear Quadrature Regulator with gains designed from the pendulum model
+	 *
+	 * The gains are recomputed whenever the sample time changes.
+	 */
+	lqr(const pendulumStateBuffer* State, std::atomic<double>* Output, double* SetPoint,
+		const Model::pendulumParameters& params, const Model::lqrWeights& weights, int dir);
 
 // available but not commonly used functions ********************************************************
 	void SetTunings(double k1, double k2, double k3, double k4);
 
-	void SetControllerDirection(int);// * Sets the Direction, or "Action" of the controller. DIRECT
-									 //   means the output will increase when error is positive. REVERSE
-									 //   means the opposite.  it's very unlikely that this will be needed
-									 //   once it is set in the constructor.
+	/*!
+	 * @brief Compute the gains from the model with new weights
+	 *
+	 * @param[in] weights LQR state and input weights
+	 * @return False if the Riccati equation could not be solved, the gains are unchanged
+	 */
+	bool Design(const Model::lqrWeights& weights);
 
-	void SetSampleTime(int NewSampleTime); // * sets the frequency, in Milliseconds, with which
-							 //   the pid-new calculation is performed.  default is 100
+	/*!
+	 * @brief Replace the gains, u = K x in volts
+	 *  The control thread picks the new gains up at its next tick without
+	 *  waiting.  Only one thread at a time may set gains.
+	 *
+	 * @param[in] k gains in stateVector order
+	 */
+	void SetGains(const Model::gainVector& k);
+
+	/*!
+	 * @brief Gains currently published to the control thread
+	 */
+	Model::gainVector GetGains();
+
+	/*!
+	 * @brief Pendulum model used by the estimator
+	 */
+	inline const Model::pendulumModel& GetModel() {
+		return model;
+	}
 
 	/* Status Funcions*************************************************************
 	 * Just because you set the Kp=-1 doesn't mean it actually happened.  these
@@ -74,63 +105,76 @@ public:
 	 * purposes.  this are the functions the PID Front-end uses for example
 	 ******************************************************************************/
 	inline double GetK1() {
-		return dispK1;
+		return GetGains()[0];
 	}
 	inline double GetK2() {
-		return dispK2;
+		return GetGains()[1];
 	}
 	inline double GetK3() {
-		return dispK3;
+		return GetGains()[2];
 	}
 	inline double GetK4() {
-		return dispK4;
-	}
-	inline int GetMode() {
-		return inAuto ? 1 : 0;
-	}
-	inline int GetDirection() {
-		return controllerDirection;
+		return GetGains()[3];
 	}
 
-	void onStartHandler();  // called by run() to do the work in the thread
+	inline double step(const pendulumState& x); // does the actual LQR calculations
 
 	std::string name();
 
-	void stop();			// stops the thread running.
-
 private:
-	void Initialize();
-	void Compute(); // does the actual PID calculations
-
-	std::atomic<bool> bExit; 	// flag to tell thread to quit
-
-	std::string _name = "LQR";
-
-	double dispK1;				// * we'll hold on to the tuning parameters in user-entered
-	double dispK2;				//   format for display purposes
-	double dispK3;				//
-	double dispK4;				//
-
-	double k1;
-	double k2;
-	double k3;
-	double k4;
-
-	int controllerDirection;
-
-	double *pAngle;  // * Pendulum angle & velocity
-	double *pVelocity;
-	double *mAngle;  // * Motor angle & velocity
-	double *mVelocity;
-	double *myOutput; //   This creates a hard link between the variables and the
-	double *mySetPoint; //   pid, freeing the user from having to constantly tell us
-						//   what these values are.  with pointers we'll just know.
+	friend class controllerBase<lqr>;
+
+	void Initialize(const pendulumState& x);
+	void SampleTimeChanged(double ratio);
+	void SetEstimator();				// convert the filter's model and steady state gain to real
+
+	seqlock<Model::gainVector> gains;	// published gains, u = K x
+	uint32_t gainVersion;				// version of gains copied to K
+	Model::gainVector K;				// control thread's copy of the gains
+	matrix<1, STATE_SIZE, real> Kr;		// K as real
+
+	bool designed;						// gains come from the model
+	Model::lqrWeights weights;			// weights of the last design
+
+	Model::pendulumModel model;
+	Model::kalman filter;				// designs the estimator, never updated
+	matrix<STATE_SIZE, STATE_SIZE, real> Ar;	// estimator transition
+	vec<STATE_SIZE, real> Br;			// estimator input, per volt
+	matrix<STATE_SIZE, 2, real> Lr;		// steady state Kalman gain
+	vec<STATE_SIZE, real> xr;			// state estimate
+	real lastVoltage;					// motor voltage applied over the last sample
+};
 
-	std::chrono::high_resolution_clock::time_point lastTime;
+double lqr::step(const pendulumState& x) {
+	if (gains.version() != gainVersion) {
+		gainVersion = gains.read(K);
+		Kr = K.as<real>();
+	}
+	// Predict from the last voltage, then correct with the measured angles
+	vec<STATE_SIZE, real> xp = Ar * xr + Br * lastVoltage;
+	// The pendulum angle wraps at +-pi, keep the estimate and its innovation on the same turn
+	vec<2, real> innovation;
+	innovation[0] = wrapDifference(real(x.pAngle) - xp[0]);
+	innovation[1] = real(x.mAngle) - xp[1];
+	xr = xp + Lr * innovation;
+	xr[0] = wrapDifference(xr[0]);
+
+	real u = (Kr * xr)[0];
+
+	real output = u * outputScale;
+	lastVoltage = clampVolts(u);
+
+	STEP_TRACE(const tickInfo& info = currentTick();)
+	STEP_TRACE(if (info.tick == 0) std::cout << "dt,pA,pV,mA,mV,u,output" << std::endl;)
+	STEP_TRACE(std::cout << info.dt + info.lateness / 1e9 << ",";)
+	STEP_TRACE(std::cout << xr[0] << ",";)
+	STEP_TRACE(std::cout << xr[2] << ",";)
+	STEP_TRACE(std::cout << xr[1] << ",";)
+	STEP_TRACE(std::cout << xr[3] << ",";)
+	STEP_TRACE(std::cout << u << ",";)
+	STEP_TRACE(std::cout << clampReal(output) << std::endl;)
+	return toDouble(output);
+}
 
-	bool inAuto;
-	double SampleTime;
-	double outMin, outMax;
-};
 }; /* namespace CONTROLLER */
 #endif /* INCLUDE_CONTROLLER_LQR_H_ */
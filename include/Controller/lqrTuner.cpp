@@ -0,0 +1,66 @@
+/**
+ * @file lqrTuner.cpp
+ * @brief Background redesign of the LQR gains
+ *
+ * @author Troy Dack
+ * @date Copyright (C) 2015
+ *
+ * @license
+ * \verbinclude "Troy Dack - GPL-2.0.txt"
+ *
+ **/
+
+#include <Controller/lqrTuner.h>
+#include <Controller/lqr.h>
+#include <chrono>
+#include <thread>
+
+namespace Controller {
+
+const int TUNER_POLL_MS = 50;	/*!< @brief How often the tuner checks for new weights */
+
+lqrTuner::lqrTuner(controllerTask* target)
+	: ctrl(dynamic_cast<lqr*>(target))
+	, done(0)
+	, bExit(false)
+	, nDesigns(0)
+	, nFailures(0)
+{
+}
+
+bool lqrTuner::valid() {
+	return ctrl != NULL;
+}
+
+void lqrTuner::request(const Model::lqrWeights& weights) {
+	pending.publish(weights);
+}
+
+void lqrTuner::onStartHandler() {
+	while (!bExit.load()) {
+		if (ctrl != NULL && pending.version() != done) {
+			Model::lqrWeights weights;
+			done = pending.read(weights);
+			if (ctrl->Design(weights)) {
+				nDesigns.fetch_add(1);
+			} else {
+				nFailures.fetch_add(1);
+			}
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds(TUNER_POLL_MS));
+	}
+}
+
+void lqrTuner::stop() {
+	bExit.store(true);
+}
+
+uint32_t lqrTuner::designs() {
+	return nDesigns.load();
+}
+
+uint32_t lqrTuner::failures() {
+	return nFailures.load();
+}
+
+} /* namespace Controller */
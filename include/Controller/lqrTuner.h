@@ -0,0 +1,97 @@
+/**
+ *! @file lqrTuner.h
+ *! Background redesign of the LQR gains
+ *!
+ *! @author troy
+ *! @date Copyright (C) 2015
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ **/
+
+#ifndef INCLUDE_CONTROLLER_LQRTUNER_H_
+#define INCLUDE_CONTROLLER_LQRTUNER_H_
+
+#include <BlackLib/BlackThread/BlackThread.h>
+#include <Controller/controllerBase.h>
+#include <Model/dare.h>
+#include <seqlock.h>
+#include <atomic>
+
+namespace Controller {
+
+class lqr;
+
+/*!
+ * @brief Recomputes the LQR gains on its own thread while the controller runs
+ *
+ * Solving the Riccati equation takes far longer than a control tick, so it is
+ * done here and the result is published to the controller, which picks it up
+ * at its next tick without waiting.  New weights are handed over the same way,
+ * so neither side ever blocks.
+ */
+class lqrTuner : public BlackLib::BlackThread {
+
+public:
+	/*!
+	 * @param[in] target controller to tune, does nothing unless it is an lqr
+	 */
+	lqrTuner(controllerTask* target);
+
+	/*!
+	 * @brief True if the target is an lqr controller
+	 */
+	bool valid();
+
+	/*!
+	 * @brief Ask for the gains to be recomputed with new weights
+	 *  Only one thread may make requests.
+	 *
+	 * @param[in] weights LQR state and input weights
+	 */
+	void request(const Model::lqrWeights& weights);
+
+	/*!
+	 * @brief Thread's start handler function.
+	 */
+	void onStartHandler();
+
+	/*!
+	 * @brief Stops the thread running
+	 */
+	void stop();
+
+	/*!
+	 * @brief Number of designs completed
+	 */
+	uint32_t designs();
+
+	/*!
+	 * @brief Number of designs that failed, leaving the gains unchanged
+	 */
+	uint32_t failures();
+
+private:
+	lqr *ctrl;
+	seqlock<Model::lqrWeights> pending;
+	uint32_t done;					// version of pending last designed
+	std::atomic<bool> bExit;
+	std::atomic<uint32_t> nDesigns;
+	std::atomic<uint32_t> nFailures;
+};
+
+} /* namespace Controller */
+
+#endif /* INCLUDE_CONTROLLER_LQRTUNER_H_ */
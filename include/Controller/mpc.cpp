@@ -0,0 +1,157 @@
+/**
+ * @file mpc.cpp
+ * @brief Model predictive controller with input limits
+ *
+ * @author Troy Dack
+ * @date Copyright (C) 2015
+ *
+ * @license
+ * \verbinclude "Troy Dack - GPL-2.0.txt"
+ *
+ **/
+
+#include <Controller/mpc.h>
+#include <pendulum.h>
+#include <iostream>
+
+
+namespace Controller {
+
+mpc::mpc(const pendulumStateBuffer* State, std::atomic<double>* Output, double* SetPoint,
+		 const Model::pendulumParameters& params, const Model::lqrWeights& weights, int dir) :
+		controllerBase<mpc>(State, Output, SetPoint, dir),
+		model(params),
+		weights(weights),
+		filter(model, SampleTime, ENCODER_PPR, MOTOR_PPR),
+		stepSize(0),
+		designed(false),
+		U(inputVector::zeros()),
+		lastVoltage(0),
+		deadband(0),
+		maxIterations(MPC_MAX_ITERATIONS),
+		budget(0),
+		tolerance(1e-4),
+		solves(0),
+		iterations(0),
+		capped(0),
+		lastIterations(0)
+{
+	if (!Design()) {
+		std::cerr << "MPC design failed, output is zero" << std::endl;
+	}
+}
+
+std::string mpc::name() {
+	return std::string("MPC");
+}
+
+void mpc::SetDeadband(double output) {
+	deadband = (output > 0) ? output : 0;
+}
+
+void mpc::SetSolverLimits(int iterations, int64_t ns) {
+	maxIterations = (iterations > 0) ? iterations : 1;
+	budget = (ns > 0) ? ns : 0;
+}
+
+mpcStats mpc::GetSolverStats() {
+	mpcStats s;
+	s.solves = solves.load(std::memory_order_relaxed);
+	s.iterations = iterations.load(std::memory_order_relaxed);
+	s.capped = capped.load(std::memory_order_relaxed);
+	s.lastIterations = lastIterations.load(std::memory_order_relaxed);
+	return s;
+}
+
+/* Design() *******************************************************************
+ * Condense the horizon into a QP in the inputs alone.  With x[k] = A^k x0 +
+ * sum A^(k-1-j) B u[j], the cost sum x[k]'Q x[k] + r u[k]^2 (P on the last
+ * state) is 1/2 U'HU + (F x0)'U plus a constant.  Only F x0 changes each tick.
+ ******************************************************************************/
+bool mpc::Design() {
+	Model::stateMatrix A, Q, P;
+	stateVector B;
+	model.discretise(SampleTime, A, B);
+	Q = Model::stateMatrix::zeros();
+	for (int i = 0; i < STATE_SIZE; i++) {
+		Q(i, i) = weights.q[i];
+	}
+	if (!Model::solveDARE(A, B, Q, weights.r, P)) {
+		designed = false;
+		return false;
+	}
+
+	// A^k B and A^k for k = 0..N
+	stateVector AkB[MPC_HORIZON];
+	Model::stateMatrix Ak[MPC_HORIZON + 1];
+	Ak[0] = Model::stateMatrix::identity();
+	for (int k = 1; k <= MPC_HORIZON; k++) {
+		Ak[k] = A * Ak[k - 1];
+	}
+	for (int k = 0; k < MPC_HORIZON; k++) {
+		AkB[k] = Ak[k] * B;
+	}
+
+	H = matrix<MPC_HORIZON, MPC_HORIZON>::zeros();
+	F = matrix<MPC_HORIZON, STATE_SIZE>::zeros();
+	for (int k = 1; k <= MPC_HORIZON; k++) {
+		const Model::stateMatrix& Qk = (k == MPC_HORIZON) ? P : Q;
+		// Input j affects x[k] through A^(k-1-j) B for j < k
+		for (int i = 0; i < k; i++) {
+			matrix<1, STATE_SIZE> gQ = AkB[k - 1 - i].transpose() * Qk;
+			for (int j = 0; j < k; j++) {
+				H(i, j) += (gQ * AkB[k - 1 - j])[0];
+			}
+			matrix<1, STATE_SIZE> f = gQ * Ak[k];
+			for (int c = 0; c < STATE_SIZE; c++) {
+				F(i, c) += f[c];
+			}
+		}
+	}
+	for (int i = 0; i < MPC_HORIZON; i++) {
+		H(i, i) += weights.r;
+	}
+
+	// Largest eigenvalue of H by power iteration, it sets the gradient step
+	inputVector v;
+	for (int i = 0; i < MPC_HORIZON; i++) {
+		v[i] = 1;
+	}
+	double lambda = 0;
+	for (int k = 0; k < 100; k++) {
+		inputVector w = H * v;
+		lambda = std::sqrt(w.dot(w));
+		if (lambda == 0) {
+			designed = false;
+			return false;
+		}
+		v = w * (1 / lambda);
+	}
+	stepSize = 1 / (lambda * 1.01);
+	U = inputVector::zeros();
+	designed = true;
+	return true;
+}
+
+/* SampleTimeChanged(...) *****************************************************
+ * the model and the QP are discrete, rebuild them at the new period
+ ******************************************************************************/
+void mpc::SampleTimeChanged(double ratio) {
+	filter.setModel(model, SampleTime);
+	if (!Design()) {
+		std::cerr << "MPC design failed, output is zero" << std::endl;
+	}
+}
+
+/* Initialize()****************************************************************
+ *	restart the state estimate and plan from the current state and output
+ ******************************************************************************/
+void mpc::Initialize(const pendulumState& x) {
+	filter.reset(x);
+	lastVoltage = toVolts(clamp(myOutput->load()));
+	for (int i = 0; i < MPC_HORIZON; i++) {
+		U[i] = lastVoltage;
+	}
+}
+
+}; /* namespace CONTROLLER */
@@ -0,0 +1,219 @@
+/**
+ *! @file mpc.h
+ *! Model predictive controller with input limits
+ *!
+ *! @author troy
+ *! @date Copyright (C) 2015
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ **/
+
+#ifndef INCLUDE_CONTROLLER_MPC_H_
+#define INCLUDE_CONTROLLER_MPC_H_
+
+#include <cstdbool>
+#include <string>
+#include <iostream>
+#include <cmath>
+#include <Controller/controllerBase.h>
+#include <Model/kalman.h>
+#include <Model/dare.h>
+
+namespace Controller {
+
+const int MPC_HORIZON = 20;			/*!< @brief Number of future samples the input is optimised over */
+const int MPC_MAX_ITERATIONS = 60;	/*!< @brief Default cap on solver iterations per tick */
+
+/*!
+ * @brief Solver statistics for the model predictive controller
+ */
+struct mpcStats {
+	uint64_t solves;		/*!< Number of ticks solved */
+	uint64_t iterations;	/*!< Total solver iterations */
+	uint64_t capped;		/*!< Solves stopped by the iteration or time cap before converging */
+	int lastIterations;		/*!< Iterations used by the last solve */
+};
+
+class mpc : public controllerBase<mpc> {
+
+public:
+
+	/**
+	 * @brief Model predictive controller for inverted pendulum
+	 *
+	 * Each tick minimises the LQR cost over the next MPC_HORIZON samples,
+	 * with the LQR Riccati solution as the terminal cost, subject to the motor
+	 * voltage limits.  The output limits less the motor deadband that
+	 * motorCommand() adds are the limits the solver respects, so unlike the
+	 * linear controllers it plans around saturation when recovering from
+	 * large angles.
+	 *
+	 * The quadratic program is solved by accelerated projected gradient, warm
+	 * started from the previous tick's plan shifted by one sample.  The work
+	 * is capped by an iteration count and a time budget, whichever comes
+	 * first, so a tick never overruns; a capped solve still gives a feasible
+	 * (if suboptimal) input.  The state comes from the same Kalman filter as
+	 * the LQR controller.
+	 *
+	 * @param[in] State pendulum state, the encoder angles are used
+	 * @param[out] Output motor speed
+	 * @param[in] SetPoint target for controller
+	 * @param[in] params pendulum parameters for the model
+	 * @param[in] weights state and input weights
+	 * @param[in] dir Direction controller is to operate in. 0=normal, 1=inverse
+	 */
+	mpc(const pendulumStateBuffer* State, std::atomic<double>* Output, double* SetPoint,
+		const Model::pendulumParameters& params, const Model::lqrWeights& weights, int dir);
+
+	/*!
+	 * @brief Set the motor deadband the output limits are reduced by
+	 *
+	 * @param[in] output deadband in output units
+	 */
+	void SetDeadband(double output);
+
+	/*!
+	 * @brief Cap the work done each tick
+	 *
+	 * @param[in] iterations maximum solver iterations
+	 * @param[in] ns maximum solve time in nanoseconds, 0 for a quarter of the sample time
+	 */
+	void SetSolverLimits(int iterations, int64_t ns);
+
+	/*!
+	 * @brief Solver statistics
+	 */
+	mpcStats GetSolverStats();
+
+	/*!
+	 * @brief State estimator, for its timing statistics
+	 */
+	inline Model::kalman& GetEstimator() {
+		return filter;
+	}
+
+	/*!
+	 * @brief Solve for this sample
+	 *
+	 * @param[in] x pendulum state for this sample
+	 * @return output before clamping
+	 */
+	inline double step(const pendulumState& x);
+
+	std::string name();
+
+private:
+	friend class controllerBase<mpc>;
+
+	void Initialize(const pendulumState& x);
+	void SampleTimeChanged(double ratio);
+
+	typedef vec<MPC_HORIZON> inputVector;
+
+	/*!
+	 * @brief Build the condensed quadratic program for the current sample time
+	 */
+	bool Design();
+
+	Model::pendulumModel model;
+	Model::lqrWeights weights;
+	Model::kalman filter;
+
+	// Cost over the horizon is 1/2 U'HU + (F x)'U for the input sequence U
+	matrix<MPC_HORIZON, MPC_HORIZON> H;
+	matrix<MPC_HORIZON, STATE_SIZE> F;
+	double stepSize;			// 1 / largest eigenvalue of H
+	bool designed;
+
+	inputVector U;				// plan from the last tick, in volts
+	double lastVoltage;			// motor voltage applied over the last sample
+	double deadband;
+	int maxIterations;
+	int64_t budget;
+	double tolerance;			// converged when no input moves more than this, volts
+
+	std::atomic<uint64_t> solves;
+	std::atomic<uint64_t> iterations;
+	std::atomic<uint64_t> capped;
+	std::atomic<int> lastIterations;
+};
+
+double mpc::step(const pendulumState& x) {
+	uint64_t start = monotonicNow();
+	stateVector xf = filter.update(x, lastVoltage);
+	if (!designed) {
+		lastVoltage = 0;
+		return 0;
+	}
+
+	double uMax = toVolts(outMax - deadband);
+	double uMin = toVolts(outMin + deadband);
+	int64_t limit = (budget > 0) ? budget : (int64_t)(SampleTime * 1e9 / 4);
+
+	// Warm start from the last plan, one sample on
+	for (int i = 0; i < MPC_HORIZON - 1; i++) {
+		U[i] = U[i + 1];
+	}
+	inputVector g = F * xf;
+
+	// Accelerated projected gradient (FISTA) on the box uMin <= U <= uMax
+	inputVector y = U;
+	double t = 1;
+	int it = 0;
+	bool converged = false;
+	while (it < maxIterations) {
+		inputVector next = y - (H * y + g) * stepSize;
+		double change = 0;
+		for (int i = 0; i < MPC_HORIZON; i++) {
+			next[i] = next[i] > uMax ? uMax : (next[i] < uMin ? uMin : next[i]);
+			change = std::max(change, std::abs(next[i] - U[i]));
+		}
+		double tNext = (1 + std::sqrt(1 + 4 * t * t)) / 2;
+		y = next + (next - U) * ((t - 1) / tNext);
+		U = next;
+		t = tNext;
+		it++;
+		if (change < tolerance) {
+			converged = true;
+			break;
+		}
+		if ((int64_t)(monotonicNow() - start) > limit) {
+			break;
+		}
+	}
+
+	// Only the control thread updates, so relaxed load/store pairs are enough
+	solves.store(solves.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	iterations.store(iterations.load(std::memory_order_relaxed) + it, std::memory_order_relaxed);
+	if (!converged) {
+		capped.store(capped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	}
+	lastIterations.store(it, std::memory_order_relaxed);
+
+	double u = U[0];
+	double output = toOutput(u);
+	lastVoltage = toVolts(clamp(output));
+
+	STEP_TRACE(const tickInfo& info = currentTick();)
+	STEP_TRACE(if (info.tick == 0) std::cout << "dt,pA,pV,mA,mV,iterations,u,output" << std::endl;)
+	STEP_TRACE(std::cout << info.dt + info.lateness / 1e9 << ",";)
+	STEP_TRACE(std::cout << xf[0] << "," << xf[2] << "," << xf[1] << "," << xf[3] << ",";)
+	STEP_TRACE(std::cout << it << "," << u << "," << clamp(output) << std::endl;)
+	return output;
+}
+
+}; /* namespace CONTROLLER */
+#endif /* INCLUDE_CONTROLLER_MPC_H_ */
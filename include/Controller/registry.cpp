@@ -0,0 +1,161 @@
+/**
+ * @file registry.cpp
+ * @brief Run time selection of the pendulum control law
+ *
+ * @author Troy Dack
+ * @date Copyright (C) 2015
+ *
+ * @license
+ * \verbinclude "Troy Dack - GPL-2.0.txt"
+ *
+ **/
+
+#include <Controller/registry.h>
+#include <Controller/basic.h>
+#include <Controller/velocity.h>
+#include <Controller/lqr.h>
+#include <Controller/mpc.h>
+#include <Controller/swingUp.h>
+#include <controlPipeline.h>
+#include <strings.h>
+
+namespace Controller {
+
+registry::registry()
+	: nControllers(0)
+	, running(0)
+	, requested(0)
+	, published(0)
+	, nSwitches(0)
+{
+}
+
+registry::~registry() {
+	for (int i = 0; i < nControllers; i++) {
+		delete controllers[i];
+	}
+}
+
+int registry::add(controllerTask* ctrl) {
+	if (nControllers >= MAX_CONTROLLERS) {
+		return -1;
+	}
+	controllers[nControllers] = ctrl;
+	return nControllers++;
+}
+
+int registry::find(const std::string& name) {
+	for (int i = 0; i < nControllers; i++) {
+		if (strcasecmp(controllers[i]->name().c_str(), name.c_str()) == 0) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+bool registry::select(int id) {
+	if (id < 0 || id >= nControllers) {
+		return false;
+	}
+	requested.store(id, std::memory_order_release);
+	return true;
+}
+
+void registry::next() {
+	if (nControllers == 0) {
+		return;
+	}
+	// Lock free compare and swap, so this is safe in a signal handler
+	int id = requested.load(std::memory_order_relaxed);
+	while (!requested.compare_exchange_weak(id, (id + 1) % nControllers, std::memory_order_release)) {
+	}
+}
+
+void registry::tick(const tickInfo& info) {
+	int want = requested.load(std::memory_order_acquire);
+	if (want != running) {
+		// Switch at the tick boundary, the new law starts from the current output
+		int mode = controllers[running]->GetMode();
+		controllers[running]->SetMode(0);
+		controllers[want]->SetMode(mode);
+		running = want;
+		published.store(running, std::memory_order_release);
+		nSwitches.fetch_add(1, std::memory_order_relaxed);
+	}
+	controllers[running]->tick(info);
+}
+
+void registry::SetMode(int Mode) {
+	// Not scheduled yet, so take any selection made so far straight away
+	running = requested.load(std::memory_order_acquire);
+	published.store(running, std::memory_order_release);
+	controllers[running]->SetMode(Mode);
+}
+
+void registry::SetOutputLimits(double Min, double Max) {
+	for (int i = 0; i < nControllers; i++) {
+		controllers[i]->SetOutputLimits(Min, Max);
+	}
+}
+
+void registry::SetSampleTime(int NewSampleTime) {
+	for (int i = 0; i < nControllers; i++) {
+		controllers[i]->SetSampleTime(NewSampleTime);
+	}
+}
+
+void registry::SetTransferTicks(int ticks) {
+	for (int i = 0; i < nControllers; i++) {
+		controllers[i]->SetTransferTicks(ticks);
+	}
+}
+
+void registry::SetSupplyVoltage(double volts) {
+	for (int i = 0; i < nControllers; i++) {
+		controllers[i]->SetSupplyVoltage(volts);
+	}
+}
+
+int registry::active() {
+	return published.load(std::memory_order_acquire);
+}
+
+uint32_t registry::switches() {
+	return nSwitches.load(std::memory_order_relaxed);
+}
+
+int registry::size() {
+	return nControllers;
+}
+
+controllerTask* registry::get(int id) {
+	return (id >= 0 && id < nControllers) ? controllers[id] : NULL;
+}
+
+std::string registry::names() {
+	std::string list;
+	for (int i = 0; i < nControllers; i++) {
+		list += (i > 0 ? " " : "") + controllers[i]->name();
+	}
+	return list;
+}
+
+void addBuiltinControllers(registry& reg, const pendulumStateBuffer* State, std::atomic<double>* Output,
+						   double* SetPoint, std::atomic<double>* Cutoff, double kp, double ki, double kd, int dir,
+						   const Model::pendulumParameters& params, const Model::lqrWeights& weights,
+						   bool design) {
+	reg.add(new basic(State, Output, SetPoint, kp, ki, kd, dir));
+	reg.add(new velocity(State, Output, SetPoint, kp, ki, kd, dir));
+	lqr *balance = new lqr(State, Output, SetPoint, params, weights, dir);
+	if (!design) {
+		balance->SetTunings(LQR_TUNED_GAINS[0], LQR_TUNED_GAINS[1], LQR_TUNED_GAINS[2], LQR_TUNED_GAINS[3]);
+	}
+	reg.add(balance);
+	mpc *predictive = new mpc(State, Output, SetPoint, params, weights, dir);
+	predictive->SetDeadband(MOTOR_DEADBAND);
+	reg.add(predictive);
+	// Catches with the LQR law, which has the largest region it can recover from
+	reg.add(new swingUp(State, Output, SetPoint, params, balance, Cutoff, dir));
+}
+
+} /* namespace Controller */
@@ -0,0 +1,180 @@
+/**
+ *! @file registry.h
+ *! Run time selection of the pendulum control law
+ *!
+ *! @author troy
+ *! @date Copyright (C) 2015
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ **/
+
+#ifndef INCLUDE_CONTROLLER_REGISTRY_H_
+#define INCLUDE_CONTROLLER_REGISTRY_H_
+
+#include <Controller/controllerBase.h>
+#include <Model/dare.h>
+#include <atomic>
+#include <string>
+
+namespace Controller {
+
+/*!
+ * @brief Set of control laws, one of which is run each tick
+ *
+ * Every controller is constructed up front and bound to the same state and
+ * output.  The registry is scheduled in place of a controller and forwards
+ * each tick to the active one.  select() and next() only record the request;
+ * the switch happens at the start of the next tick on the control thread, so
+ * it never allocates or locks and the laws are never run concurrently.  The
+ * outgoing law is put in manual and the incoming one in auto, which
+ * initialises it from the current output for a bumpless transfer.
+ */
+class registry : public periodicTask {
+
+public:
+	static const int MAX_CONTROLLERS = 8;	/*!< Maximum number of controllers that can be added */
+
+	registry();
+
+	/*!
+	 * @brief Deletes all of the controllers
+	 */
+	~registry();
+
+	/*!
+	 * @brief Add a controller, the registry takes ownership of it
+	 *  Controllers must be added before the registry is scheduled.  The first
+	 *  controller added is active until another is selected.
+	 *
+	 * @param[in] ctrl controller to add
+	 * @return controller id, or -1 if the registry is full
+	 */
+	int add(controllerTask* ctrl);
+
+	/*!
+	 * @brief Find a controller by name, ignoring case
+	 *
+	 * @param[in] name controller name, eg: lqr
+	 * @return controller id, or -1 if there is no controller with that name
+	 */
+	int find(const std::string& name);
+
+	/*!
+	 * @brief Request a switch to a controller at the next tick
+	 *
+	 * @param[in] id controller id
+	 * @return False if id is not a valid controller
+	 */
+	bool select(int id);
+
+	/*!
+	 * @brief Request a switch to the next controller at the next tick
+	 *  Safe to call from a signal handler.
+	 */
+	void next();
+
+	/*!
+	 * @brief Called by periodicScheduler once per sample period
+	 *  Switches controller if one was requested then runs the active controller.
+	 *
+	 * @param[in] info timing information for this tick
+	 */
+	void tick(const tickInfo& info);
+
+	/*!
+	 * @brief Put the selected controller in manual (0) or auto (1)
+	 *  Call before the registry is scheduled, after that switch with select().
+	 */
+	void SetMode(int Mode);
+
+	/*!
+	 * @brief Set output limits of every controller
+	 */
+	void SetOutputLimits(double Min, double Max);
+
+	/*!
+	 * @brief Set sample time, in milliseconds, of every controller
+	 */
+	void SetSampleTime(int NewSampleTime);
+
+	/*!
+	 * @brief Set the number of samples every controller blends over when switched in
+	 */
+	void SetTransferTicks(int ticks);
+
+	/*!
+	 * @brief Set the motor supply voltage of every controller
+	 */
+	void SetSupplyVoltage(double volts);
+
+	/*!
+	 * @brief Id of the controller that is running
+	 */
+	int active();
+
+	/*!
+	 * @brief Number of times the controller has been switched
+	 */
+	uint32_t switches();
+
+	/*!
+	 * @brief Number of controllers added
+	 */
+	int size();
+
+	/*!
+	 * @brief Controller with the given id
+	 */
+	controllerTask* get(int id);
+
+	/*!
+	 * @brief Names of all controllers, separated by spaces
+	 */
+	std::string names();
+
+private:
+	controllerTask *controllers[MAX_CONTROLLERS];
+	int nControllers;
+	int running;						// owned by the control thread once scheduled
+	std::atomic<int> requested;			// written by select()/next()
+	std::atomic<int> published;			// copy of running for other threads
+	std::atomic<uint32_t> nSwitches;
+};
+
+/*!
+ * @brief Create every built in control law and add it to a registry
+ *
+ * @param[in,out] reg registry to add to
+ * @param[in] State pendulum state the controllers read
+ * @param[out] Output controller output
+ * @param[in] SetPoint target for the controllers
+ * @param[in,out] Cutoff motor cutoff angle, the swing up controller lifts it while swinging
+ * @param[in] kp Proportional constant for the PID controllers
+ * @param[in] ki Integral constant for the PID controllers
+ * @param[in] kd Derivative constant for the PID controllers
+ * @param[in] dir Direction controllers are to operate in. 0=normal, 1=inverse
+ * @param[in] params pendulum parameters the LQR model and gains are built from
+ * @param[in] weights LQR weights
+ * @param[in] design Design the LQR gains from params and weights, otherwise use LQR_TUNED_GAINS
+ */
+void addBuiltinControllers(registry& reg, const pendulumStateBuffer* State, std::atomic<double>* Output,
+						   double* SetPoint, std::atomic<double>* Cutoff, double kp, double ki, double kd, int dir,
+						   const Model::pendulumParameters& params, const Model::lqrWeights& weights,
+						   bool design);
+
+} /* namespace Controller */
+
+#endif /* INCLUDE_CONTROLLER_REGISTRY_H_ */
@@ -0,0 +1,79 @@
+/**
+ * @file swingUp.cpp
+ * @brief Energy based swing up with catch into a balancing controller
+ *
+ * @author Troy Dack
+ * @date Copyright (C) 2015
+ *
+ * @license
+ * \verbinclude "Troy Dack - GPL-2.0.txt"
+ *
+ **/
+
+#include <Controller/swingUp.h>
+#include <iostream>
+
+
+namespace Controller {
+
+swingUp::swingUp(const pendulumStateBuffer* State, std::atomic<double>* Output, double* SetPoint,
+				 const Model::pendulumParameters& params, controllerTask* balance,
+				 std::atomic<double>* Cutoff, int dir) :
+		controllerBase<swingUp>(State, Output, SetPoint, dir),
+		balance(balance),
+		cutoff(Cutoff),
+		restoreCutoff(0),
+		balancing(false),
+		catchAngle(SWING_CATCH_ANGLE * M_PI / 180),
+		catchRate(SWING_CATCH_RATE * M_PI / 180),
+		fallAngle(SWING_FALL_ANGLE * M_PI / 180),
+		publishedBalancing(false),
+		catches(0),
+		falls(0),
+		energy(0)
+{
+	double lp = params.pendulumLength / 2;
+	inertia = params.pendulumInertia + params.pendulumMass * lp * lp;
+	weight = params.pendulumMass * params.gravity * lp;
+	targetEnergy = SWING_ENERGY_MARGIN * 2 * weight;
+}
+
+std::string swingUp::name() {
+	return std::string("SwingUp");
+}
+
+swingStats swingUp::GetStats() {
+	swingStats s;
+	s.balancing = publishedBalancing.load(std::memory_order_relaxed);
+	s.catches = catches.load(std::memory_order_relaxed);
+	s.falls = falls.load(std::memory_order_relaxed);
+	s.energy = energy.load(std::memory_order_relaxed);
+	return s;
+}
+
+/* Initialize()****************************************************************
+ *	swing from wherever the pendulum is, the motor must run past the cutoff
+ ******************************************************************************/
+void swingUp::Initialize(const pendulumState& x) {
+	balancing = false;
+	publishedBalancing.store(false, std::memory_order_relaxed);
+	if (cutoff != NULL) {
+		restoreCutoff = cutoff->exchange(0);
+	}
+}
+
+/* Stopped() ******************************************************************
+ *	hand the output back, the balancing law stops with us
+ ******************************************************************************/
+void swingUp::Stopped() {
+	if (balancing) {
+		balance->SetMode(0);
+		balancing = false;
+		publishedBalancing.store(false, std::memory_order_relaxed);
+	}
+	if (cutoff != NULL) {
+		cutoff->store(restoreCutoff);
+	}
+}
+
+}; /* namespace CONTROLLER */
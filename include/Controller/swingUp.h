@@ -0,0 +1,161 @@
+/**
+ *! @file swingUp.h
+ *! Energy based swing up with catch into a balancing controller
+ *!
+ *! @author troy
+ *! @date Copyright (C) 2015
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ **/
+
+#ifndef INCLUDE_CONTROLLER_SWINGUP_H_
+#define INCLUDE_CONTROLLER_SWINGUP_H_
+
+#include <cstdbool>
+#include <string>
+#include <iostream>
+#include <cmath>
+#include <Controller/controllerBase.h>
+#include <Model/pendulumModel.h>
+#include <fastTrig.h>
+
+namespace Controller {
+
+const double SWING_PUMP_VOLTAGE = 6.0;		/*!< @brief Largest motor voltage used to pump energy */
+const double SWING_ENERGY_GAIN = 60.0;		/*!< @brief Volts per Joule of energy short of the target */
+const double SWING_ENERGY_MARGIN = 0.25;	/*!< @brief Energy aimed for above upright at rest, as a fraction of 2 m g l */
+const double SWING_ARM_KP = 1.0;			/*!< @brief Volts per radian pulling the arm back to its start */
+const double SWING_ARM_KD = 0.05;			/*!< @brief Volts per radian/second damping the arm */
+const double SWING_CATCH_ANGLE = 20;		/*!< @brief Degrees from vertical the balancing law takes over inside */
+const double SWING_CATCH_RATE = 540;		/*!< @brief Largest pendulum speed, degrees/second, at the catch */
+const double SWING_FALL_ANGLE = 30;			/*!< @brief Degrees from vertical that count as a fall */
+
+/*!
+ * @brief Swing up statistics
+ */
+struct swingStats {
+	bool balancing;			/*!< True while the balancing law is in control */
+	uint32_t catches;		/*!< Number of times the balancing law has taken over */
+	uint32_t falls;			/*!< Number of times the pendulum fell and swinging restarted */
+	double energy;			/*!< Pendulum energy at the last sample, J, 0 at rest upright */
+};
+
+class swingUp : public controllerBase<swingUp> {
+
+public:
+
+	/**
+	 * @brief Energy based swing up for a pendulum hanging at rest
+	 *
+	 * While swinging the pendulum energy is driven to a little more than that
+	 * of the pendulum at rest upright (Astrom & Furuta), the margin making up
+	 * for the energy the arm takes back as the pendulum rises.  The arm is accelerated in the direction
+	 * of cos(pAngle) * pVelocity, which does positive work on the pendulum,
+	 * with a voltage proportional to the energy still needed, plus a weak pull
+	 * of the arm back to where it started.  Within SWING_CATCH_ANGLE of
+	 * vertical and below SWING_CATCH_RATE the balancing law is switched in,
+	 * starting from the current output, and ticked from here so both run on
+	 * the same thread with no hand over delay.  If the pendulum falls more than
+	 * SWING_FALL_ANGLE from vertical swinging restarts.
+	 *
+	 * The motor cutoff angle is disabled while this controller is in auto and
+	 * restored when it is switched out.
+	 *
+	 * @param[in] State pendulum state, 0 = upright and +-pi hanging
+	 * @param[out] Output motor speed
+	 * @param[in] SetPoint target for controller
+	 * @param[in] params pendulum parameters, for the energy
+	 * @param[in] balance controller to catch with, it must share State and Output
+	 * @param[in,out] Cutoff motor cutoff angle in degrees, eg: controlSignals::cutoffAngle
+	 * @param[in] dir Direction controller is to operate in. 0=normal, 1=inverse
+	 */
+	swingUp(const pendulumStateBuffer* State, std::atomic<double>* Output, double* SetPoint,
+			const Model::pendulumParameters& params, controllerTask* balance,
+			std::atomic<double>* Cutoff, int dir);
+
+	/*!
+	 * @brief Catches, falls and energy
+	 */
+	swingStats GetStats();
+
+	/*!
+	 * @brief Compute the output for this sample
+	 *
+	 * @param[in] x pendulum state for this sample
+	 * @return output before clamping
+	 */
+	inline double step(const pendulumState& x);
+
+	std::string name();
+
+private:
+	friend class controllerBase<swingUp>;
+
+	void Initialize(const pendulumState& x);
+	void Stopped();
+
+	controllerTask *balance;		// balancing law, ticked from here once caught
+	std::atomic<double> *cutoff;
+	double restoreCutoff;			// cutoff angle to put back when stopped
+	bool balancing;
+
+	double inertia;					// pendulum about the pivot
+	double weight;					// m g l to the centre of mass
+	double targetEnergy;
+	double catchAngle, catchRate, fallAngle;	// radians and radians/second
+
+	std::atomic<bool> publishedBalancing;
+	std::atomic<uint32_t> catches;
+	std::atomic<uint32_t> falls;
+	std::atomic<double> energy;
+};
+
+double swingUp::step(const pendulumState& x) {
+	double angle = wrapAngle(x.pAngle);
+	double c = fastCos(angle);
+	double e = 0.5 * inertia * x.pVelocity * x.pVelocity + weight * (c - 1);
+	energy.store(e, std::memory_order_relaxed);
+
+	if (balancing && std::abs(angle) > fallAngle) {
+		balance->SetMode(0);
+		balancing = false;
+		publishedBalancing.store(false, std::memory_order_relaxed);
+		falls.store(falls.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	} else if (!balancing && std::abs(angle) < catchAngle && std::abs(x.pVelocity) < catchRate) {
+		// The balancing law starts from the output we last wrote
+		balance->SetMode(1);
+		balancing = true;
+		publishedBalancing.store(true, std::memory_order_relaxed);
+		catches.store(catches.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	}
+	if (balancing) {
+		balance->tick(currentTick());
+		return myOutput->load();
+	}
+
+	// Pump towards upright energy, positive arm acceleration adds energy when cos * velocity > 0
+	double pump = SWING_ENERGY_GAIN * (targetEnergy - e);
+	pump = pump > SWING_PUMP_VOLTAGE ? SWING_PUMP_VOLTAGE : (pump < -SWING_PUMP_VOLTAGE ? -SWING_PUMP_VOLTAGE : pump);
+	double u = ((x.pVelocity * c >= 0) ? pump : -pump) - SWING_ARM_KP * x.mAngle - SWING_ARM_KD * x.mVelocity;
+
+	STEP_TRACE(const tickInfo& info = currentTick();)
+	STEP_TRACE(std::cout << info.dt + info.lateness / 1e9 << ",";)
+	STEP_TRACE(std::cout << angle << "," << x.pVelocity << "," << e << "," << u << std::endl;)
+	return toOutput(u);
+}
+
+}; /* namespace CONTROLLER */
+#endif /* INCLUDE_CONTROLLER_SWINGUP_H_ */
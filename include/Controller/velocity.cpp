@@ -13,70 +13,19 @@
 #include <Controller/velocity.h>
 #include <pendulum.h>
 #include <Pololu/pololuSMC.h>
-#include <threadedEQEP.h>
 #include <iostream>
 
 
 namespace Controller {
-
-velocity::velocity(double* Angle, double* Velocity, double* Output, double* SetPoint, double _kp, double _ki, double _kd, int dir) :
-		myAngle(Angle), myVelocity(Velocity), myOutput(Output), mySetPoint(SetPoint), inAuto(false), SampleTime(0.1) {
-	bExit.store(false);
-	SetOutputLimits(0, 100);
-	SetControllerDirection(dir);
+velocity::velocity(const pendulumStateBuffer* State, std::atomic<double>* Output, double* SetPoint, double _kp, double _ki, double _kd, int dir) :
+		controllerBase<velocity>(State, Output, SetPoint, dir) {
 	SetTunings(_kp, _ki, _kd);
-	lastTime = std::chrono::high_resolution_clock::now();
-}
-
-void velocity::Compute() {
-	if (!inAuto)
-		return;
-	std::chrono::duration<float, std::deci> timeChange;
-	std::chrono::high_resolution_clock::time_point now = std::chrono::high_resolution_clock::now();
-	timeChange = (now - lastTime);
-	if (timeChange.count() >= SampleTime) {
-		/*Compute all the working error variables*/
-		double u = 0.0;
-
-		double err_p = 0 - *myAngle;
-		double err_d = 0 - *myVelocity;
-		double err_i = err_p + err_d;
-		u = -((kp * err_p) + (kd * err_d) + (ki * err_i));
-		double output = outMax / 11.7 * u;
-
-		if (output > outMax) {
-			output = outMax;
-		} else if (output < outMin) {
-			output = outMin;
-		}
-		*myOutput = output;
-		lastTime = now;
-
-		D(std::cout << timeChange.count() << ",";)
-		D(std::cout << std::to_string(err_p) << ",";)
-		D(std::cout << std::to_string(err_d) << ",";)
-		D(std::cout << std::to_string(err_i) << ",";)
-		D(std::cout << std::to_string(u) << ",";)
-		D(std::cout << std::to_string(output) << std::endl;)
-
-	}
-}
-
-void velocity::onStartHandler() {
-	Initialize();
-	while (!bExit.load()) {
-		this->Compute();
-		yield();
-	}
 }
 
 std::string velocity::name() {
 	return std::string("Velocity");
 }
 
-void velocity::stop() {
-	bExit.store(true);
-}
 /* SetTunings(...)*************************************************************
  * This function allows the controller's dynamic performance to be adjusted.
  * it's called automatically from the constructor, but tunings can also
@@ -90,99 +39,35 @@ void velocity::SetTunings(double Kp, double Ki, double Kd) {
 	dispKi = Ki;
 	dispKd = Kd;
 
-	double SampleTimeInSec = ((double) SampleTime) / 1000;
-	kp = Kp;
-	ki = Ki * SampleTimeInSec;
-	kd = Kd / SampleTimeInSec;
+	kp = real(Kp);
+	ki = real(Ki * SampleTime);
+	kd = real(Kd / SampleTime);
 
 	if (controllerDirection == 1) {
-		kp = (0 - kp);
-		ki = (0 - ki);
-		kd = (0 - kd);
-	}
-}
-
-/* SetSampleTime(...) *********************************************************
- * sets the period, in Milliseconds, at which the calculation is performed
- ******************************************************************************/
-void velocity::SetSampleTime(int NewSampleTime) {
-	if (NewSampleTime > 0) {
-		double ratio = (double) NewSampleTime / 1000 / (double) SampleTime;
-		ki *= ratio;
-		kd /= ratio;
-		SampleTime = (double) NewSampleTime / 1000.0;
-	}
-}
-
-/* SetOutputLimits(...)****************************************************
- *     This function will be used far more often than SetInputLimits.  while
- *  the input to the controller will generally be in the 0-1023 range (which is
- *  the default already,)  the output will be a little different.  maybe they'll
- *  be doing a time window and will need 0-8000 or something.  or maybe they'll
- *  want to clamp it from 0-125.  who knows.  at any rate, that can all be done
- *  here.
- **************************************************************************/
-void velocity::SetOutputLimits(double Min, double Max) {
-	if (Min >= Max)
-		return;
-	outMin = Min;
-	outMax = Max;
-
-	if (inAuto) {
-		if (*myOutput > outMax) {
-			*myOutput = outMax;
-		} else if (*myOutput < outMin) {
-			*myOutput = outMin;
-		}
-		if (ITerm > outMax) {
-			ITerm = outMax;
-		} else if (ITerm < outMin) {
-			ITerm = outMin;
-		}
+		kp = -kp;
+		ki = -ki;
+		kd = -kd;
 	}
 }
 
-/* SetMode(...)****************************************************************
- * Allows the controller Mode to be set to manual (0) or Automatic (non-zero)
- * when the transition from manual to auto occurs, the controller is
- * automatically initialized
+/* SampleTimeChanged(...) *****************************************************
+ * ki and kd are stored per sample, recompute them for the new period from
+ * the tunings so rounding doesn't build up
  ******************************************************************************/
-void velocity::SetMode(int Mode) {
-	bool newAuto = (Mode == 1);
-	if (newAuto == !inAuto) { /*we just went from manual to auto*/
-		Initialize();
-	}
-	inAuto = newAuto;
+void velocity::SampleTimeChanged(double ratio) {
+	SetTunings(dispKp, dispKi, dispKd);
 }
 
-/* Initialize()****************************************************************
- *	does all the things that need to happen to ensure a bumpless transfer
- *  from manual to automatic mode.
- ******************************************************************************/
-void velocity::Initialize() {
-	// reset lastTime in case thread wasn't run straight after being created.
-	lastTime = std::chrono::high_resolution_clock::now();
-	ITerm = *myOutput;
-	if (ITerm > outMax) {
-		ITerm = outMax;
-	} else if (ITerm < outMin) {
-		ITerm = outMin;
-	}
-}
-
-/* SetControllerDirection(...)*************************************************
+/* DirectionChanged()**********************************************************
  * The PID will either be connected to a DIRECT acting process (+Output leads
  * to +Input) or a REVERSE acting process(+Output leads to -Input.)  we need to
  * know which one, because otherwise we may increase the output when we should
- * be decreasing.  This is called from the constructor.
+ * be decreasing.
  ******************************************************************************/
-void velocity::SetControllerDirection(int Direction) {
-	if (inAuto && Direction != controllerDirection) {
-		kp = (0 - kp);
-		ki = (0 - ki);
-		kd = (0 - kd);
-	}
-	controllerDirection = Direction;
+void velocity::DirectionChanged() {
+	kp = -kp;
+	ki = -ki;
+	kd = -kd;
 }
 
 }; /* namespace CONTROLLER */
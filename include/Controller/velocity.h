@@ -25,22 +25,13 @@
 #ifndef INCLUDE_CONTROLLER_VELOCITY_H_
 #define INCLUDE_CONTROLLER_VELOCITY_H_
 
-//#define DEBUG
-
-#ifdef DEBUG
-#define D(x) x
-#else
-#define D(x)
-#endif
-
-#include <BlackLib/BlackThread/BlackThread.h>
-#include <atomic>
 #include <cstdbool>
-#include <chrono>
 #include <string>
+#include <iostream>
+#include <Controller/controllerBase.h>
 
 namespace Controller {
-class velocity : public BlackLib::BlackThread {
+class velocity : public controllerBase<velocity> {
 
 public:
 
@@ -49,8 +40,7 @@ public:
 	 *
 	 * Uses pendulum angle and velocity to determine motor speed and direction
 	 *
-	 * @param[in] Angle	angle of the pendulum
-	 * @param[in] Velocity velocity of the pendulum
+	 * @param[in] State pendulum state, angle and velocity of the pendulum are used
 	 * @param[out] Output motor speed
 	 * @param[in] SetPoint target for controller
 	 * @param[in] _kp Proportional constant
@@ -58,29 +48,7 @@ public:
 	 * @param[in] _kd Derivative constant
 	 * @param[in] dir Direction controller is to operate in. 0=normal, 1=inverse
 	 */
-	velocity(double* Angle, double* Velocity, double* Output, double* SetPoint, double _kp,	double _ki, double _kd, int dir);
-
-	/*!
-	 * @brief Set Controller operating mode
-	 *  In auto mode the controller will alter the Output to drive towards
-	 * 				the SetPoint.
-	 * 				In manual mode the controller is disabled and control of the Output
-	 * 				is handled external to the controller
-	 *
-	 * @param[in] Mode controller mode 0=manual, 1=auto
-	 */
-	void SetMode(int Mode); // * sets pid-new to either Manual (0) or Auto (non-0)
-
-	/*!
-	 * @brief Set output limits for controller
-	 *  Clamps the output to a specific range. 0-255 by default, but
-	 *				it's likely the user will want to change this depending on
-	 * 				the application
-	 *
-	 * @param[in] Min Minimum limit
-	 * @param[out] Max Maximum limit
-	 */
-	void SetOutputLimits(double Min, double Max);
+	velocity(const pendulumStateBuffer* State, std::atomic<double>* Output, double* SetPoint, double _kp,	double _ki, double _kd, int dir);
 
 	/*!
 	 * @brief Alter the PID parameters
@@ -94,26 +62,6 @@ public:
 	 */
 	void SetTunings(double kp, double ki, double kd);
 
-	/*!
-	 * @brief Set controller direction
-	 *  Sets the Direction, or "Action" of the controller. DIRECT
-	 *				means the output will increase when error is positive. REVERSE
-	 *				means the opposite.  it's very unlikely that this will be needed
-	 *				once it is set in the constructor.
-	 *
-	 * @param[in] direction
-	 */
-	void SetControllerDirection(int);
-
-	/*!
-	 * @brief Set sample time for PID calculations
-	 *  Sets the frequency, in milliseconds, with which
-	 *				the pid-new calculation is performed.  Default is 100
-	 *
-	 * @param[in] frequency in milliseconds
-	 */
-	void SetSampleTime(int);
-
 	/*!
 	 * @brief Get the value of the Proportional constant
 	 * @return
@@ -139,69 +87,54 @@ public:
 	}
 
 	/*!
-	 * @brief Get the operating mode of the controller
-	 * @return
-	 */
-	inline int GetMode() {
-		return inAuto ? 1 : 0;
-	}
-
-	/*!
-	 * @brief Get the direction of the controller
-	 * @return
-	 */
-	inline int GetDirection() {
-		return controllerDirection;
-	}
-
-    /*!
-     * @brief Thread's start handler function.
+	 * @brief Handle PID calculations for one sample period
+	 *
+	 * @param[in] x pendulum state for this sample
+	 * @return output before clamping
 	 */
-	void onStartHandler();
+	inline double step(const pendulumState& x);
 
 	std::string name();
 
-	/*!
-	 * @brief Stops the thread running
-	 */
-	void stop();
-
 private:
+	friend class controllerBase<velocity>;
+
 	/*!
-	 * @brief Initialise all parameters to ensure smooth transfer from manul to automatic
+	 * @brief Recompute the per sample gains for a new sample time
 	 */
-	void Initialize();
+	void SampleTimeChanged(double ratio);
 
 	/*!
-	 * @brief Main loop that handle PID calculations
+	 * @brief Invert the gains when the direction changes
 	 */
-	void Compute();
-
-	std::atomic<bool> bExit; 	/*!< flag to tell thread to quit */
+	void DirectionChanged();
 
-	std::string _name = "Velocity";
 	double dispKp;
 	double dispKi;
 	double dispKd;
 
-	double kp;                  /*!< (P)roportional Tuning Parameter */
-	double ki;                  /*!< (I)ntegral Tuning Parameter */
-	double kd;                  /*!< (D)erivative Tuning Parameter */
-
-	int controllerDirection;
-
-	double *myAngle;  // * Pointers to the Input, Output, and Setpoint variables
-	double *myVelocity;
-	double *myOutput; //   This creates a hard link between the variables and the
-	double *mySetPoint; //   pid, freeing the user from having to constantly tell us
-						//   what these values are.  with pointers we'll just know.
+	real kp;                    /*!< (P)roportional Tuning Parameter */
+	real ki;                    /*!< (I)ntegral Tuning Parameter */
+	real kd;                    /*!< (D)erivative Tuning Parameter */
+}; /* class VELOCITY */
 
-	std::chrono::high_resolution_clock::time_point lastTime;
-	double ITerm, lastInput;
+double velocity::step(const pendulumState& x) {
+	/*Compute all the working error variables*/
+	real err_p = -real(x.pAngle);
+	real err_d = -real(x.pVelocity);
+	real err_i = err_p + err_d;
+	real u = -((kp * err_p) + (kd * err_d) + (ki * err_i));
+	real output = u * outputScale;
+
+	STEP_TRACE(const tickInfo& info = currentTick();)
+	STEP_TRACE(std::cout << info.dt + info.lateness / 1e9 << ",";)
+	STEP_TRACE(std::cout << std::to_string(toDouble(err_p)) << ",";)
+	STEP_TRACE(std::cout << std::to_string(toDouble(err_d)) << ",";)
+	STEP_TRACE(std::cout << std::to_string(toDouble(err_i)) << ",";)
+	STEP_TRACE(std::cout << std::to_string(toDouble(u)) << ",";)
+	STEP_TRACE(std::cout << std::to_string(toDouble(clampReal(output))) << std::endl;)
+	return toDouble(output);
+}
 
-	bool inAuto;
-	double SampleTime;
-	double outMin, outMax;
-}; /* class VELOCITY */
 }; /* namespace CONTROLLER */
 #endif /* INCLUDE_CONTROLLER_VELOCITY_H_ */
@@ -0,0 +1,80 @@
+/**
+ * @file dare.cpp
+ * @brief Discrete algebraic Riccati equation solver and LQR design
+ *
+ * @author Troy Dack
+ * @date Copyright (C) 2015
+ *
+ * @license
+ * \verbinclude "Troy Dack - GPL-2.0.txt"
+ *
+ **/
+
+#include <Model/dare.h>
+
+namespace Model {
+
+bool solveDARE(const stateMatrix& A, const stateVector& B, const stateMatrix& Q, double R, stateMatrix& P,
+			   int maxIterations, double tolerance) {
+	if (R <= 0) {
+		return false;
+	}
+	stateMatrix I = stateMatrix::identity();
+	stateMatrix Ak = A;
+	stateMatrix G = B * B.transpose() * (1 / R);
+	stateMatrix H = Q;
+
+	for (int k = 0; k < maxIterations; k++) {
+		// W = (I + G H)^-1, then double the horizon
+		stateMatrix W;
+		if (!inverse(I + G * H, W)) {
+			return false;
+		}
+		stateMatrix AW = Ak * W;
+		stateMatrix Hnext = H + Ak.transpose() * H * W * Ak;
+		G = G + AW * G * Ak.transpose();
+		Ak = AW * Ak;
+
+		double change = (Hnext - H).maxAbs();
+		double size = Hnext.maxAbs();
+		H = Hnext;
+		if (change != change || size != size) {
+			return false; // NaN, diverged
+		}
+		if (change <= tolerance * size) {
+			P = (H + H.transpose()) * 0.5;
+			return true;
+		}
+	}
+	return false;
+}
+
+bool lqrGain(const stateMatrix& A, const stateVector& B, const stateMatrix& Q, double R, gainVector& K) {
+	stateMatrix P;
+	if (!solveDARE(A, B, Q, R, P)) {
+		return false;
+	}
+	gainVector BtP = B.transpose() * P;
+	K = BtP * A * (1 / (R + (BtP * B)[0]));
+	return true;
+}
+
+lqrWeights::lqrWeights() : r(1 / (12.0 * 12.0)) {
+	q[0] = 1 / (0.05 * 0.05);
+	q[1] = 1 / (0.5 * 0.5);
+	q[2] = 1;
+	q[3] = 1;
+}
+
+bool designLQR(const pendulumModel& model, double dt, const lqrWeights& weights, gainVector& K) {
+	stateMatrix Ad;
+	stateVector Bd;
+	model.discretise(dt, Ad, Bd);
+	stateMatrix Q = stateMatrix::zeros();
+	for (int i = 0; i < STATE_SIZE; i++) {
+		Q(i, i) = weights.q[i];
+	}
+	return lqrGain(Ad, Bd, Q, weights.r, K);
+}
+
+} /* namespace Model */
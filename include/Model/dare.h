@@ -0,0 +1,87 @@
+/**
+ *! @file dare.h
+ *! Discrete algebraic Riccati equation solver and LQR design
+ *!
+ *! @author Troy Dack
+ *! @date Copyright (C) 2015
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ **/
+
+#ifndef INCLUDE_MODEL_DARE_H_
+#define INCLUDE_MODEL_DARE_H_
+
+#include <Model/pendulumModel.h>
+
+namespace Model {
+
+typedef matrix<STATE_SIZE, STATE_SIZE> stateMatrix;	/*!< @brief Square matrix the size of the state */
+typedef matrix<1, STATE_SIZE> gainVector;				/*!< @brief State feedback gains */
+
+/*!
+ * @brief Solve the discrete algebraic Riccati equation for a single input
+ *
+ *     P = A'PA - A'PB (R + B'PB)^-1 B'PA + Q
+ *
+ * by the structure preserving doubling algorithm, which converges
+ * quadratically, so a 4 state system takes a handful of iterations.
+ *
+ * @param[in] A discrete system matrix
+ * @param[in] B discrete input matrix
+ * @param[in] Q state weights, symmetric positive semi-definite
+ * @param[in] R input weight, > 0
+ * @param[out] P solution
+ * @param[in] maxIterations give up after this many doublings
+ * @param[in] tolerance converged when the largest change in P relative to P is below this
+ * @return False if the solver did not converge, eg: (A, B) is not stabilisable
+ */
+bool solveDARE(const stateMatrix& A, const stateVector& B, const stateMatrix& Q, double R, stateMatrix& P,
+			   int maxIterations = 60, double tolerance = 1e-12);
+
+/*!
+ * @brief Infinite horizon discrete LQR gain, u = -K x
+ *
+ * @return False if the Riccati equation could not be solved
+ */
+bool lqrGain(const stateMatrix& A, const stateVector& B, const stateMatrix& Q, double R, gainVector& K);
+
+/*!
+ * @brief LQR weights, cost = sum x'Qx + r u^2 with Q diagonal
+ *
+ * The defaults follow Bryson's rule, 1 / (largest acceptable value)^2, for
+ * 0.05 rad of pendulum, 0.5 rad of arm, 1 rad/s on each velocity and 12 V.
+ */
+struct lqrWeights {
+	double q[STATE_SIZE];	/*!< State weights, in stateVector order */
+	double r;				/*!< Motor voltage weight */
+
+	lqrWeights();
+};
+
+/*!
+ * @brief Compute LQR gains for the pendulum
+ *
+ * @param[in] model pendulum model
+ * @param[in] dt controller sample period in seconds
+ * @param[in] weights Q and R
+ * @param[out] K gains in volts per unit state, u = -K x
+ * @return False if the Riccati equation could not be solved
+ */
+bool designLQR(const pendulumModel& model, double dt, const lqrWeights& weights, gainVector& K);
+
+} /* namespace Model */
+
+#endif /* INCLUDE_MODEL_DARE_H_ */
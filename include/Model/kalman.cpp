@@ -0,0 +1,152 @@
+/**
+ * @file kalman.cpp
+ * @brief Kalman filter estimate of the pendulum state
+ *
+ * @author Troy Dack
+ * @date Copyright (C) 2015
+ *
+ * @license
+ * \verbinclude "Troy Dack - GPL-2.0.txt"
+ *
+ **/
+
+#include <Model/kalman.h>
+#include <fastTrig.h>
+#include <cmath>
+#include <limits>
+
+namespace Model {
+
+kalman::kalman(const pendulumModel& model, double dt, double pendulumPPR, double motorPPR)
+	: dt(dt)
+	, accelNoise(20)
+	, budget(20000)
+	, updates(0)
+	, overruns(0)
+	, min(std::numeric_limits<int64_t>::max())
+	, max(0)
+	, total(0)
+{
+	// Uniform quantisation of one count
+	angleNoise[0] = std::pow(2 * M_PI / pendulumPPR, 2) / 12;
+	angleNoise[1] = std::pow(2 * M_PI / motorPPR, 2) / 12;
+	setModel(model, dt);
+	reset(pendulumState());
+}
+
+void kalman::setModel(const pendulumModel& model, double Dt) {
+	dt = Dt;
+	model.discretise(dt, Ad, Bd);
+	setProcessNoise(accelNoise);
+}
+
+void kalman::setProcessNoise(double acceleration) {
+	accelNoise = acceleration;
+	// Piecewise constant white acceleration on each axis
+	double q = accelNoise * accelNoise;
+	Q = matrix<STATE_SIZE, STATE_SIZE>::zeros();
+	for (int i = 0; i < 2; i++) {
+		int angle = i, velocity = i + 2;
+		Q(angle, angle) = q * dt * dt * dt * dt / 4;
+		Q(angle, velocity) = Q(velocity, angle) = q * dt * dt * dt / 2;
+		Q(velocity, velocity) = q * dt * dt;
+	}
+}
+
+void kalman::reset(const pendulumState& measured) {
+	x = toVector(measured);
+	x[2] = x[3] = 0;
+	P = matrix<STATE_SIZE, STATE_SIZE>::zeros();
+	P(0, 0) = angleNoise[0];
+	P(1, 1) = angleNoise[1];
+	P(2, 2) = P(3, 3) = 1;	// velocity unknown, about 1 rad/s
+}
+
+stateVector kalman::update(const pendulumState& measured, double u) {
+	uint64_t start = monotonicNow();
+
+	// Predict
+	x = Ad * x + Bd * u;
+	P = Ad * P * Ad.transpose() + Q;
+
+	// Correct with the angles
+	matrix<STATE_SIZE, 2> K = correct(P);
+	// The measured pendulum angle wraps at +-pi, the prediction can cross it
+	vec<2> innovation;
+	innovation[0] = wrapAngle(measured.pAngle - x[0]);
+	innovation[1] = measured.mAngle - x[1];
+	x += K * innovation;
+	x[0] = wrapAngle(x[0]);
+
+	int64_t ns = monotonicNow() - start;
+	// Only the control thread updates, so relaxed load/store pairs are enough
+	if (ns < min.load(std::memory_order_relaxed)) {
+		min.store(ns, std::memory_order_relaxed);
+	}
+	if (ns > max.load(std::memory_order_relaxed)) {
+		max.store(ns, std::memory_order_relaxed);
+	}
+	if (ns > budget) {
+		overruns.store(overruns.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	}
+	total.store(total.load(std::memory_order_relaxed) + ns, std::memory_order_relaxed);
+	updates.store(updates.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+	return x;
+}
+
+matrix<STATE_SIZE, 2> kalman::correct(matrix<STATE_SIZE, STATE_SIZE>& P) const {
+	// H = [I 0] so H P H' is the top left of P
+	matrix<2, 2> S;
+	S(0, 0) = P(0, 0) + angleNoise[0];
+	S(0, 1) = P(0, 1);
+	S(1, 0) = P(1, 0);
+	S(1, 1) = P(1, 1) + angleNoise[1];
+	double det = S(0, 0) * S(1, 1) - S(0, 1) * S(1, 0);
+	matrix<2, 2> Sinv;
+	Sinv(0, 0) = S(1, 1) / det;
+	Sinv(0, 1) = -S(0, 1) / det;
+	Sinv(1, 0) = -S(1, 0) / det;
+	Sinv(1, 1) = S(0, 0) / det;
+
+	matrix<STATE_SIZE, 2> PHt;		// P H', the first two columns of P
+	matrix<2, STATE_SIZE> HP;		// H P, the first two rows of P
+	for (int r = 0; r < STATE_SIZE; r++) {
+		PHt(r, 0) = HP(0, r) = P(r, 0);
+		PHt(r, 1) = HP(1, r) = P(r, 1);
+	}
+	matrix<STATE_SIZE, 2> K = PHt * Sinv;
+	P -= K * HP;
+	P = (P + P.transpose()) * 0.5;	// keep rounding from making P asymmetric
+	return K;
+}
+
+matrix<STATE_SIZE, 2> kalman::steadyStateGain() const {
+	matrix<STATE_SIZE, STATE_SIZE> p = P;
+	matrix<STATE_SIZE, 2> K = matrix<STATE_SIZE, 2>::zeros();
+	for (int i = 0; i < KALMAN_STEADY_ITERATIONS; i++) {
+		p = Ad * p * Ad.transpose() + Q;
+		matrix<STATE_SIZE, 2> next = correct(p);
+		bool settled = (next - K).maxAbs() <= KALMAN_STEADY_TOLERANCE * next.maxAbs();
+		K = next;
+		if (settled) {
+			break;
+		}
+	}
+	return K;
+}
+
+void kalman::setBudget(int64_t ns) {
+	budget = ns;
+}
+
+latenessStats kalman::getTiming() {
+	latenessStats s;
+	s.ticks = updates.load(std::memory_order_acquire);
+	s.overruns = overruns.load();
+	s.min = (s.ticks > 0) ? min.load() : 0;
+	s.max = max.load();
+	s.mean = (s.ticks > 0) ? (double)total.load() / s.ticks : 0.0;
+	return s;
+}
+
+} /* namespace Model */
@@ -0,0 +1,156 @@
+/**
+ *! @file kalman.h
+ *! Kalman filter estimate of the pendulum state
+ *!
+ *! @author Troy Dack
+ *! @date Copyright (C) 2015
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ **/
+
+#ifndef INCLUDE_MODEL_KALMAN_H_
+#define INCLUDE_MODEL_KALMAN_H_
+
+#include <Model/pendulumModel.h>
+#include <periodicScheduler.h>
+#include <atomic>
+
+namespace Model {
+
+const int KALMAN_STEADY_ITERATIONS = 10000;	/*!< @brief Most covariance updates steadyStateGain() runs */
+const double KALMAN_STEADY_TOLERANCE = 1e-12;	/*!< @brief Relative gain change steadyStateGain() stops at */
+
+/*!
+ * @brief Discrete Kalman filter for the four pendulum states
+ *
+ * Predicts the state one sample ahead with the pendulum model and the last
+ * motor voltage, then corrects it with the measured pendulum and motor angles.
+ * The encoder angles are counts scaled by 2 pi / ppr, so the measurement noise
+ * is the quantisation of one count.  The velocities are never measured
+ * directly; they come out of the filter much smoother than a position
+ * difference.
+ *
+ * The amount of work is fixed (4x4 predict, 2x2 innovation inverse) so every
+ * update takes the same time.  The time taken is measured and updates over
+ * the budget are counted.
+ */
+class kalman {
+
+public:
+	/*!
+	 * @param[in] model pendulum model
+	 * @param[in] dt sample period in seconds
+	 * @param[in] pendulumPPR pendulum encoder counts per revolution
+	 * @param[in] motorPPR motor encoder counts per revolution
+	 */
+	kalman(const pendulumModel& model, double dt, double pendulumPPR, double motorPPR);
+
+	/*!
+	 * @brief Rediscretise the model, eg: after the sample time changes
+	 */
+	void setModel(const pendulumModel& model, double dt);
+
+	/*!
+	 * @brief Set the process noise
+	 *  Model error is treated as random angular acceleration of each axis.
+	 *
+	 * @param[in] acceleration standard deviation of the unmodelled acceleration, rad/s^2
+	 */
+	void setProcessNoise(double acceleration);
+
+	/*!
+	 * @brief Restart the estimate from the measured angles with zero velocity
+	 */
+	void reset(const pendulumState& x);
+
+	/*!
+	 * @brief Estimate the state for this sample
+	 *
+	 * @param[in] measured encoder state, only the angles are used
+	 * @param[in] u motor voltage applied over the previous sample
+	 * @return filtered state
+	 */
+	stateVector update(const pendulumState& measured, double u);
+
+	/*!
+	 * @brief Gain update() converges to, for a fixed gain filter
+	 *  Iterates the covariance from the current one until the gain settles.
+	 *  Predict with transition() and input(), then add the gain times the
+	 *  pendulum and motor angle innovations.
+	 *
+	 * @return Kalman gain, one column per measured angle
+	 */
+	matrix<STATE_SIZE, 2> steadyStateGain() const;
+
+	/*!
+	 * @brief Discrete state transition at the current sample time
+	 */
+	const matrix<STATE_SIZE, STATE_SIZE>& transition() const {
+		return Ad;
+	}
+
+	/*!
+	 * @brief Discrete input vector at the current sample time, per volt
+	 */
+	const stateVector& input() const {
+		return Bd;
+	}
+
+	/*!
+	 * @brief Current estimate
+	 */
+	const stateVector& state() const {
+		return x;
+	}
+
+	/*!
+	 * @brief Set the time an update is allowed to take
+	 *
+	 * @param[in] ns budget in nanoseconds
+	 */
+	void setBudget(int64_t ns);
+
+	/*!
+	 * @brief Time taken by update(), in nanoseconds
+	 *  overruns counts updates that took longer than the budget
+	 */
+	latenessStats getTiming();
+
+private:
+	// Kalman gain for the predicted covariance P, which becomes the corrected covariance
+	matrix<STATE_SIZE, 2> correct(matrix<STATE_SIZE, STATE_SIZE>& P) const;
+
+	double dt;
+	double accelNoise;
+	double angleNoise[2];			// variance of one count, pendulum and motor
+
+	matrix<STATE_SIZE, STATE_SIZE> Ad;
+	stateVector Bd;
+	matrix<STATE_SIZE, STATE_SIZE> Q;
+	matrix<STATE_SIZE, STATE_SIZE> P;
+	stateVector x;
+
+	int64_t budget;
+	std::atomic<uint64_t> updates;
+	std::atomic<uint64_t> overruns;
+	std::atomic<int64_t> min;
+	std::atomic<int64_t> max;
+	std::atomic<int64_t> total;
+};
+
+} /* namespace Model */
+
+#endif /* INCLUDE_MODEL_KALMAN_H_ */
@@ -0,0 +1,348 @@
+/**
+ * @file pendulumBatch.cpp
+ * @brief Many rotary pendulums simulated at once
+ *
+ * @author Troy Dack
+ * @date Copyright (C) 2015
+ *
+ * @license
+ * \verbinclude "Troy Dack - GPL-2.0.txt"
+ *
+ **/
+
+#include <Model/pendulumBatch.h>
+#include <BlackLib/BlackThread/BlackThread.h>
+#include <pendulum.h>
+#include <controlPipeline.h>
+#include <algorithm>
+#include <cmath>
+
+namespace Model {
+
+namespace {
+
+const batchReal PI = (batchReal)M_PI;
+const batchReal TWO_PI = (batchReal)(2 * M_PI);
+
+/* The helpers below are branch free so the loops that use them vectorise;
+ * the conditional expressions become selects. */
+
+inline batchReal floorReal(batchReal x) {
+	batchReal t = (batchReal)(int32_t)x;
+	return t - (batchReal)(x < t);
+}
+
+inline batchReal clampReal(batchReal x, batchReal limit) {
+	return std::max(std::min(x, limit), -limit);
+}
+
+/* sinReal(...) ****************************************************************
+ * Reduce to [-pi, pi), reflect into [-pi/2, pi/2] and use the Taylor series
+ * to x^9, absolute error below 4e-6.
+ ******************************************************************************/
+inline batchReal sinReal(batchReal x) {
+	x -= TWO_PI * floorReal((x + PI) * (1 / TWO_PI));
+	x = std::min(x, PI - x);
+	x = std::max(x, -PI - x);
+	batchReal x2 = x * x;
+	return x * (1 + x2 * (batchReal(-1.0 / 6) + x2 * (batchReal(1.0 / 120)
+			+ x2 * (batchReal(-1.0 / 5040) + x2 * batchReal(1.0 / 362880)))));
+}
+
+/* accelerations(...) *********************************************************
+ * pendulumSim::derivative() for one instance, see there for the equations.
+ ******************************************************************************/
+inline void accelerations(batchReal p, batchReal pv, batchReal av, batchReal V,
+						  batchReal Jp, batchReal Jr, batchReal mll, batchReal mLl, batchReal mgl,
+						  batchReal Dp, batchReal Dr, batchReal kv, batchReal kb,
+						  batchReal& pa, batchReal& aa) {
+	batchReal sp = sinReal(p);
+	batchReal cp = sinReal(p + PI / 2);
+	batchReal torque = kv * (V - kb * av) - Dr * av;
+	batchReal m11 = Jr + mll * sp * sp;
+	batchReal m12 = -mLl * cp;
+	batchReal f1 = torque - mLl * sp * pv * pv - 2 * mll * sp * cp * av * pv;
+	batchReal f2 = mgl * sp - Dp * pv + mll * sp * cp * av * av;
+	batchReal inv = 1 / (m11 * Jp - m12 * m12);
+	pa = (m11 * f2 - m12 * f1) * inv;
+	aa = (Jp * f1 - m12 * f2) * inv;
+}
+
+/*!
+ * @brief Values the control kernel needs that are the same for every instance
+ */
+struct controlConstants {
+	batchReal T;				// sample time
+	batchReal pScale, pCount;	// pendulum radians to counts and back
+	batchReal mScale, mCount;	// motor radians to counts and back
+	batchReal limit;			// output and SMC speed limit
+	batchReal deadband;
+	batchReal vScale;			// SMC speed to volts
+	batchReal cutoff;			// radians
+};
+
+/* control(...) ****************************************************************
+ * Quantise the encoders as multiEQEP publishes them, run Controller::basic
+ * plus the arm terms, then motorCommand() and the SMC deadband.
+ ******************************************************************************/
+void control(int begin, int end, const controlConstants& c,
+			 const batchReal* __restrict__ pAngle, const batchReal* __restrict__ mAngle,
+			 batchReal* __restrict__ volts, batchReal* __restrict__ ITerm,
+			 batchReal* __restrict__ lastInput, batchReal* __restrict__ lastArm,
+			 batchReal* __restrict__ maxAngle, batchReal* __restrict__ maxArm,
+			 batchReal* __restrict__ cost, batchReal* __restrict__ armCost, batchReal* __restrict__ fell,
+			 const batchReal* __restrict__ kp, const batchReal* __restrict__ ki,
+			 const batchReal* __restrict__ kd, const batchReal* __restrict__ armKp,
+			 const batchReal* __restrict__ armKd) {
+	for (int i = begin; i < end; i++) {
+		// Sense
+		batchReal p = floorReal(pAngle[i] * c.pScale) * c.pCount;
+		p -= TWO_PI * floorReal((p + PI) * (1 / TWO_PI));
+		batchReal m = floorReal(mAngle[i] * c.mScale) * c.mCount;
+
+		// Compute
+		batchReal error = -p;
+		batchReal iTerm = clampReal(ITerm[i] + ki[i] * error, c.limit);
+		batchReal out = kp[i] * error + iTerm - kd[i] * (p - lastInput[i])
+						- armKp[i] * m - armKd[i] * (m - lastArm[i]);
+		out = clampReal(out, c.limit);
+		ITerm[i] = iTerm;
+		lastInput[i] = p;
+		lastArm[i] = m;
+
+		// Actuate, the deadband is added for the SMC to take off again
+		batchReal a = std::abs(p);
+		batchReal stop = (batchReal)(a > c.cutoff);
+		batchReal cmd = clampReal(out + c.deadband * (2 * (batchReal)(out > 0) - 1), c.limit) * (1 - stop);
+		volts[i] = (std::max(cmd - c.deadband, batchReal(0)) + std::min(cmd + c.deadband, batchReal(0))) * c.vScale;
+
+		fell[i] = std::max(fell[i], stop);
+		maxAngle[i] = std::max(maxAngle[i], a);
+		maxArm[i] = std::max(maxArm[i], std::abs(m));
+		cost[i] += p * p * c.T;
+		armCost[i] += m * m * c.T;
+	}
+}
+
+/* integrate(...) **************************************************************
+ * One RK4 step of every instance.  The angles' derivatives are the
+ * velocities, so only the accelerations are evaluated.
+ ******************************************************************************/
+void integrate(int begin, int end, batchReal h,
+			   batchReal* __restrict__ pAngle, batchReal* __restrict__ mAngle,
+			   batchReal* __restrict__ pVelocity, batchReal* __restrict__ mVelocity,
+			   const batchReal* __restrict__ volts,
+			   const batchReal* __restrict__ Jp, const batchReal* __restrict__ Jr,
+			   const batchReal* __restrict__ mll, const batchReal* __restrict__ mLl,
+			   const batchReal* __restrict__ mgl, const batchReal* __restrict__ Dp,
+			   const batchReal* __restrict__ Dr, const batchReal* __restrict__ kv,
+			   const batchReal* __restrict__ kb) {
+	for (int i = begin; i < end; i++) {
+		batchReal x0 = pAngle[i], x1 = mAngle[i], x2 = pVelocity[i], x3 = mVelocity[i];
+		batchReal a1, b1, a2, b2, a3, b3, a4, b4;
+		accelerations(x0, x2, x3, volts[i], Jp[i], Jr[i], mll[i], mLl[i], mgl[i], Dp[i], Dr[i], kv[i], kb[i],
+					  a1, b1);
+		batchReal p2 = x2 + h / 2 * a1, m2 = x3 + h / 2 * b1;
+		accelerations(x0 + h / 2 * x2, p2, m2, volts[i], Jp[i], Jr[i], mll[i], mLl[i], mgl[i], Dp[i], Dr[i],
+					  kv[i], kb[i], a2, b2);
+		batchReal p3 = x2 + h / 2 * a2, m3 = x3 + h / 2 * b2;
+		accelerations(x0 + h / 2 * p2, p3, m3, volts[i], Jp[i], Jr[i], mll[i], mLl[i], mgl[i], Dp[i], Dr[i],
+					  kv[i], kb[i], a3, b3);
+		batchReal p4 = x2 + h * a3, m4 = x3 + h * b3;
+		accelerations(x0 + h * p3, p4, m4, volts[i], Jp[i], Jr[i], mll[i], mLl[i], mgl[i], Dp[i], Dr[i],
+					  kv[i], kb[i], a4, b4);
+		pAngle[i] = x0 + h / 6 * (x2 + 2 * p2 + 2 * p3 + p4);
+		mAngle[i] = x1 + h / 6 * (x3 + 2 * m2 + 2 * m3 + m4);
+		pVelocity[i] = x2 + h / 6 * (a1 + 2 * a2 + 2 * a3 + a4);
+		mVelocity[i] = x3 + h / 6 * (b1 + 2 * b2 + 2 * b3 + b4);
+	}
+}
+
+/*!
+ * @brief Runs a range of blocks on its own thread
+ */
+class batchWorker : public BlackLib::BlackThread {
+public:
+	batchWorker() : batch(NULL), begin(0), end(0), ticks(0) {
+	}
+
+	void onStartHandler() {
+		batch->runBlocks(begin, end, ticks);
+	}
+
+	pendulumBatch *batch;
+	int begin, end, ticks;
+};
+
+} /* namespace */
+
+pendulumBatch::pendulumBatch(int count, const pendulumParameters& p, double supplyVoltage)
+	: n(count > 0 ? count : 0)
+	, supply(supplyVoltage)
+	, deadband(MOTOR_DEADBAND)
+	, cutoff(MOTOR_CUTOFF_ANGLE)
+	, sampleTime(SAMPLE_TIME / 1000.0)
+	, substeps(1)
+	, stepCount(0)
+	, Jp(n), Jr(n), mll(n), mLl(n), mgl(n), Dp(n), Dr(n), kv(n), kb(n)
+	, kp(n), ki(n), kd(n), armKp(n), armKd(n)
+	, ITerm(n), lastInput(n), lastArm(n)
+	, pAngle(n), mAngle(n), pVelocity(n), mVelocity(n), volts(n)
+	, maxAngle(n), maxArm(n), cost(n), armCost(n), fell(n)
+{
+	setStepSize(SIM_STEP);
+	batchGains none = batchGains();
+	for (int i = 0; i < n; i++) {
+		setParameters(i, p);
+		setGains(i, none);
+		reset(i, stateVector::zeros());
+	}
+}
+
+void pendulumBatch::setParameters(int i, const pendulumParameters& p) {
+	double lp = p.pendulumLength / 2;
+	Jp[i] = p.pendulumInertia + p.pendulumMass * lp * lp;
+	Jr[i] = p.armInertia + p.pendulumMass * p.armLength * p.armLength;
+	mll[i] = p.pendulumMass * lp * lp;
+	mLl[i] = p.pendulumMass * p.armLength * lp;
+	mgl[i] = p.pendulumMass * p.gravity * lp;
+	Dp[i] = p.pendulumDamping;
+	Dr[i] = p.armDamping;
+	kv[i] = p.torqueConstant / p.motorResistance;
+	kb[i] = p.backEmfConstant;
+}
+
+void pendulumBatch::setGains(int i, const batchGains& g) {
+	kp[i] = g.kp;
+	ki[i] = g.ki * sampleTime;
+	kd[i] = g.kd / sampleTime;
+	armKp[i] = g.armKp;
+	armKd[i] = g.armKd / sampleTime;
+}
+
+void pendulumBatch::reset(int i, const stateVector& x) {
+	pAngle[i] = x[0];
+	mAngle[i] = x[1];
+	pVelocity[i] = x[2];
+	mVelocity[i] = x[3];
+	volts[i] = 0;
+	// As Controller::basic::Initialize() with the motor stopped
+	ITerm[i] = 0;
+	double p = std::floor(x[0] * ENCODER_PPR / (2 * M_PI)) * 2 * M_PI / ENCODER_PPR;
+	lastInput[i] = p - 2 * M_PI * std::floor((p + M_PI) / (2 * M_PI));
+	lastArm[i] = std::floor(x[1] * MOTOR_PPR / (2 * M_PI)) * 2 * M_PI / MOTOR_PPR;
+	maxAngle[i] = 0;
+	maxArm[i] = 0;
+	cost[i] = 0;
+	armCost[i] = 0;
+	fell[i] = 0;
+}
+
+void pendulumBatch::setSampleTime(int ms) {
+	if (ms > 0) {
+		double ratio = ms / 1000.0 / sampleTime;
+		double h = sampleTime / substeps;
+		sampleTime = ms / 1000.0;
+		setStepSize(h);
+		// Keep the gains the same in per second units
+		for (int i = 0; i < n; i++) {
+			ki[i] *= ratio;
+			kd[i] /= ratio;
+			armKd[i] /= ratio;
+		}
+	}
+}
+
+void pendulumBatch::setStepSize(double h) {
+	if (h > 0) {
+		substeps = (int)std::ceil(sampleTime / h - 1e-9);
+	}
+}
+
+void pendulumBatch::setDeadband(int speed) {
+	deadband = (speed > 0) ? speed : 0;
+}
+
+void pendulumBatch::setCutoff(double deg) {
+	cutoff = deg;
+}
+
+void pendulumBatch::run(double seconds, int threads) {
+	int ticks = (int)(seconds / sampleTime + 0.5);
+	int blocks = (n + BLOCK - 1) / BLOCK;
+	if (threads > blocks) {
+		threads = blocks;
+	}
+	if (threads <= 1) {
+		runBlocks(0, n, ticks);
+	} else {
+		std::vector<batchWorker> workers(threads);
+		for (int t = 0; t < threads; t++) {
+			workers[t].batch = this;
+			workers[t].begin = std::min(n, (blocks * t / threads) * BLOCK);
+			workers[t].end = std::min(n, (blocks * (t + 1) / threads) * BLOCK);
+			workers[t].ticks = ticks;
+			workers[t].run();
+		}
+		for (int t = 0; t < threads; t++) {
+			workers[t].waitUntilFinish();
+		}
+	}
+	stepCount += (uint64_t)n * ticks * substeps;
+}
+
+void pendulumBatch::runBlocks(int begin, int end, int ticks) {
+	for (int b = begin; b < end; b += BLOCK) {
+		runBlock(b, std::min(b + BLOCK, end), ticks);
+	}
+}
+
+/* runBlock(...) ***************************************************************
+ * Each sample period does what controlPipeline::tick() does for every
+ * instance, then integrates the dynamics to the next period.  The kernels
+ * take every array as its own restrict pointer so the compiler knows they
+ * don't overlap.
+ ******************************************************************************/
+void pendulumBatch::runBlock(int begin, int end, int ticks) {
+	controlConstants c;
+	c.T = sampleTime;
+	c.pScale = ENCODER_PPR / (2 * M_PI);
+	c.pCount = 2 * M_PI / ENCODER_PPR;
+	c.mScale = MOTOR_PPR / (2 * M_PI);
+	c.mCount = 2 * M_PI / MOTOR_PPR;
+	c.limit = Pololu::SMC_MAX_SPEED;
+	c.deadband = deadband;
+	c.vScale = supply / Pololu::SMC_MAX_SPEED;
+	c.cutoff = (cutoff > 0) ? cutoff * M_PI / 180 : 1e30;
+	batchReal h = sampleTime / substeps;
+
+	for (int k = 0; k < ticks; k++) {
+		control(begin, end, c, &pAngle[0], &mAngle[0], &volts[0], &ITerm[0], &lastInput[0], &lastArm[0],
+				&maxAngle[0], &maxArm[0], &cost[0], &armCost[0], &fell[0], &kp[0], &ki[0], &kd[0], &armKp[0], &armKd[0]);
+		for (int s = 0; s < substeps; s++) {
+			integrate(begin, end, h, &pAngle[0], &mAngle[0], &pVelocity[0], &mVelocity[0], &volts[0],
+					  &Jp[0], &Jr[0], &mll[0], &mLl[0], &mgl[0], &Dp[0], &Dr[0], &kv[0], &kb[0]);
+		}
+	}
+}
+
+stateVector pendulumBatch::state(int i) const {
+	stateVector x;
+	x[0] = pAngle[i];
+	x[1] = mAngle[i];
+	x[2] = pVelocity[i];
+	x[3] = mVelocity[i];
+	return x;
+}
+
+batchResult pendulumBatch::result(int i) const {
+	batchResult r;
+	r.fell = fell[i] != 0;
+	r.maxAngle = maxAngle[i];
+	r.maxArm = maxArm[i];
+	r.cost = cost[i];
+	r.armCost = armCost[i];
+	return r;
+}
+
+} /* namespace Model */
@@ -0,0 +1,187 @@
+/**
+ *! @file pendulumBatch.h
+ *! Many rotary pendulums simulated at once
+ *!
+ *! @author Troy Dack
+ *! @date Copyright (C) 2015
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ **/
+
+#ifndef INCLUDE_MODEL_PENDULUMBATCH_H_
+#define INCLUDE_MODEL_PENDULUMBATCH_H_
+
+#include <Model/pendulumSim.h>
+#include <vector>
+#include <cstdint>
+
+namespace Model {
+
+/*!
+ * @brief Arithmetic type of the batch simulator
+ *  NEON on the Cortex-A8 only vectorises single precision, and single
+ *  precision is plenty for a few seconds of a 1ms step.
+ */
+typedef float batchReal;
+
+/*!
+ * @brief Gains of the batch control law
+ *  kp, ki and kd are the Controller::basic gains, in its units, with the
+ *  sign of the controller direction: negate them for direction 1.  armKp
+ *  and armKd add feedback of the arm angle and speed; zero gives the Basic
+ *  law exactly.
+ */
+struct batchGains {
+	double kp;		/*!< Pendulum angle proportional gain */
+	double ki;		/*!< Pendulum angle integral gain, per second */
+	double kd;		/*!< Pendulum angle derivative gain, seconds */
+	double armKp;	/*!< Arm angle gain */
+	double armKd;	/*!< Arm speed gain */
+};
+
+/*!
+ * @brief What happened to one instance during run()
+ */
+struct batchResult {
+	bool fell;			/*!< The pendulum passed the cutoff angle and the motor was stopped */
+	double maxAngle;	/*!< Largest |pendulum angle|, radians */
+	double maxArm;		/*!< Largest |arm angle|, radians */
+	double cost;		/*!< Integral of the squared pendulum angle, rad^2 s */
+	double armCost;		/*!< Integral of the squared arm angle, rad^2 s */
+};
+
+/*!
+ * @brief Structure of arrays simulator of many independent rotary pendulums
+ *
+ * Each instance has its own parameters, gains and state, and runs the
+ * pendulumSim model (RK4 dynamics, SMC deadband, encoder quantisation) under
+ * the batchGains law through motorCommand()'s deadband and cutoff.  The
+ * state of every instance is kept in its own array per variable, and every
+ * step is a loop over instances with no branches or library calls, so the
+ * compiler vectorises it at -O3 (add -mfpu=neon -funsafe-math-optimizations
+ * on the BeagleBone).  Instances are worked on in blocks of BLOCK that fit in
+ * L1, and blocks are shared out between threads.
+ *
+ * Differences from the scalar simulator: single precision, polynomial sin and
+ * cos, and the speed command is not rounded to a whole number.
+ */
+class pendulumBatch {
+
+public:
+	static const int BLOCK = 256;	/*!< Instances stepped together */
+
+	/*!
+	 * @param[in] n number of instances
+	 * @param[in] p rig parameters of every instance
+	 * @param[in] supplyVoltage motor voltage at full speed command
+	 */
+	pendulumBatch(int n, const pendulumParameters& p = measuredParameters(), double supplyVoltage = 11.7);
+
+	int size() const {
+		return n;
+	}
+
+	/*!
+	 * @brief Set the rig parameters of one instance
+	 */
+	void setParameters(int i, const pendulumParameters& p);
+
+	/*!
+	 * @brief Set the control law gains of one instance
+	 */
+	void setGains(int i, const batchGains& g);
+
+	/*!
+	 * @brief Start one instance from a state with the motor stopped and its results cleared
+	 */
+	void reset(int i, const stateVector& x);
+
+	/*!
+	 * @brief Control period in milliseconds, as controllerTask::SetSampleTime()
+	 */
+	void setSampleTime(int ms);
+
+	/*!
+	 * @brief Integration step, seconds, rounded to fit a whole number in the sample time
+	 */
+	void setStepSize(double h);
+
+	/*!
+	 * @brief Commands with magnitude up to this leave the motor stopped
+	 */
+	void setDeadband(int speed);
+
+	/*!
+	 * @brief Pendulum angle in degrees beyond which the motor is stopped, 0 for none
+	 */
+	void setCutoff(double deg);
+
+	/*!
+	 * @brief Advance every instance
+	 *
+	 * @param[in] seconds time to advance by, rounded to whole sample periods
+	 * @param[in] threads number of threads to share the blocks between
+	 */
+	void run(double seconds, int threads = 1);
+
+	/*!
+	 * @brief True state of one instance
+	 */
+	stateVector state(int i) const;
+
+	batchResult result(int i) const;
+
+	/*!
+	 * @brief Integration steps taken, summed over all instances
+	 */
+	uint64_t steps() const {
+		return stepCount;
+	}
+
+	/*!
+	 * @brief Run sample periods [0, ticks) of instances [begin, end)
+	 *  Used by the worker threads, blocks must not be shared.
+	 */
+	void runBlocks(int begin, int end, int ticks);
+
+private:
+	void runBlock(int begin, int end, int ticks);
+
+	int n;
+	double supply;
+	int deadband;
+	double cutoff;
+	double sampleTime;
+	int substeps;
+	uint64_t stepCount;
+
+	// Constant terms of the equations of motion, as pendulumSim
+	std::vector<batchReal> Jp, Jr, mll, mLl, mgl, Dp, Dr, kv, kb;
+
+	// Control law, gains already scaled by the sample time as Controller::basic does
+	std::vector<batchReal> kp, ki, kd, armKp, armKd;
+	std::vector<batchReal> ITerm, lastInput, lastArm;
+
+	// State
+	std::vector<batchReal> pAngle, mAngle, pVelocity, mVelocity, volts;
+
+	// Results
+	std::vector<batchReal> maxAngle, maxArm, cost, armCost, fell;
+};
+
+} /* namespace Model */
+
+#endif /* INCLUDE_MODEL_PENDULUMBATCH_H_ */
@@ -0,0 +1,75 @@
+/**
+ * @file pendulumModel.cpp
+ * @brief Linearised rotary inverted pendulum model
+ *
+ * @author Troy Dack
+ * @date Copyright (C) 2015
+ *
+ * @license
+ * \verbinclude "Troy Dack - GPL-2.0.txt"
+ *
+ **/
+
+#include <Model/pendulumModel.h>
+
+namespace Model {
+
+pendulumParameters::pendulumParameters()
+	: pendulumMass(0.1)
+	, pendulumLength(0.3)
+	, pendulumInertia(0.1 * 0.3 * 0.3 / 12)
+	, pendulumDamping(0.0005)
+	, armLength(0.2)
+	, armInertia(0.005)
+	, armDamping(0.002)
+	, torqueConstant(0.12)
+	, backEmfConstant(0.12)
+	, motorResistance(2.5)
+	, gravity(9.81)
+{
+}
+
+pendulumModel::pendulumModel(const pendulumParameters& p) : params(p) {
+	double Mp = p.pendulumMass;
+	double lp = p.pendulumLength / 2;
+	double Lr = p.armLength;
+	double Jp = p.pendulumInertia + Mp * lp * lp;	// about the pivot
+	double Jr = p.armInertia + Mp * Lr * Lr;		// with the pendulum mass at the pivot
+	double Jt = Jp * Jr - (Mp * lp * Lr) * (Mp * lp * Lr);
+
+	// Motor torque = kt/Rm V - kt km/Rm mVelocity, so back emf adds to the arm damping
+	double Dr = p.armDamping + p.torqueConstant * p.backEmfConstant / p.motorResistance;
+	double Dp = p.pendulumDamping;
+
+	a = matrix<STATE_SIZE, STATE_SIZE>::zeros();
+	a(0, 2) = 1;
+	a(1, 3) = 1;
+	// pendulum acceleration
+	a(2, 0) = Mp * p.gravity * lp * Jr / Jt;
+	a(2, 2) = -Jr * Dp / Jt;
+	a(2, 3) = -Mp * lp * Lr * Dr / Jt;
+	// arm acceleration
+	a(3, 0) = Mp * Mp * lp * lp * Lr * p.gravity / Jt;
+	a(3, 2) = -Mp * lp * Lr * Dp / Jt;
+	a(3, 3) = -Jp * Dr / Jt;
+
+	b = stateVector::zeros();
+	b[2] = Mp * lp * Lr / Jt * p.torqueConstant / p.motorResistance;
+	b[3] = Jp / Jt * p.torqueConstant / p.motorResistance;
+}
+
+void pendulumModel::discretise(double dt, matrix<STATE_SIZE, STATE_SIZE>& Ad, stateVector& Bd) const {
+	// Ad = exp(A dt) and Bd = integral of exp(A t) B over the period, by Taylor series.
+	// A dt is small at the control rates used so a few terms are exact to double precision.
+	matrix<STATE_SIZE, STATE_SIZE> term = matrix<STATE_SIZE, STATE_SIZE>::identity();
+	matrix<STATE_SIZE, STATE_SIZE> integral = term * dt;
+	Ad = term;
+	for (int k = 1; k < 12; k++) {
+		term = term * a * (dt / k);
+		Ad += term;
+		integral += term * (dt / (k + 1));
+	}
+	Bd = integral * b;
+}
+
+} /* namespace Model */
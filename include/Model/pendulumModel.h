@@ -0,0 +1,101 @@
+/**
+ *! @file pendulumModel.h
+ *! Linearised rotary inverted pendulum model
+ *!
+ *! @author Troy Dack
+ *! @date Copyright (C) 2015
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ **/
+
+#ifndef INCLUDE_MODEL_PENDULUMMODEL_H_
+#define INCLUDE_MODEL_PENDULUMMODEL_H_
+
+#include <matrix.h>
+#include <pendulumState.h>
+
+namespace Model {
+
+/*!
+ * @brief Physical parameters of the rotary pendulum
+ *
+ * The defaults are estimates from the rig's dimensions, not measurements.
+ * Replace them with identified values for the best estimator performance.
+ * The motor constants are referred to the arm, ie: they include the pulley ratio.
+ */
+struct pendulumParameters {
+	double pendulumMass;		/*!< Mp, kg */
+	double pendulumLength;		/*!< Lp, pivot to tip, m.  Centre of mass is at Lp/2 */
+	double pendulumInertia;		/*!< Jp, about the centre of mass, kg m^2 */
+	double pendulumDamping;		/*!< Dp, viscous damping at the pendulum pivot, N m s/rad */
+	double armLength;			/*!< Lr, motor shaft to pendulum pivot, m */
+	double armInertia;			/*!< Jr, arm and motor about the motor shaft, kg m^2 */
+	double armDamping;			/*!< Dr, viscous damping at the motor shaft, N m s/rad */
+	double torqueConstant;		/*!< kt, N m/A */
+	double backEmfConstant;		/*!< km, V s/rad */
+	double motorResistance;		/*!< Rm, Ohm */
+	double gravity;				/*!< g, m/s^2 */
+
+	pendulumParameters();
+};
+
+/*!
+ * @brief Rotary pendulum linearised about upright, x' = A x + B u
+ *
+ * State is stateVector order [pAngle mAngle pVelocity mVelocity] and the
+ * input u is the motor voltage.
+ */
+class pendulumModel {
+
+public:
+	pendulumModel(const pendulumParameters& p = pendulumParameters());
+
+	/*!
+	 * @brief Continuous time system matrix
+	 */
+	const matrix<STATE_SIZE, STATE_SIZE>& A() const {
+		return a;
+	}
+
+	/*!
+	 * @brief Continuous time input matrix
+	 */
+	const stateVector& B() const {
+		return b;
+	}
+
+	const pendulumParameters& parameters() const {
+		return params;
+	}
+
+	/*!
+	 * @brief Zero order hold discretisation, x[k+1] = Ad x[k] + Bd u[k]
+	 *
+	 * @param[in] dt sample period in seconds
+	 * @param[out] Ad discrete system matrix
+	 * @param[out] Bd discrete input matrix
+	 */
+	void discretise(double dt, matrix<STATE_SIZE, STATE_SIZE>& Ad, stateVector& Bd) const;
+
+private:
+	pendulumParameters params;
+	matrix<STATE_SIZE, STATE_SIZE> a;
+	stateVector b;
+};
+
+} /* namespace Model */
+
+#endif /* INCLUDE_MODEL_PENDULUMMODEL_H_ */
@@ -0,0 +1,177 @@
+/**
+ * @file pendulumSim.cpp
+ * @brief Nonlinear rotary pendulum simulator
+ *
+ * @author Troy Dack
+ * @date Copyright (C) 2015
+ *
+ * @license
+ * \verbinclude "Troy Dack - GPL-2.0.txt"
+ *
+ **/
+
+#include <Model/pendulumSim.h>
+#include <pendulum.h>
+#include <controlPipeline.h>
+#include <fastTrig.h>
+#include <cmath>
+
+namespace Model {
+
+bool fitMotor(pendulumParameters& p, double volts, double speed, double timeConstant) {
+	double gain = speed / volts;
+	double RD = p.motorResistance * p.armDamping;
+	// gain k^2 - k + gain Rm Dr = 0, the larger root is the one with little friction
+	double disc = 1 - 4 * gain * gain * RD;
+	if (disc < 0 || gain <= 0 || timeConstant <= 0) {
+		return false;
+	}
+	double k = (1 + std::sqrt(disc)) / (2 * gain);
+	double inertia = timeConstant * (RD + k * k) / p.motorResistance
+					 - p.pendulumMass * p.armLength * p.armLength;
+	if (inertia <= 0) {
+		return false;
+	}
+	p.torqueConstant = k;
+	p.backEmfConstant = k;
+	p.armInertia = inertia;
+	return true;
+}
+
+pendulumParameters measuredParameters() {
+	pendulumParameters p;
+	fitMotor(p, MOTOR_STEP_VOLTAGE, MOTOR_STEP_SPEED, MOTOR_TIME_CONSTANT);
+	return p;
+}
+
+pendulumSim::pendulumSim(const pendulumParameters& p, double supplyVoltage)
+	: supply(supplyVoltage)
+	, deadband(MOTOR_DEADBAND)
+	, h(SIM_STEP)
+	, volts(0)
+	, t(0)
+{
+	double lp = p.pendulumLength / 2;
+	Jp = p.pendulumInertia + p.pendulumMass * lp * lp;
+	Jr = p.armInertia + p.pendulumMass * p.armLength * p.armLength;
+	mll = p.pendulumMass * lp * lp;
+	mLl = p.pendulumMass * p.armLength * lp;
+	mgl = p.pendulumMass * p.gravity * lp;
+	Dp = p.pendulumDamping;
+	Dr = p.armDamping;
+	kv = p.torqueConstant / p.motorResistance;
+	kb = p.backEmfConstant;
+	eqeps[0] = eqeps[1] = NULL;
+	reset(stateVector::zeros());
+}
+
+void pendulumSim::reset(const stateVector& s) {
+	x = s;
+	t = 0;
+	volts = 0;
+	counts[0] = (int64_t)std::floor(x[0] / (2 * M_PI) * ENCODER_PPR);
+	counts[1] = (int64_t)std::floor(x[1] / (2 * M_PI) * MOTOR_PPR);
+	measuredCounts[0] = counts[0];
+	measuredCounts[1] = counts[1];
+	measuredTime = 0;
+}
+
+void pendulumSim::setCommand(int speed) {
+	if (speed > Pololu::SMC_MAX_SPEED) {
+		speed = Pololu::SMC_MAX_SPEED;
+	} else if (speed < -Pololu::SMC_MAX_SPEED) {
+		speed = -Pololu::SMC_MAX_SPEED;
+	}
+	// The motor doesn't turn until the command is past the deadband
+	int effective = (std::abs(speed) > deadband) ? speed - (speed > 0 ? deadband : -deadband) : 0;
+	volts = effective * supply / Pololu::SMC_MAX_SPEED;
+}
+
+void pendulumSim::setDeadband(int speed) {
+	deadband = (speed > 0) ? speed : 0;
+}
+
+void pendulumSim::setStepSize(double step) {
+	if (step > 0) {
+		h = step;
+	}
+}
+
+void pendulumSim::attach(BBB::eQEPSim* pendulum, BBB::eQEPSim* motor) {
+	eqeps[0] = pendulum;
+	eqeps[1] = motor;
+}
+
+/* derivative(...) ************************************************************
+ * Lagrange's equations for the arm angle a and pendulum angle p (0 upright):
+ *   (Jr + m lp^2 sin^2 p) a'' - m Lr lp cos p p'' + m Lr lp sin p p'^2
+ *       + 2 m lp^2 sin p cos p a' p' = kt/Rm (V - km a') - Dr a'
+ *   Jp p'' - m Lr lp cos p a'' - m lp^2 sin p cos p a'^2 = m g lp sin p - Dp p'
+ * which linearise to pendulumModel about upright.
+ ******************************************************************************/
+stateVector pendulumSim::derivative(const stateVector& s) const {
+	double sp = std::sin(s[0]);
+	double cp = std::cos(s[0]);
+	double pv = s[2], av = s[3];
+	double torque = kv * (volts - kb * av) - Dr * av;
+
+	double m11 = Jr + mll * sp * sp;
+	double m12 = -mLl * cp;
+	double f1 = torque - mLl * sp * pv * pv - 2 * mll * sp * cp * av * pv;
+	double f2 = mgl * sp - Dp * pv + mll * sp * cp * av * av;
+	double det = m11 * Jp - m12 * m12;
+
+	stateVector d;
+	d[0] = pv;
+	d[1] = av;
+	d[2] = (m11 * f2 - m12 * f1) / det;
+	d[3] = (Jp * f1 - m12 * f2) / det;
+	return d;
+}
+
+void pendulumSim::run(double seconds) {
+	int steps = (int)(seconds / h + 0.5);
+	for (int i = 0; i < steps; i++) {
+		stateVector k1 = derivative(x);
+		stateVector k2 = derivative(x + k1 * (h / 2));
+		stateVector k3 = derivative(x + k2 * (h / 2));
+		stateVector k4 = derivative(x + k3 * h);
+		x += (k1 + (k2 + k3) * 2 + k4) * (h / 6);
+		t += h;
+		updateCounts(h);
+	}
+}
+
+void pendulumSim::updateCounts(double dt) {
+	int64_t now[2];
+	now[0] = (int64_t)std::floor(x[0] / (2 * M_PI) * ENCODER_PPR);
+	now[1] = (int64_t)std::floor(x[1] / (2 * M_PI) * MOTOR_PPR);
+	for (int i = 0; i < 2; i++) {
+		if (eqeps[i] != NULL) {
+			eqeps[i]->step((int32_t)(now[i] - counts[i]), dt);
+		}
+		counts[i] = now[i];
+	}
+}
+
+pendulumState pendulumSim::measure() {
+	pendulumState m = pendulumState();
+	double elapsed = t - measuredTime;
+	m.pAngle = wrapAngle(counts[0] * 2 * M_PI / ENCODER_PPR);
+	m.mAngle = counts[1] * 2 * M_PI / MOTOR_PPR;
+	if (elapsed > 0) {
+		m.pVelocity = (counts[0] - measuredCounts[0]) * 2 * M_PI / ENCODER_PPR / elapsed;
+		m.mVelocity = (counts[1] - measuredCounts[1]) * 2 * M_PI / MOTOR_PPR / elapsed;
+	}
+	m.timestamp = (uint64_t)(t * 1e9);
+	measuredCounts[0] = counts[0];
+	measuredCounts[1] = counts[1];
+	measuredTime = t;
+	return m;
+}
+
+void pendulumSim::publish(pendulumStateBuffer* out) {
+	out->publish(measure());
+}
+
+} /* namespace Model */
@@ -0,0 +1,185 @@
+/**
+ *! @file pendulumSim.h
+ *! Nonlinear rotary pendulum simulator
+ *!
+ *! @author Troy Dack
+ *! @date Copyright (C) 2015
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ **/
+
+#ifndef INCLUDE_MODEL_PENDULUMSIM_H_
+#define INCLUDE_MODEL_PENDULUMSIM_H_
+
+#include <Model/pendulumModel.h>
+#include <pendulumState.h>
+#include <bbb-eqep/eqep-sim.h>
+#include <cstdint>
+
+namespace Model {
+
+const double MOTOR_STEP_VOLTAGE = 11.62;	/*!< @brief Motor voltage of the step tests in data/motor_kt */
+const double MOTOR_STEP_SPEED = 25.1;		/*!< @brief Arm speed the step tests settle at, rad/s */
+const double MOTOR_TIME_CONSTANT = 0.054;	/*!< @brief Time the step tests take to reach 63% of MOTOR_STEP_SPEED, s */
+const double SIM_STEP = 0.001;				/*!< @brief Default integration step, s */
+
+/*!
+ * @brief Set the motor constants to match a measured arm step response
+ *  The arm is a first order system from voltage to speed, with gain
+ *  kt / (Rm Dr + kt km) and time constant Jr Rm / (Rm Dr + kt km).  With
+ *  kt = km and the resistance and arm damping kept, this solves for kt and
+ *  the arm inertia.
+ *
+ * @param[in,out] p parameters to update
+ * @param[in] volts step voltage
+ * @param[in] speed steady arm speed in rad/s
+ * @param[in] timeConstant time to 63% of speed in seconds
+ * @return False, leaving p unchanged, if no kt gives that gain with p's damping
+ */
+bool fitMotor(pendulumParameters& p, double volts, double speed, double timeConstant);
+
+/*!
+ * @brief Default parameters with the motor fitted to data/motor_kt
+ */
+pendulumParameters measuredParameters();
+
+/*!
+ * @brief Rotary (Furuta) pendulum simulator
+ *
+ * Integrates the full nonlinear equations of motion of the arm and pendulum,
+ * with the motor's back emf and the Simple Motor Controller's deadband, by
+ * fixed step fourth order Runge-Kutta.  Nothing waits on a clock, so it runs
+ * as fast as the arithmetic allows; a 20ms control period is about 80
+ * evaluations of the dynamics.
+ *
+ * The simulator takes the same SMC speed command the motor does and gives
+ * the controllers the same pendulumState the encoders would, quantised to
+ * whole encoder counts.  It can also drive simulated eQEPs so the encoder
+ * code runs unchanged.
+ *
+ * State is stateVector order [pAngle mAngle pVelocity mVelocity], with the
+ * pendulum angle 0 upright and increasing continuously as it goes round.
+ */
+class pendulumSim {
+
+public:
+	/*!
+	 * @param[in] p rig parameters
+	 * @param[in] supplyVoltage motor voltage at full speed command
+	 */
+	pendulumSim(const pendulumParameters& p = measuredParameters(), double supplyVoltage = 11.7);
+
+	/*!
+	 * @brief Start again from a state, at time zero with the motor stopped
+	 *
+	 * @param[in] x true state
+	 */
+	void reset(const stateVector& x);
+
+	/*!
+	 * @brief Set the motor speed command, as Pololu::SMC::SetTargetSpeed()
+	 *
+	 * @param[in] speed -SMC_MAX_SPEED to SMC_MAX_SPEED
+	 */
+	void setCommand(int speed);
+
+	/*!
+	 * @brief Commands with magnitude up to this leave the motor stopped
+	 */
+	void setDeadband(int speed);
+
+	/*!
+	 * @brief Integration step, seconds
+	 */
+	void setStepSize(double h);
+
+	/*!
+	 * @brief Move simulated eQEPs with the encoder counts, NULL to stop
+	 */
+	void attach(BBB::eQEPSim* pendulum, BBB::eQEPSim* motor);
+
+	/*!
+	 * @brief Advance the simulation
+	 *
+	 * @param[in] seconds time to advance by, rounded to whole steps
+	 */
+	void run(double seconds);
+
+	/*!
+	 * @brief True state
+	 */
+	const stateVector& state() const {
+		return x;
+	}
+
+	/*!
+	 * @brief Simulated time in seconds
+	 */
+	double time() const {
+		return t;
+	}
+
+	/*!
+	 * @brief Motor voltage from the current command
+	 */
+	double voltage() const {
+		return volts;
+	}
+
+	/*!
+	 * @brief State as the encoders see it
+	 *  Angles are whole encoder counts, the pendulum wrapped to [-pi, pi) as
+	 *  multiEQEP publishes it, and the velocities are the count difference
+	 *  since the previous call over the time between them.
+	 */
+	pendulumState measure();
+
+	/*!
+	 * @brief measure() and publish it, for controllers bound to the buffer
+	 */
+	void publish(pendulumStateBuffer* out);
+
+	int64_t pendulumCounts() const {
+		return counts[0];
+	}
+
+	int64_t motorCounts() const {
+		return counts[1];
+	}
+
+private:
+	stateVector derivative(const stateVector& s) const;
+	void updateCounts(double dt);
+
+	// Constant terms of the equations of motion
+	double Jp, Jr, mll, mLl, mgl, Dp, Dr, kv, kb;
+
+	double supply;
+	int deadband;
+	double h;
+	double volts;
+	double t;
+	stateVector x;
+
+	int64_t counts[2];			// encoder counts of the pendulum and motor
+	int64_t measuredCounts[2];	// counts at the last measure()
+	double measuredTime;
+	BBB::eQEPSim *eqeps[2];
+};
+
+} /* namespace Model */
+
+#endif /* INCLUDE_MODEL_PENDULUMSIM_H_ */
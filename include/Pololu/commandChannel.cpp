@@ -0,0 +1,214 @@
+/**
+ *! @file commandChannel.cpp
+ *! Latest value wins motor command channel for the SMC
+ *!
+ *! @author Troy Dack
+ *! @date Copyright (C) 2015
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ **/
+
+#include <Pololu/commandChannel.h>
+#include <periodicScheduler.h>
+#include <algorithm>
+#include <unistd.h>
+#include <ctime>
+
+namespace Pololu {
+
+	commandChannel::commandChannel(SMC* _smc)
+		: smc(_smc)
+		, telemetry(NULL)
+		, drainPollUs(10000000 / _smc->GetBaudRate())
+		, slot(CHANNEL_EMPTY)
+		, stopRequested(false)
+		, bExit(false)
+		, nPosted(0)
+		, nSent(0)
+		, nSuperseded(0)
+		, nStops(0)
+		, lastSent(0)
+	{
+		sem_init(&wake, 0, 0);
+	}
+
+	commandChannel::~commandChannel() {
+		sem_destroy(&wake);
+	}
+
+	void commandChannel::post(int speed) {
+		nPosted.fetch_add(1, std::memory_order_relaxed);
+		if (slot.exchange(speed, std::memory_order_acq_rel) != CHANNEL_EMPTY) {
+			// The writer hasn't taken the last one yet, it will take this instead
+			nSuperseded.fetch_add(1, std::memory_order_relaxed);
+		} else {
+			sem_post(&wake);
+		}
+	}
+
+	void commandChannel::postStop() {
+		stopRequested.store(true, std::memory_order_release);
+		sem_post(&wake);
+	}
+
+	void commandChannel::setTelemetry(telemetryPoller* poller) {
+		telemetry = poller;
+	}
+
+	void commandChannel::onStartHandler() {
+		while (!bExit.load()) {
+			uint64_t sleep = (uint64_t)CHANNEL_POLL_MS * 1000000;
+			if (telemetry != NULL) {
+				uint64_t byteTime = (uint64_t)drainPollUs * 1000;
+				if (telemetry->waiting()) {
+					// Replies don't wake the semaphore, look for them every couple of bytes
+					sleep = 2 * byteTime;
+				} else {
+					sleep = std::min(sleep, std::max(telemetry->timeToNext(monotonicNow()), byteTime));
+				}
+			}
+			wait(sleep);
+
+			if (stopRequested.load(std::memory_order_acquire)) {
+				sendStop();
+			} else {
+				int speed = slot.exchange(CHANNEL_EMPTY, std::memory_order_acq_rel);
+				if (speed != CHANNEL_EMPTY) {
+					smc->SetTargetSpeed(speed);
+					lastSent.store(speed, std::memory_order_relaxed);
+					nSent.fetch_add(1, std::memory_order_relaxed);
+					if (!drain()) {
+						sendStop();
+					}
+				}
+			}
+			serviceTelemetry();
+		}
+		// A stop posted just before stop() is still sent
+		if (stopRequested.load(std::memory_order_acquire)) {
+			sendStop();
+		}
+		// Let replies in flight arrive, so they aren't read as a later GetVariable()'s
+		while (telemetry != NULL && telemetry->waiting()) {
+			usleep(2 * drainPollUs);
+			readReplies(monotonicNow());
+		}
+	}
+
+	void commandChannel::readReplies(uint64_t now) {
+		unsigned char buffer[32];
+		int n;
+		while ((n = smc->ReadAvailable(buffer, sizeof(buffer))) > 0) {
+			telemetry->received(buffer, n, now);
+		}
+		telemetry->checkTimeout(now);
+	}
+
+	/* wait(...) *****************************************************************
+	 * timed on CLOCK_MONOTONIC so setting the wall clock, eg: NTP at boot, can't
+	 * stall the writer or wake it early.  Without sem_clockwait() (glibc before
+	 * 2.30) it polls the semaphore about once a byte time instead.
+	 ******************************************************************************/
+	void commandChannel::wait(uint64_t ns) {
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 30))
+		struct timespec timeout;
+		clock_gettime(CLOCK_MONOTONIC, &timeout);
+		timespecAdd(timeout, (int64_t)ns);
+		sem_clockwait(&wake, CLOCK_MONOTONIC, &timeout);
+#else
+		uint64_t deadline = monotonicNow() + ns;
+		while (sem_trywait(&wake) != 0) {
+			uint64_t now = monotonicNow();
+			if (now >= deadline) {
+				return;
+			}
+			usleep((useconds_t)std::min<uint64_t>(drainPollUs, (deadline - now) / 1000 + 1));
+		}
+#endif
+	}
+
+	/* serviceTelemetry() *********************************************************
+	 * One request per call, and only into an empty tty buffer with no new
+	 * speed waiting, so a speed posted straight after queues behind two or
+	 * three bytes.  A waiting speed the same as the last one sent changes
+	 * nothing, so it can wait; the main loop posts the speed every control
+	 * period, changed or not.  Replies come back on the other wire and don't
+	 * hold up commands at all.
+	 ******************************************************************************/
+	void commandChannel::serviceTelemetry() {
+		if (telemetry == NULL) {
+			return;
+		}
+		uint64_t now = monotonicNow();
+		readReplies(now);
+
+		unsigned char variableId;
+		int pending = slot.load(std::memory_order_acquire);
+		if ((pending == CHANNEL_EMPTY || pending == lastSent.load(std::memory_order_relaxed))
+				&& !stopRequested.load(std::memory_order_acquire)
+				&& smc->OutputQueued() == 0
+				&& telemetry->nextRequest(now, variableId)) {
+			smc->RequestVariable(variableId);
+		}
+	}
+
+	/* drain() ********************************************************************
+	 * TIOCOUTQ is polled, rather than blocking in tcdrain(), so a stop can
+	 * interrupt the wait.  Once the tty buffer is empty tcdrain() only waits for
+	 * the last few bytes in the UART FIFO.
+	 ******************************************************************************/
+	bool commandChannel::drain() {
+		int queued;
+		while ((queued = smc->OutputQueued()) > 0) {
+			if (stopRequested.load(std::memory_order_acquire)) {
+				return false;
+			}
+			usleep(drainPollUs);
+		}
+		if (queued == 0) {
+			smc->Drain();
+		}
+		return true;
+	}
+
+	void commandChannel::sendStop() {
+		stopRequested.store(false, std::memory_order_relaxed);
+		// Speeds posted before the stop must not be sent after it
+		if (slot.exchange(CHANNEL_EMPTY, std::memory_order_acq_rel) != CHANNEL_EMPTY) {
+			nSuperseded.fetch_add(1, std::memory_order_relaxed);
+		}
+		// Not flushed, cutting a speed command short would latch a serial format error
+		smc->SetTargetSpeed(0);
+		lastSent.store(0, std::memory_order_relaxed);
+		nStops.fetch_add(1, std::memory_order_relaxed);
+		drain();
+	}
+
+	void commandChannel::stop() {
+		bExit.store(true);
+		sem_post(&wake);
+	}
+
+	channelStats commandChannel::getStats() {
+		channelStats s;
+		s.posted = nPosted.load(std::memory_order_relaxed);
+		s.sent = nSent.load(std::memory_order_relaxed);
+		s.superseded = nSuperseded.load(std::memory_order_relaxed);
+		s.stops = nStops.load(std::memory_order_relaxed);
+		s.lastSent = lastSent.load(std::memory_order_relaxed);
+		return s;
+	}
+} /* Pololu */
@@ -0,0 +1,138 @@
+/**
+ *! @file commandChannel.h
+ *! Latest value wins motor command channel for the SMC
+ *!
+ *! @author Troy Dack
+ *! @date Copyright (C) 2015
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ **/
+
+#ifndef INCLUDE_POLOLU_COMMANDCHANNEL_H_
+#define INCLUDE_POLOLU_COMMANDCHANNEL_H_
+
+#include <BlackLib/BlackThread/BlackThread.h>
+#include <Pololu/pololuSMC.h>
+#include <Pololu/telemetryPoller.h>
+#include <semaphore.h>
+#include <atomic>
+#include <climits>
+#include <cstdint>
+
+namespace Pololu {
+
+const int CHANNEL_EMPTY = INT_MIN;	/**< Slot value when no command is waiting */
+const int CHANNEL_POLL_MS = 100;	/**< Longest the writer sleeps before checking for stop() */
+
+/**
+ * Motor command channel counters
+ **/
+struct channelStats {
+	uint32_t posted;		/**< Speeds passed to post() */
+	uint32_t sent;			/**< Speeds written to the SMC */
+	uint32_t superseded;	/**< Speeds replaced by a newer one before they were sent */
+	uint32_t stops;			/**< Stops written to the SMC */
+	int lastSent;			/**< Last speed written */
+};
+
+/**
+ * Sends motor speeds to the SMC from its own thread, newest first.
+ *
+ * post() puts the speed in a single slot and returns straight away without
+ * locking; a speed still in the slot is replaced, so a command that was not
+ * sent in time is dropped rather than queued behind newer ones.  The writer
+ * thread sends whatever is in the slot once the previous command has left
+ * the UART, so at most one command is ever in the tty buffer and the one
+ * sent is always the newest.
+ *
+ * postStop() jumps ahead: the pending speed is thrown away and a stop is
+ * written at once, even if the writer was waiting for the UART, so it follows
+ * at most the one command already being sent.
+ *
+ * With a telemetryPoller attached the writer also sends its Get Variable
+ * requests and reads the replies, but only when no command is waiting and
+ * the UART is idle, so a speed or stop is held up by one request at most.
+ **/
+class commandChannel : public BlackLib::BlackThread {
+
+public:
+	/**
+	 * @param smc motor controller to write to, only this channel should write to it
+	 **/
+	commandChannel(SMC* smc);
+
+	~commandChannel();
+
+	/**
+	 * Send a speed as soon as the UART is free.  Lock free, safe from any thread.
+	 * @param speed target speed (-3200 to 3200)
+	 **/
+	void post(int speed);
+
+	/**
+	 * Stop the motor ahead of any speed.  Lock free, safe from any thread.
+	 * A speed posted before the stop is written is dropped, later ones are
+	 * sent as usual.
+	 **/
+	void postStop();
+
+	/**
+	 * Poll SMC variables between commands.  Call before run().
+	 * @param poller telemetry to request and decode, NULL for none
+	 **/
+	void setTelemetry(telemetryPoller* poller);
+
+	/**
+	 * Thread's start handler function.
+	 **/
+	void onStartHandler();
+
+	/**
+	 * Stops the thread running, a pending speed is not sent but a pending stop is
+	 **/
+	void stop();
+
+	channelStats getStats();
+
+private:
+	/**
+	 * Wait for the last command to leave the UART
+	 * @return false if a stop was posted while waiting
+	 **/
+	bool drain();
+	void sendStop();
+	void serviceTelemetry();
+	void readReplies(uint64_t now);
+	void wait(uint64_t ns);
+
+	SMC *smc;
+	telemetryPoller *telemetry;
+	int drainPollUs;					// about one byte time at the SMC's baud rate
+	sem_t wake;							// posted when the slot or stop flag is set
+	std::atomic<int> slot;				// newest speed not yet sent, or CHANNEL_EMPTY
+	std::atomic<bool> stopRequested;
+	std::atomic<bool> bExit;
+
+	std::atomic<uint32_t> nPosted;
+	std::atomic<uint32_t> nSent;
+	std::atomic<uint32_t> nSuperseded;
+	std::atomic<uint32_t> nStops;
+	std::atomic<int> lastSent;
+};
+
+} /* Pololu */
+
+#endif /* INCLUDE_POLOLU_COMMANDCHANNEL_H_ */
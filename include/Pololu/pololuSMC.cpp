@@ -22,19 +22,82 @@
  **/
 
 #include <fcntl.h>
+#include <poll.h>
+#include <sys/ioctl.h>
 #include <Pololu/pololuSMC.h>
 #include <termios.h> // POSIX terminal control definitions
 #include <unistd.h>
+#include <algorithm>
 #include <cstdio>
+#include <cstring>
 #include <stdexcept>
 #include <string>
 #include <iostream>
 
 namespace Pololu {
 
-	SMC::SMC(const char* tty) {
+	/**
+	 * termios constant for a baud rate, 0 if it isn't one the SMC can use
+	 **/
+	static speed_t baudConstant(int baud) {
+		switch (baud) {
+		case 1200: return B1200;
+		case 2400: return B2400;
+		case 4800: return B4800;
+		case 9600: return B9600;
+		case 19200: return B19200;
+		case 38400: return B38400;
+		case 57600: return B57600;
+		case 115200: return B115200;
+		default: return 0;
+		}
+	}
+
+	/**
+	 * CRC-7 of every byte value, from the bitwise algorithm in the SMC user's
+	 * guide, which shifts each byte in least significant bit first.
+	 **/
+	struct crc7Table {
+		unsigned char crc[256];
+
+		crc7Table() {
+			for (int i = 0; i < 256; i++) {
+				unsigned char c = i;
+				for (int j = 0; j < 8; j++) {
+					if (c & 1) {
+						c ^= CRC7_POLY;
+					}
+					c >>= 1;
+				}
+				crc[i] = c;
+			}
+		}
+	};
+
+	unsigned char crc7(const unsigned char *message, int length) {
+		static const crc7Table table;
+		unsigned char crc = 0;
+		for (int i = 0; i < length; i++) {
+			crc = table.crc[crc ^ message[i]];
+		}
+		return crc;
+	}
+
+	SMC::SMC(const char* tty, int baudRate, bool useCRC)
+		: baud(baudRate)
+		, crc(useCRC)
+		, frameLength(useCRC ? 4 : 3)
+		, byteNs(10000000000LL / baudRate)
+		, wireFree(0)
+	{
 		struct termios options;
 
+		speed_t speed = baudConstant(baud);
+		if (speed == 0) {
+			throw std::runtime_error("Unsupported SMC baud rate " + std::to_string(baud));
+		}
+		build_frames();
+
 		SMCfd = open(tty, O_RDWR | O_NOCTTY | O_NDELAY);
 		ttyActive = false;
 		if (SMC::SMCfd == -1) {
@@ -42,10 +105,12 @@ namespace Pololu {
 		} else {
 			fcntl(SMCfd, F_SETFL, FNDELAY);
 			tcgetattr(SMCfd, &options);
-			cfsetispeed(&options, B19200);
-			cfsetospeed(&options, B19200);
+			cfsetispeed(&options, speed);
+			cfsetospeed(&options, speed);
 			options.c_lflag &= ~(ECHO | ECHONL | ICANON | ISIG | IEXTEN);
 			options.c_oflag &= ~(ONLCR | OCRNL);
+			// Replies are binary, 0x11, 0x13 and 0x0D mustn't be taken as flow control or line ends
+			options.c_iflag &= ~(IXON | IXOFF | IXANY | ICRNL | INLCR | IGNCR | ISTRIP);
 			tcsetattr(SMCfd, TCSANOW, &options);
 			AutoDetectBaudRate(); // Initialise comms with motor controller
 			ExitSafeStart(); // Exit USB safe start
@@ -54,6 +119,31 @@ namespace Pololu {
 		}
 	}
 
+	/* build_frames() *************************************************************
+	 * Every Set Target Speed frame, so sending one is a table lookup.
+	 ******************************************************************************/
+	void SMC::build_frames() {
+		for (int speed = -SMC_MAX_SPEED; speed <= SMC_MAX_SPEED; speed++) {
+			unsigned char command[4];
+			int magnitude = std::abs(speed);
+			command[0] = (speed < 0) ? 0x86 : 0x85; // Motor Reverse or Forward
+			command[1] = magnitude & 0x1F;
+			command[2] = magnitude >> 5 & 0x7F;
+			command[3] = crc7(command, 3);
+			uint32_t frame = 0;
+			for (int i = frameLength - 1; i >= 0; i--) {
+				frame = (frame << 8) | command[i];
+			}
+			frames[speed + SMC_MAX_SPEED] = frame;
+		}
+	}
+
+	static int64_t monotonicNs() {
+		struct timespec now;
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		return (int64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+	}
+
 	SMC::~SMC() {
 		close(SMCfd);
 	}
@@ -68,6 +158,9 @@ namespace Pololu {
 		bytes_written = write(SMCfd, buffer, len);
 		if (bytes_written == -1) {
 			perror("Couldn't write data");
+		} else {
+			int64_t start = std::max(wireFree.load(), monotonicNs());
+			wireFree.store(start + bytes_written * byteNs);
 		}
 //		ttyActive.store(false);
 		mtx.unlock();
@@ -76,38 +169,80 @@ namespace Pololu {
 
 	int SMC::serial_read() {
 		unsigned char response[2];
-		if (ttyActive.load()) {
-			return -1;
-		} else {
-			ttyActive.store(true);
-		}
 
-		if(read(SMCfd,response,2) != 2)
+		// The port is non-blocking, wait for the reply to arrive
+		int received = 0;
+		while (received < 2) {
+			struct pollfd pfd = { SMCfd, POLLIN, 0 };
+			if (poll(&pfd, 1, SMC_READ_TIMEOUT_MS) <= 0) {
+				break;
+			}
+			int n = read(SMCfd, response + received, 2 - received);
+			if (n <= 0) {
+				break;
+			}
+			received += n;
+		}
+		if (received != 2)
 		{
 			perror("smcGetVariable: error reading");
-			ttyActive.store(false);
 			return SERIAL_ERROR;
 		}
-		ttyActive.store(false);
 		return response[0] + 256 * response[1];
 	}
 
+	int SMC::send_command(const unsigned char *command, int len) {
+		unsigned char framed[8];
+		memcpy(framed, command, len);
+		if (crc) {
+			framed[len] = crc7(command, len);
+			len++;
+		}
+		return serial_write(framed, len);
+	}
+
 	int SMC::GetVariable(unsigned char variableId)
+	{
+	  // Claim the reply before asking, so two readers can't take each other's bytes
+	  bool idle = false;
+	  if (!ttyActive.compare_exchange_strong(idle, true)) {
+		return SERIAL_ERROR;
+	  }
+	  // Anything already received is a late reply to someone else's request
+	  tcflush(SMCfd, TCIFLUSH);
+	  unsigned char command[] = {0xA1, variableId};
+	  send_command(command, sizeof(command));
+	  int value = serial_read();
+	  ttyActive.store(false);
+	  return value;
+	}
+
+	int SMC::RequestVariable(unsigned char variableId)
 	{
 	  unsigned char command[] = {0xA1, variableId};
-	  serial_write(command, sizeof(command));
-	  return serial_read();
+	  return send_command(command, sizeof(command));
+	}
+
+	int SMC::ReadAvailable(unsigned char *buffer, int len)
+	{
+	  int n = read(SMCfd, buffer, len);
+	  return (n < 0) ? 0 : n;
 	}
 
 	int SMC::GetTargetSpeed()
 	{
-	  int val = GetVariable(20);
+	  int val = GetVariable(VAR_TARGET_SPEED);
 	  return val == SERIAL_ERROR ? SERIAL_ERROR : (signed short)val;
 	}
 
 	int SMC::GetErrorStatus()
 	{
-	  return GetVariable(0);
+	  return GetVariable(VAR_ERROR_STATUS);
+	}
+
+	int SMC::GetSerialErrors()
+	{
+	  return GetVariable(VAR_SERIAL_ERRORS);
 	}
 
 	int SMC::AutoDetectBaudRate()
@@ -120,33 +255,51 @@ namespace Pololu {
 	int SMC::ExitSafeStart()
 	{
 	  unsigned char command[] = {0x83}; // Exit safe start command
-	  serial_write(command, sizeof command);
+	  send_command(command, sizeof command);
 	  return 0;
 	}
 
 	int SMC::SetTargetSpeed(int speed)
 	{
+	  unsigned char command[4];
+	  int len = GetFrame(speed, command);
+	  serial_write(command, len);
+	  return 0;
+	}
 
-	  unsigned char command[3];
+	int SMC::SetTargetSpeed(double speed) {
+		return SetTargetSpeed( (int)(SMC_MAX_SPEED * speed/100) );
+	}
 
-	  if (speed < 0)
-	  {
-		command[0] = 0x86; // Motor Reverse
-		speed = -speed;
-	  }
-	  else
-	  {
-		command[0] = 0x85; // Motor Forward
-	  }
-	  command[1] = speed & 0x1F;
-	  command[2] = speed >> 5 & 0x7F;
+	int SMC::OutputQueued() {
+		int queued = 0;
+		if (ioctl(SMCfd, TIOCOUTQ, &queued) == -1) {
+			return -1;
+		}
+		int64_t left = wireFree.load() - monotonicNs();
+		int onWire = (left > 0) ? (int)((left + byteNs - 1) / byteNs) : 0;
+		return std::max(queued, onWire);
+	}
 
-	  serial_write(command, sizeof command);
+	int SMC::GetBaudRate() {
+		return baud;
+	}
 
-	  return 0;
+	bool SMC::GetCRC() {
+		return crc;
 	}
 
-	int SMC::SetTargetSpeed(double speed) {
-		return SetTargetSpeed( (int)(SMC_MAX_SPEED * speed/100) );
+	int SMC::GetFrame(int speed, unsigned char *frame) {
+		speed = std::max(-SMC_MAX_SPEED, std::min(SMC_MAX_SPEED, speed));
+		uint32_t f = frames[speed + SMC_MAX_SPEED];
+		frame[0] = f;
+		frame[1] = f >> 8;
+		frame[2] = f >> 16;
+		frame[3] = f >> 24;
+		return frameLength;
+	}
+
+	void SMC::Drain() {
+		tcdrain(SMCfd);
 	}
 } /* Pololu */
@@ -25,6 +25,7 @@
 #define INCLUDE_POLOLU_POLOLUSMC_H_
 
 #include <atomic>
+#include <cstdint>
 #include <mutex>
 
 namespace Pololu {
@@ -57,6 +58,29 @@ const unsigned int ERR_CRC			= (1 << 5);
 const int SMC_MAX_SPEED			= 3200; // Max speed controller will accept
 const int SMC_MIN_SPEED			= 128;  // Min speed to move motor
 
+const int SMC_DEFAULT_BAUD		= 19200;	// Baud rate used unless another is asked for
+const int SMC_MAX_BAUD			= 115200;	// Fastest standard rate the SMC accepts
+const int SMC_READ_TIMEOUT_MS	= 50;		// Longest to wait for a reply to Get Variable
+const unsigned char CRC7_POLY	= 0x91;		// CRC-7 polynomial, bit reversed, as the SMC user's guide
+
+/**
+ * Variable IDs for GetVariable(), from the SMC user's guide
+ **/
+const unsigned char VAR_ERROR_STATUS	= 0;	// Errors currently stopping the motor
+const unsigned char VAR_SERIAL_ERRORS	= 2;	// Serial errors since last read
+const unsigned char VAR_TARGET_SPEED	= 20;	// Signed target speed
+const unsigned char VAR_INPUT_VOLTAGE	= 23;	// VIN in mV
+const unsigned char VAR_TEMPERATURE		= 24;	// Board temperature in 0.1 degrees C
+const unsigned char VAR_CURRENT			= 44;	// Motor current in mA, firmware that measures it
+
+/**
+ * CRC-7 of a message, as the SMC checks it when CRC is enabled.
+ * @param message bytes to check
+ * @param length number of bytes
+ * @return CRC byte to append
+ **/
+unsigned char crc7(const unsigned char *message, int length);
+
 /**
  *  Pololu SMC control and access class.
  *
@@ -71,18 +95,29 @@ private:
 	int SMCfd; /**< File descriptor to the serial port */
 	int serial_write(const unsigned char *buffer, int len);
 	int serial_read();
+	int send_command(const unsigned char *command, int len);
+	void build_frames();
 	std::atomic<bool> ttyActive;
 	std::mutex mtx;
+	int baud; /**< Serial baud rate */
+	bool crc; /**< Append a CRC-7 byte to every command */
+	int frameLength; /**< Bytes in a Set Target Speed frame, 3 or 4 with CRC */
+	uint32_t frames[2 * SMC_MAX_SPEED + 1]; /**< Set Target Speed frame for each speed, low byte first */
+	int64_t byteNs; /**< Time to send one byte, start, 8 data and stop bits */
+	std::atomic<int64_t> wireFree; /**< CLOCK_MONOTONIC time the last byte written will have been sent */
 
 public:
 	/**
 	 * Constructor.  Pass the tty device entry to be used for UART communication.
 	 * Initialises comms with SMC, auto-detects baud rate and sends USB Safe start
-	 * command.
+	 * command.  Throws std::runtime_error if the baud rate is not supported.
 	 *
 	 * @param tty  path to /dev/tty of UART, eg: /dev/ttyO1
+	 * @param baudRate serial baud rate, one of the standard rates up to SMC_MAX_BAUD
+	 * @param useCRC append a CRC-7 byte to every command, the SMC must have CRC
+	 * 			enabled in its settings to match
 	 **/
-	SMC(const char* tty);
+	SMC(const char* tty, int baudRate = SMC_DEFAULT_BAUD, bool useCRC = false);
 
 	/**
 	 * Destructor
@@ -94,13 +129,32 @@ public:
 	 * Returns SERIAL_ERROR if there was an error.
 	 * The 'variableId' argument must be one of IDs listed in the
 	 * "Controller Variables" section of the user's guide.
-	 * For variables that are signed, additional processing is required
+	 * For variables that are signed, additional processing is required.
+	 * Waits up to SMC_READ_TIMEOUT_MS for the reply.  Fails straight away if
+	 * another thread is waiting for a reply.
 	 * @param variableId SMC variable to retrieve
 	 * @return variable value or SERIAL_ERROR if there was an error
 	 * @see GetTargetSpeed() for an example.
 	 **/
 	int GetVariable(unsigned char variableId);
 
+	/**
+	 * Sends a Get Variable request without waiting for the reply, for
+	 * callers that read replies themselves, eg: telemetryPoller.  Don't mix
+	 * with GetVariable().
+	 * @param variableId SMC variable to request
+	 * @return bytes written
+	 **/
+	int RequestVariable(unsigned char variableId);
+
+	/**
+	 * Reads whatever has been received, without waiting.
+	 * @param buffer receives the bytes
+	 * @param len size of buffer
+	 * @return number of bytes read, 0 if none
+	 **/
+	int ReadAvailable(unsigned char *buffer, int len);
+
 	/**
 	 * Returns the target speed (-3200 to 3200).
 	 * @return target speed or SERIAL_ERROR if there is an error.
@@ -115,6 +169,14 @@ public:
 	  **/
 	int GetErrorStatus();
 
+	/**
+	 * Returns the serial errors that have occurred since this was last read,
+	 * ERR_FRAME to ERR_CRC.  A command that arrived corrupted sets ERR_CRC
+	 * when CRC is enabled, and is not acted on.
+	 * @return integer bit field of errors or SERIAL_ERROR if there is an error.
+	 **/
+	int GetSerialErrors();
+
 	/** Sends the Baud Rate auto detect command, which is required to initiate serial
 	 * communication.
 	 * @return 0 if successful, SERIAL_ERROR if there was an error sending.
@@ -128,13 +190,46 @@ public:
 	int ExitSafeStart();
 
 	/**
-	 * Sets the SMC's target speed.
+	 * Sets the SMC's target speed.  The frame is looked up, not built, and
+	 * speeds outside the range are clamped.
 	 * @param (int)speed target speed (-3200 to 3200) to send to SMC
 	 * @param (float)speed target speed as a percentage (-100.0 to 100.0)
 	 * @return 0 if successful, SERIAL_ERROR if there was an error sending.
 	 **/
 	int SetTargetSpeed(int speed);
 	int SetTargetSpeed(double speed);
+
+	/**
+	 * Number of bytes written but not yet sent by the UART driver.  At least
+	 * the bytes that can't have left at the baud rate yet, so a pseudo
+	 * terminal, which reports nothing queued, is paced like a UART.
+	 * @return byte count, or -1 if it could not be read
+	 **/
+	int OutputQueued();
+
+	/**
+	 * Serial baud rate in use
+	 **/
+	int GetBaudRate();
+
+	/**
+	 * True if a CRC-7 byte is appended to every command
+	 **/
+	bool GetCRC();
+
+	/**
+	 * Set Target Speed frame for a speed, as it is written to the serial port
+	 * @param speed target speed (-3200 to 3200)
+	 * @param frame receives the frame, at most 4 bytes
+	 * @return number of bytes in the frame
+	 **/
+	int GetFrame(int speed, unsigned char *frame);
+
+	/**
+	 * Waits until everything written has been sent, including the UART FIFO.
+	 * A pseudo terminal doesn't wait; poll OutputQueued() first.
+	 **/
+	void Drain();
 }; /* SMC */
 
 } /* Pololu */
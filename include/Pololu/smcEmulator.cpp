@@ -0,0 +1,352 @@
+/**
+ *! @file smcEmulator.cpp
+ *! Pseudo terminal Simple Motor Controller emulator
+ *!
+ *! @author Troy Dack
+ *! @date Copyright (C) 2015
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ **/
+
+#include <Pololu/smcEmulator.h>
+#include <periodicScheduler.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstdlib>
+#include <stdexcept>
+
+namespace Pololu {
+
+	/**
+	 * Data bytes after each compact protocol command byte, -1 if unknown
+	 **/
+	static int dataBytes(unsigned char command) {
+		switch (command) {
+		case 0x83: return 0;	// Exit Safe Start
+		case 0x85: return 2;	// Motor Forward
+		case 0x86: return 2;	// Motor Reverse
+		case 0x92: return 1;	// Motor Brake
+		case 0xA1: return 1;	// Get Variable
+		case 0xE0: return 0;	// Stop Motor
+		default: return -1;
+		}
+	}
+
+	smcEmulator::smcEmulator(int baudRate, bool useCRC)
+		: master(-1)
+		, slave(-1)
+		, baud(baudRate)
+		, crc(useCRC)
+		, byteNs(10000000000ULL / baudRate)
+		, responseNs((uint64_t)EMULATOR_RESPONSE_US * 1000)
+		, reportsCurrent(true)
+		, rxFree(0)
+		, txFree(0)
+		, detected(false)
+		, length(0)
+		, expected(0)
+		, serialErrors(0)
+		, errorsOccurred(0)
+		, target(0)
+		, errors(SAFE_START_VIOLATION)
+		, vin(12000)
+		, temperature(300)
+		, current(0)
+		, bExit(false)
+		, nBytes(0)
+		, nCommands(0)
+		, nSpeeds(0)
+		, nRequests(0)
+		, nCRC(0)
+		, nFormat(0)
+	{
+		master = posix_openpt(O_RDWR | O_NOCTTY);
+		if (master == -1 || grantpt(master) != 0 || unlockpt(master) != 0) {
+			throw std::runtime_error("Unable to open a pseudo terminal");
+		}
+		fcntl(master, F_SETFL, O_NONBLOCK);
+		slave = open(ptsname(master), O_RDWR | O_NOCTTY);
+		if (slave == -1) {
+			close(master);
+			throw std::runtime_error("Unable to open " + std::string(ptsname(master)));
+		}
+		// Raw until SMC sets it up, so nothing is echoed back
+		struct termios options;
+		tcgetattr(slave, &options);
+		cfmakeraw(&options);
+		tcsetattr(slave, TCSANOW, &options);
+	}
+
+	smcEmulator::~smcEmulator() {
+		close(slave);
+		close(master);
+	}
+
+	std::string smcEmulator::ttyName() {
+		return ptsname(master);
+	}
+
+	/* onStartHandler() ***********************************************************
+	 * Bytes are read no faster than the wire could deliver them.  A byte found
+	 * waiting when the wire is free is taken to have started then, or when the
+	 * emulator woke to find it, if the pty had been empty.
+	 ******************************************************************************/
+	void smcEmulator::onStartHandler() {
+		uint64_t idleSince = monotonicNow();
+		while (!bExit.load()) {
+			uint64_t now = monotonicNow();
+			bool idle = false;
+			if (now >= rxFree) {
+				uint64_t start = std::max(rxFree, idleSince);
+				unsigned char buffer[16];
+				int n = (int)std::max((uint64_t)1, std::min((uint64_t)sizeof(buffer), (now - start) / byteNs));
+				int got = read(master, buffer, n);
+				if (got > 0) {
+					for (int i = 0; i < got; i++) {
+						start += byteNs;
+						timedByte b = { start, buffer[i] };
+						rx.push_back(b);
+					}
+					rxFree = start;
+					nBytes.fetch_add(got, std::memory_order_relaxed);
+				} else {
+					idle = true;
+					idleSince = now;
+				}
+			}
+
+			while (!rx.empty() && rx.front().due <= now) {
+				receive(rx.front().value, rx.front().due);
+				rx.pop_front();
+			}
+			while (!tx.empty() && tx.front().due <= now) {
+				// A reply the reader has no room for is lost, as on a UART
+				if (write(master, &tx.front().value, 1) != 1) {
+					tx.clear();
+					break;
+				}
+				tx.pop_front();
+			}
+
+			uint64_t wake = now + 100000000ULL;
+			if (!idle) {
+				wake = std::min(wake, rxFree);
+			}
+			if (!rx.empty()) {
+				wake = std::min(wake, rx.front().due);
+			}
+			if (!tx.empty()) {
+				wake = std::min(wake, tx.front().due);
+			}
+			uint64_t sleep = (wake > now) ? wake - now : 0;
+			struct timespec timeout = { (time_t)(sleep / 1000000000), (long)(sleep % 1000000000) };
+			struct pollfd pfd = { master, POLLIN, 0 };
+			if (ppoll(&pfd, idle ? 1 : 0, &timeout, NULL) > 0) {
+				idleSince = monotonicNow();
+			}
+		}
+	}
+
+	void smcEmulator::receive(unsigned char value, uint64_t now) {
+		if (value == 0xAA && expected == 0) {
+			detected = true;
+			return;
+		}
+		if (!detected) {
+			return;
+		}
+		if (value & 0x80) {
+			if (expected > 0) {
+				serialError(ERR_FORMAT);	// the last command was cut short
+			}
+			int data = dataBytes(value);
+			if (data < 0) {
+				serialError(ERR_FORMAT);
+				return;
+			}
+			frame[0] = value;
+			length = 1;
+			expected = data + (crc ? 1 : 0);
+		} else {
+			if (expected == 0) {
+				serialError(ERR_FORMAT);	// data byte without a command
+				return;
+			}
+			frame[length++] = value;
+			expected--;
+		}
+		if (expected == 0) {
+			execute(now);
+		}
+	}
+
+	void smcEmulator::execute(uint64_t now) {
+		if (crc) {
+			length--;
+			if (crc7(frame, length) != frame[length]) {
+				nCRC.fetch_add(1, std::memory_order_relaxed);
+				serialError(ERR_CRC);
+				return;
+			}
+		}
+		int speed;
+		switch (frame[0]) {
+		case 0x85:
+		case 0x86:
+			speed = frame[1] + 32 * frame[2];
+			if (speed > SMC_MAX_SPEED) {
+				serialError(ERR_FORMAT);
+				return;
+			}
+			target.store(frame[0] == 0x86 ? -speed : speed);
+			nSpeeds.fetch_add(1, std::memory_order_relaxed);
+			break;
+		case 0x92:
+			if (frame[1] > 32) {
+				serialError(ERR_FORMAT);
+				return;
+			}
+			target.store(0);
+			break;
+		case 0xA1: {
+			bool answered;
+			int value = variable(frame[1], answered);
+			if (!answered) {
+				return;
+			}
+			reply(value, now);
+			nRequests.fetch_add(1, std::memory_order_relaxed);
+			break;
+		}
+		case 0xE0:
+			target.store(0);
+			errors.fetch_or(SAFE_START_VIOLATION);
+			errorsOccurred |= SAFE_START_VIOLATION;
+			break;
+		case 0x83:
+			errors.fetch_and(~SAFE_START_VIOLATION);
+			break;
+		}
+		// A good command clears the serial error
+		errors.fetch_and(~SERIAL_ERROR);
+		nCommands.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	int smcEmulator::variable(unsigned char id, bool& answered) {
+		answered = true;
+		int value;
+		switch (id) {
+		case VAR_ERROR_STATUS:
+			return errors.load();
+		case 1:						// errors occurred
+			value = errorsOccurred | errors.load();
+			errorsOccurred = 0;
+			return value;
+		case VAR_SERIAL_ERRORS:
+			value = serialErrors;
+			serialErrors = 0;
+			return value;
+		case VAR_TARGET_SPEED:
+			return target.load() & 0xFFFF;
+		case 21:					// speed
+			return motorSpeed() & 0xFFFF;
+		case VAR_INPUT_VOLTAGE:
+			return vin.load();
+		case VAR_TEMPERATURE:
+			return temperature.load();
+		case VAR_CURRENT:
+			if (reportsCurrent) {
+				return current.load();
+			}
+			answered = false;
+			serialError(ERR_FORMAT);
+			return 0;
+		default:
+			return 0;
+		}
+	}
+
+	void smcEmulator::reply(int value, uint64_t now) {
+		uint64_t start = std::max(txFree, now + responseNs);
+		unsigned char bytes[2] = { (unsigned char)(value & 0xFF), (unsigned char)(value >> 8 & 0xFF) };
+		for (int i = 0; i < 2; i++) {
+			start += byteNs;
+			timedByte b = { start, bytes[i] };
+			tx.push_back(b);
+		}
+		txFree = start;
+	}
+
+	void smcEmulator::serialError(unsigned int error) {
+		serialErrors |= error;
+		errorsOccurred |= SERIAL_ERROR;
+		errors.fetch_or(SERIAL_ERROR);
+		expected = 0;
+		if (error == ERR_FORMAT) {
+			nFormat.fetch_add(1, std::memory_order_relaxed);
+		}
+	}
+
+	int smcEmulator::motorSpeed() {
+		return (errors.load() == 0) ? target.load() : 0;
+	}
+
+	int smcEmulator::targetSpeed() {
+		return target.load();
+	}
+
+	int smcEmulator::errorStatus() {
+		return errors.load();
+	}
+
+	void smcEmulator::setInputVoltage(int millivolts) {
+		vin.store(millivolts);
+	}
+
+	void smcEmulator::setTemperature(int tenthsC) {
+		temperature.store(tenthsC);
+	}
+
+	void smcEmulator::setCurrent(int milliamps) {
+		current.store(milliamps);
+	}
+
+	void smcEmulator::setReportsCurrent(bool reports) {
+		reportsCurrent = reports;
+	}
+
+	void smcEmulator::setResponseDelay(int us) {
+		responseNs = (uint64_t)us * 1000;
+	}
+
+	void smcEmulator::stop() {
+		bExit.store(true);
+	}
+
+	emulatorStats smcEmulator::getStats() {
+		emulatorStats s;
+		s.bytes = nBytes.load(std::memory_order_relaxed);
+		s.commands = nCommands.load(std::memory_order_relaxed);
+		s.speeds = nSpeeds.load(std::memory_order_relaxed);
+		s.requests = nRequests.load(std::memory_order_relaxed);
+		s.crcErrors = nCRC.load(std::memory_order_relaxed);
+		s.formatErrors = nFormat.load(std::memory_order_relaxed);
+		return s;
+	}
+} /* Pololu */
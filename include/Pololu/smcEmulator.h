@@ -0,0 +1,184 @@
+/**
+ *! @file smcEmulator.h
+ *! Pseudo terminal Simple Motor Controller emulator
+ *!
+ *! @author Troy Dack
+ *! @date Copyright (C) 2015
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ **/
+
+#ifndef INCLUDE_POLOLU_SMCEMULATOR_H_
+#define INCLUDE_POLOLU_SMCEMULATOR_H_
+
+#include <BlackLib/BlackThread/BlackThread.h>
+#include <Pololu/pololuSMC.h>
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <string>
+
+namespace Pololu {
+
+const int EMULATOR_RESPONSE_US = 100;	/**< Default time the emulated SMC takes to start a reply */
+
+/**
+ * Emulated SMC counters
+ **/
+struct emulatorStats {
+	uint32_t bytes;			/**< Bytes received */
+	uint32_t commands;		/**< Commands acted on */
+	uint32_t speeds;		/**< Set Target Speed commands acted on */
+	uint32_t requests;		/**< Get Variable commands answered */
+	uint32_t crcErrors;		/**< Commands ignored because the CRC didn't match */
+	uint32_t formatErrors;	/**< Commands cut short, unknown or out of range */
+};
+
+/**
+ * Simple Motor Controller on a pseudo terminal, so SMC can run off target.
+ *
+ * Open an SMC on ttyName() and it is answered as the real controller would
+ * answer the compact protocol: baud rate detection, Exit Safe Start, Motor
+ * Forward/Reverse, Motor Brake, Stop Motor and Get Variable, each with a
+ * CRC-7 byte when CRC is enabled.  The motor stays stopped in safe start
+ * until Exit Safe Start, and while a serial error is active; a corrupted or
+ * malformed command sets the serial error bits, as the SMC does, and the next
+ * good command clears them.
+ *
+ * A pty moves bytes instantly, so the emulator paces them itself: bytes are
+ * taken from the pty one byte time (10 bits at the baud rate) apart, and
+ * acted on when their last bit would have arrived.  The writer therefore sees
+ * its bytes queue up as on a real UART.  Replies start EMULATOR_RESPONSE_US
+ * after the request and leave one byte time apart.
+ *
+ * motorSpeed() gives the speed the motor is being driven at, eg: for
+ * Model::pendulumSim::setCommand().  Acceleration limits are not modelled.
+ **/
+class smcEmulator : public BlackLib::BlackThread {
+
+public:
+	/**
+	 * Opens the pseudo terminal.  Throws std::runtime_error if it can't.
+	 * @param baudRate baud rate to pace bytes at
+	 * @param useCRC expect a CRC-7 byte after every command
+	 **/
+	smcEmulator(int baudRate = SMC_DEFAULT_BAUD, bool useCRC = false);
+
+	~smcEmulator();
+
+	/**
+	 * Path of the slave side, open this with SMC
+	 **/
+	std::string ttyName();
+
+	/**
+	 * Speed the motor is driven at, 0 when stopped by an error.  Lock free.
+	 **/
+	int motorSpeed();
+
+	/**
+	 * Last target speed received, whether or not the motor is running
+	 **/
+	int targetSpeed();
+
+	/**
+	 * Error status, SAFE_START_VIOLATION to ERR_LINE_HIGH
+	 **/
+	int errorStatus();
+
+	/**
+	 * Values reported for VAR_INPUT_VOLTAGE, VAR_TEMPERATURE and VAR_CURRENT.
+	 * Safe from any thread.
+	 * @param millivolts supply voltage in mV
+	 **/
+	void setInputVoltage(int millivolts);
+	void setTemperature(int tenthsC);
+	void setCurrent(int milliamps);
+
+	/**
+	 * Answer VAR_CURRENT, as firmware that measures current does.  When off a
+	 * request for it is a format error and gets no reply.  Call before run().
+	 **/
+	void setReportsCurrent(bool reports);
+
+	/**
+	 * Time from the last byte of a request to the first byte of the reply.
+	 * Call before run().
+	 **/
+	void setResponseDelay(int us);
+
+	/**
+	 * Thread's start handler function.
+	 **/
+	void onStartHandler();
+
+	/**
+	 * Stops the thread running
+	 **/
+	void stop();
+
+	emulatorStats getStats();
+
+private:
+	struct timedByte {
+		uint64_t due;			// CLOCK_MONOTONIC time the last bit is on the wire
+		unsigned char value;
+	};
+
+	void receive(unsigned char value, uint64_t now);
+	void execute(uint64_t now);
+	void reply(int value, uint64_t now);
+	void serialError(unsigned int error);
+	int variable(unsigned char id, bool& answered);
+
+	int master;					// pty master
+	int slave;					// held open so the master doesn't hang up between users
+	int baud;
+	bool crc;
+	uint64_t byteNs;			// one start, eight data and one stop bit
+	uint64_t responseNs;
+	bool reportsCurrent;
+
+	// Owned by the emulator thread
+	std::deque<timedByte> rx;	// read from the pty, not yet arrived
+	std::deque<timedByte> tx;	// replies not yet sent
+	uint64_t rxFree;			// receive wire is busy until this time
+	uint64_t txFree;			// transmit wire is busy until this time
+	bool detected;				// baud rate detection byte seen
+	unsigned char frame[8];		// command being received
+	int length;
+	int expected;				// bytes still to come, 0 between commands
+	unsigned int serialErrors;	// since last read
+	unsigned int errorsOccurred;	// since last read
+
+	std::atomic<int> target;
+	std::atomic<int> errors;
+	std::atomic<int> vin;
+	std::atomic<int> temperature;
+	std::atomic<int> current;
+	std::atomic<bool> bExit;
+
+	std::atomic<uint32_t> nBytes;
+	std::atomic<uint32_t> nCommands;
+	std::atomic<uint32_t> nSpeeds;
+	std::atomic<uint32_t> nRequests;
+	std::atomic<uint32_t> nCRC;
+	std::atomic<uint32_t> nFormat;
+};
+
+} /* Pololu */
+
+#endif /* INCLUDE_POLOLU_SMCEMULATOR_H_ */
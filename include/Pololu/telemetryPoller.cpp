@@ -0,0 +1,226 @@
+/**
+ *! @file telemetryPoller.cpp
+ *! Pipelined SMC telemetry poller
+ *!
+ *! @author Troy Dack
+ *! @date Copyright (C) 2015
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ **/
+
+#include <Pololu/telemetryPoller.h>
+#include <algorithm>
+
+namespace Pololu {
+
+	telemetryPoller::telemetryPoller(int periodMs, int _depth, bool pollCurrent, int replyTimeoutMs)
+		: count(0)
+		, depth(std::max(1, std::min(_depth, TELEMETRY_MAX_VARS)))
+		, period((uint64_t)periodMs * 1000000)
+		, timeout((uint64_t)replyTimeoutMs * 1000000)
+		, active(false)
+		, pipelined(false)
+		, timedOut(false)
+		, next(0)
+		, head(0)
+		, outstanding(0)
+		, haveLow(false)
+		, low(0)
+		, roundStart(0)
+		, nextRound(0)
+		, deadline(0)
+		, quietUntil(0)
+		, working()
+		, nRounds(0)
+		, nRequests(0)
+		, nReplies(0)
+		, nTimeouts(0)
+		, nMissing(0)
+		, nStrays(0)
+		, dropped(0)
+	{
+		// Error status first, it's the one worth having if the round is cut short
+		ids[count] = VAR_ERROR_STATUS;  bits[count++] = TELEMETRY_ERROR_STATUS;
+		ids[count] = VAR_TARGET_SPEED;  bits[count++] = TELEMETRY_TARGET_SPEED;
+		if (pollCurrent) {
+			ids[count] = VAR_CURRENT;   bits[count++] = TELEMETRY_CURRENT;
+		}
+		ids[count] = VAR_TEMPERATURE;   bits[count++] = TELEMETRY_TEMPERATURE;
+		ids[count] = VAR_INPUT_VOLTAGE; bits[count++] = TELEMETRY_INPUT_VOLTAGE;
+		for (int i = 0; i < count; i++) {
+			misses[i] = 0;
+			enabled[i] = true;
+		}
+	}
+
+	bool telemetryPoller::nextRequest(uint64_t now, unsigned char& variableId) {
+		if (now < quietUntil) {
+			return false;
+		}
+		if (!active) {
+			if (now < nextRound) {
+				return false;
+			}
+			active = true;
+			timedOut = false;
+			next = 0;
+			roundStart = now;
+			// Keep to the period, but don't try to catch up on missed rounds
+			nextRound = std::max(nextRound + period, now);
+			working.valid = 0;
+			skipDisabled();
+			if (next >= count) {
+				finishRound(now);
+				return false;
+			}
+		}
+		if (next >= count || outstanding >= (pipelined ? depth : 1)) {
+			return false;
+		}
+		if (outstanding == 0) {
+			deadline = now + timeout;
+		}
+		queue[(head + outstanding) % TELEMETRY_MAX_VARS] = next;
+		outstanding++;
+		variableId = ids[next++];
+		skipDisabled();
+		nRequests.fetch_add(1, std::memory_order_relaxed);
+		return true;
+	}
+
+	void telemetryPoller::received(const unsigned char *bytes, int len, uint64_t now) {
+		for (int b = 0; b < len; b++) {
+			if (outstanding == 0) {
+				nStrays.fetch_add(1, std::memory_order_relaxed);
+				continue;
+			}
+			if (!haveLow) {
+				low = bytes[b];
+				haveLow = true;
+				continue;
+			}
+			haveLow = false;
+			uint16_t value = low | (bytes[b] << 8);
+			int i = queue[head];
+			head = (head + 1) % TELEMETRY_MAX_VARS;
+			outstanding--;
+			// The next reply is already on its way, give it a full timeout from now
+			deadline = now + timeout;
+			misses[i] = 0;
+
+			switch (bits[i]) {
+			case TELEMETRY_ERROR_STATUS:	working.errorStatus = value; break;
+			case TELEMETRY_TARGET_SPEED:	working.targetSpeed = (int16_t)value; break;
+			case TELEMETRY_CURRENT:			working.current = value; break;
+			case TELEMETRY_TEMPERATURE:		working.temperature = value; break;
+			case TELEMETRY_INPUT_VOLTAGE:	working.vin = value; break;
+			}
+			working.valid |= bits[i];
+			nReplies.fetch_add(1, std::memory_order_relaxed);
+
+			if (active && next >= count && outstanding == 0) {
+				finishRound(now);
+			}
+		}
+	}
+
+	/* checkTimeout() *************************************************************
+	 * With more than one request outstanding there's no telling which one
+	 * went unanswered, and replies already decoded this round may belong to
+	 * the request after the one they were matched to.  So the round is thrown
+	 * away and started again one request at a time, where a missing reply
+	 * can be pinned on its variable.
+	 ******************************************************************************/
+	void telemetryPoller::checkTimeout(uint64_t now) {
+		if (outstanding == 0 || now <= deadline) {
+			return;
+		}
+		nTimeouts.fetch_add(1, std::memory_order_relaxed);
+		int oldest = queue[head];
+		outstanding = 0;
+		head = 0;
+		haveLow = false;
+		quietUntil = now + timeout;
+		timedOut = true;
+
+		if (pipelined) {
+			pipelined = false;
+			working.valid = 0;
+			next = 0;
+		} else {
+			nMissing.fetch_add(1, std::memory_order_relaxed);
+			if (++misses[oldest] >= TELEMETRY_MAX_MISSES) {
+				enabled[oldest] = false;
+				dropped.fetch_or(bits[oldest], std::memory_order_relaxed);
+			}
+			next = oldest + 1;
+		}
+		skipDisabled();
+		if (next >= count) {
+			finishRound(now);
+		}
+	}
+
+	void telemetryPoller::skipDisabled() {
+		while (next < count && !enabled[next]) {
+			next++;
+		}
+	}
+
+	void telemetryPoller::finishRound(uint64_t now) {
+		active = false;
+		if (!timedOut) {
+			pipelined = true;
+		}
+		working.round = nRounds.load(std::memory_order_relaxed) + 1;
+		working.roundTime = (uint32_t)((now - roundStart) / 1000);
+		working.timestamp = now;
+		published.publish(working);
+		nRounds.store(working.round, std::memory_order_relaxed);
+	}
+
+	bool telemetryPoller::waiting() {
+		return outstanding > 0;
+	}
+
+	uint64_t telemetryPoller::timeToNext(uint64_t now) {
+		uint64_t due;
+		if (outstanding > 0) {
+			due = deadline;
+		} else if (active) {
+			due = quietUntil;
+		} else {
+			due = std::max(nextRound, quietUntil);
+		}
+		return (due > now) ? due - now : 0;
+	}
+
+	uint32_t telemetryPoller::read(smcTelemetry& values) {
+		return published.read(values);
+	}
+
+	telemetryStats telemetryPoller::getStats() {
+		telemetryStats s;
+		s.rounds = nRounds.load(std::memory_order_relaxed);
+		s.requests = nRequests.load(std::memory_order_relaxed);
+		s.replies = nReplies.load(std::memory_order_relaxed);
+		s.timeouts = nTimeouts.load(std::memory_order_relaxed);
+		s.missing = nMissing.load(std::memory_order_relaxed);
+		s.strays = nStrays.load(std::memory_order_relaxed);
+		s.dropped = dropped.load(std::memory_order_relaxed);
+		return s;
+	}
+} /* Pololu */
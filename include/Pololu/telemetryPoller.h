@@ -0,0 +1,193 @@
+/**
+ *! @file telemetryPoller.h
+ *! Pipelined SMC telemetry poller
+ *!
+ *! @author Troy Dack
+ *! @date Copyright (C) 2015
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ **/
+
+#ifndef INCLUDE_POLOLU_TELEMETRYPOLLER_H_
+#define INCLUDE_POLOLU_TELEMETRYPOLLER_H_
+
+#include <Pololu/pololuSMC.h>
+#include <seqlock.h>
+#include <atomic>
+#include <cstdint>
+
+namespace Pololu {
+
+const int TELEMETRY_PERIOD_MS = 100;	/**< Default time between polling rounds */
+const int TELEMETRY_DEPTH = 3;			/**< Default number of requests in flight at once */
+const int TELEMETRY_MAX_VARS = 5;		/**< Variables polled each round */
+const int TELEMETRY_MAX_MISSES = 3;		/**< Unanswered requests in a row before a variable is no longer polled */
+
+/**
+ * Bits of smcTelemetry::valid, set for each value answered in that round
+ **/
+const uint16_t TELEMETRY_ERROR_STATUS	= (1 << 0);
+const uint16_t TELEMETRY_TARGET_SPEED	= (1 << 1);
+const uint16_t TELEMETRY_CURRENT		= (1 << 2);
+const uint16_t TELEMETRY_TEMPERATURE	= (1 << 3);
+const uint16_t TELEMETRY_INPUT_VOLTAGE	= (1 << 4);
+
+/**
+ * One round of SMC variables
+ **/
+struct smcTelemetry {
+	uint16_t errorStatus;	/**< Errors stopping the motor, SAFE_START_VIOLATION to ERR_LINE_HIGH */
+	int16_t targetSpeed;	/**< Speed the SMC is driving towards (-3200 to 3200) */
+	uint16_t current;		/**< Motor current in mA */
+	uint16_t temperature;	/**< Board temperature in 0.1 degrees C */
+	uint16_t vin;			/**< Supply voltage in mV */
+	uint16_t valid;			/**< TELEMETRY_ bits of the values answered, others are from an earlier round */
+	uint32_t round;			/**< Rounds completed, including this one */
+	uint32_t roundTime;		/**< First request to last reply in microseconds */
+	uint64_t timestamp;		/**< CLOCK_MONOTONIC time of the last reply in nanoseconds */
+};
+
+/**
+ * Telemetry poller counters
+ **/
+struct telemetryStats {
+	uint32_t rounds;	/**< Rounds published */
+	uint32_t requests;	/**< Get Variable requests sent */
+	uint32_t replies;	/**< Replies decoded */
+	uint32_t timeouts;	/**< Times a reply didn't arrive in time */
+	uint32_t missing;	/**< Variables given up on in a round */
+	uint32_t strays;	/**< Bytes received with no request outstanding, discarded */
+	uint16_t dropped;	/**< TELEMETRY_ bits of variables no longer polled */
+};
+
+/**
+ * Polls SMC variables over the same UART as the speed commands.
+ *
+ * This class does no I/O itself; whoever owns the serial port, normally a
+ * commandChannel, asks it what to request and hands it what was received.
+ * Up to depth requests are in flight at once, so a round of five variables
+ * costs about one reply time rather than five.  Replies carry no ID, they
+ * are matched to requests in order.
+ *
+ * Because replies are matched by order, one unanswered request would shift
+ * every later reply onto the wrong variable.  So requests are only pipelined
+ * once a round has been answered in full one at a time.  If a reply doesn't
+ * arrive within the timeout the outstanding requests are forgotten, bytes
+ * received during a quiet period afterwards are discarded as late replies
+ * and the round starts again one request at a time.  A variable that isn't
+ * answered on its own is skipped for the round, and after
+ * TELEMETRY_MAX_MISSES rounds in a row is no longer polled, eg: current on
+ * firmware that doesn't measure it.
+ *
+ * Each finished round is published through a seqlock, so any thread can
+ * read() the latest values without locking.
+ **/
+class telemetryPoller {
+
+public:
+	/**
+	 * @param periodMs time between the start of each round
+	 * @param depth requests in flight at once, 1 to TELEMETRY_MAX_VARS
+	 * @param pollCurrent request motor current, only on firmware that measures it
+	 * @param replyTimeoutMs longest to wait for each reply
+	 **/
+	telemetryPoller(int periodMs = TELEMETRY_PERIOD_MS, int depth = TELEMETRY_DEPTH,
+					bool pollCurrent = true, int replyTimeoutMs = SMC_READ_TIMEOUT_MS);
+
+	/**
+	 * Variable to request next, if one is due.
+	 * @param now CLOCK_MONOTONIC time in nanoseconds
+	 * @param variableId receives the variable to request
+	 * @return true if variableId should be requested now
+	 **/
+	bool nextRequest(uint64_t now, unsigned char& variableId);
+
+	/**
+	 * Decode received bytes
+	 * @param bytes bytes read from the SMC
+	 * @param len number of bytes
+	 * @param now CLOCK_MONOTONIC time in nanoseconds
+	 **/
+	void received(const unsigned char *bytes, int len, uint64_t now);
+
+	/**
+	 * Give up on a reply that is overdue
+	 * @param now CLOCK_MONOTONIC time in nanoseconds
+	 **/
+	void checkTimeout(uint64_t now);
+
+	/**
+	 * True while replies are outstanding, the owner should read often
+	 **/
+	bool waiting();
+
+	/**
+	 * Nanoseconds until nextRequest() or checkTimeout() has something to do
+	 * @param now CLOCK_MONOTONIC time in nanoseconds
+	 **/
+	uint64_t timeToNext(uint64_t now);
+
+	/**
+	 * Latest round.  Lock free, safe from any thread.
+	 * @param values receives the values
+	 * @return number of rounds published
+	 **/
+	uint32_t read(smcTelemetry& values);
+
+	telemetryStats getStats();
+
+private:
+	void finishRound(uint64_t now);
+	void skipDisabled();
+
+	unsigned char ids[TELEMETRY_MAX_VARS];	// variables polled, in order
+	uint16_t bits[TELEMETRY_MAX_VARS];		// TELEMETRY_ bit of each
+	int misses[TELEMETRY_MAX_VARS];			// unanswered requests in a row, one at a time
+	bool enabled[TELEMETRY_MAX_VARS];
+	int count;
+	int depth;
+	uint64_t period;
+	uint64_t timeout;
+
+	// Owned by the thread doing the I/O
+	bool active;				// a round has started and not finished
+	bool pipelined;				// every variable has answered one at a time
+	bool timedOut;				// a reply was missed this round
+	int next;					// index of the next variable to request
+	int queue[TELEMETRY_MAX_VARS];	// indices of requests awaiting replies, oldest first
+	int head;
+	int outstanding;
+	bool haveLow;				// first byte of a reply has arrived
+	unsigned char low;
+	uint64_t roundStart;
+	uint64_t nextRound;
+	uint64_t deadline;			// oldest outstanding reply is overdue after this
+	uint64_t quietUntil;		// bytes before this are late replies
+	smcTelemetry working;
+
+	seqlock<smcTelemetry> published;
+	std::atomic<uint32_t> nRounds;
+	std::atomic<uint32_t> nRequests;
+	std::atomic<uint32_t> nReplies;
+	std::atomic<uint32_t> nTimeouts;
+	std::atomic<uint32_t> nMissing;
+	std::atomic<uint32_t> nStrays;
+	std::atomic<uint16_t> dropped;
+};
+
+} /* Pololu */
+
+#endif /* INCLUDE_POLOLU_TELEMETRYPOLLER_H_ */
@@ -23,6 +23,8 @@
 #include <sys/mman.h>
 #include <errno.h>
 #include <stdexcept>
+#include <stdlib.h>
+#include <sys/stat.h>
 
 #include "bbb-eqep.h"
 #include "debug.h"
@@ -46,16 +48,30 @@ eQEP_address_(eQEP_address)
     }
   }
   active = false;
-  eQEPFd = open("/dev/mem", O_RDWR | O_SYNC);
-  if (eQEPFd < 0)
+  std::string backend = memoryBackend();
+  emulated = (backend != EQEP_MEM_DEVMEM);
+  eQEPFd = -1;
+  if (backend == EQEP_MEM_DEVMEM) {
+    eQEPFd = open(EQEP_MEM_DEVMEM, O_RDWR | O_SYNC);
+  } else if (backend != EQEP_MEM_ANON) {
+    // Simulator file, create it if the simulator hasn't yet
+    eQEPFd = open(backend.c_str(), O_RDWR | O_CREAT, 0666);
+    struct stat st;
+    if (eQEPFd >= 0 && fstat(eQEPFd, &st) == 0 && st.st_size < memoryFileLength()) {
+      if (ftruncate(eQEPFd, memoryFileLength()) != 0) {
+        close(eQEPFd);
+        eQEPFd = -1;
+      }
+    }
+  }
+  if (eQEPFd < 0 && backend != EQEP_MEM_ANON)
   {
-	throw std::runtime_error("Unable to open eQEP" + std::to_string((int)eqep_addr) );
+    throw std::runtime_error("Unable to open eQEP memory " + backend);
   }
   
   // Map the PWM memory range
-  map_pwm_register();
+  map_pwm_register(backend);
   eqep_addr = pwm_addr + (eQEP_address_ & (getpagesize()-1));
-  position_p = (uint32_t *) (eqep_addr + EQEP_QPOSCNT);
   
   debug(2, "eQEP successfully activated\n");
   defaultSettings();
@@ -66,7 +82,39 @@ eQEP::~eQEP()
 {
   active = false;
   munmap(pwm_addr, PWM_BLOCK_LENGTH);
-  close(eQEPFd);
+  if (eQEPFd >= 0) {
+    close(eQEPFd);
+  }
+}
+
+std::string eQEP::memoryBackend() {
+  const char *backend = getenv(EQEP_MEM_ENV);
+  if (backend == NULL || backend[0] == '\0') {
+    return EQEP_MEM_DEVMEM;
+  }
+  return backend;
+}
+
+off_t eQEP::memoryOffset(const std::string& backend, int eQEP_address) {
+  int address = eQEP_address;
+  if (address < 3) {
+    const int addresses[] = { eQEP0, eQEP1, eQEP2 };
+    address = addresses[address];
+  }
+  off_t page = address & ~(getpagesize()-1);
+  if (backend == EQEP_MEM_DEVMEM) {
+    return page;
+  }
+  // Simulator files start at the eQEP0 PWMSS page
+  return page - (eQEP0 & ~(getpagesize()-1));
+}
+
+off_t eQEP::memoryFileLength() {
+  return memoryOffset("", eQEP2) + getpagesize();
+}
+
+bool eQEP::isEmulated() {
+  return emulated;
 }
 
 void eQEP::initPWM() {
@@ -100,20 +148,28 @@ void eQEP::defaultSettings() {
   setMaxPos(-1);
 }
 
-void eQEP::map_pwm_register()
+void eQEP::map_pwm_register(const std::string& backend)
 {
-  int masked_address = eQEP_address_ & ~(getpagesize()-1);
-  pwm_addr = (uint8_t*)mmap(NULL, PWM_BLOCK_LENGTH,
-    PROT_READ | PROT_WRITE, MAP_SHARED, eQEPFd, masked_address);
+  off_t masked_address = memoryOffset(backend, eQEP_address_);
+  if (backend == EQEP_MEM_ANON) {
+    pwm_addr = (uint8_t*)mmap(NULL, PWM_BLOCK_LENGTH,
+      PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  } else {
+    pwm_addr = (uint8_t*)mmap(NULL, PWM_BLOCK_LENGTH,
+      PROT_READ | PROT_WRITE, MAP_SHARED, eQEPFd, masked_address);
+  }
   if (pwm_addr == MAP_FAILED )
   {
-    debug(0, "Memory Mapping failed for 0x%04x register\n", masked_address);
+    debug(0, "Memory Mapping failed for 0x%04x register\n", (int)masked_address);
     debug(0, "ERROR: (errno %d %s)\n", errno, strerror(errno));
-    return;
+    if (eQEPFd >= 0) {
+      close(eQEPFd);
+    }
+    throw std::runtime_error("Unable to map eQEP registers from " + backend);
   }
   debug(1,
     "eQEP::eQEP() eQEP at address 0x%08x mapped\n",
-    masked_address);
+    (int)masked_address);
 }
 
 eQEP::operator uint32_t() {
@@ -121,29 +177,6 @@ eQEP::operator uint32_t() {
 }
 
 
-void eQEP::setHelper(int offset, uint32_t value) {
-  *(uint32_t*)(eqep_addr + offset) = value;
-}
-void eQEP::setHelper(int offset, uint16_t value) {
-  *(uint16_t*)(eqep_addr + offset) = value;
-}
-uint32_t eQEP::getHelper32(int offset) {
-  return *(uint32_t*)(eqep_addr + offset);
-}
-uint16_t eQEP::getHelper16(int offset) {
-  return *(uint16_t*)(eqep_addr + offset);
-}
-
-uint32_t eQEP::getPosition()
-{
-  return *position_p;
-}
-
-void eQEP::setPosition(uint32_t position)
-{
-  *position_p = position;
-}
-
 uint32_t eQEP::getPosInit()
 {
   return getHelper32(EQEP_QPOSINIT);
@@ -207,13 +240,6 @@ uint32_t eQEP::getStrobePositionLatch() {
 }
 
 // eQEP Position Counter Latch Register
-/**
- * The position-counter value is latched into this register on unit time out
- * event.
-**/
-uint32_t eQEP::getPositionCounterLatch() {
-  return getHelper32(EQEP_QPOSLAT);
-}
 
 // eQEP Unit Timer Register
 /**
@@ -313,11 +339,7 @@ void eQEP::setDecoderControl(uint16_t value) {
  * 3: DOWN count mode for frequency measurement
 **/
 void eQEP::positionCounterSourceSelection(int source) {
-  setDecoderControl(
-    // Ensure both bits are off
-    (getDecoderControl() & ~(EQEP_QDECCTL_QSRC(3)))
-      // Then set whichever need to be on again
-      | (source << 14));
+  reg::QDECCTL_::QSRC::set(eqep_addr, source);
 }
 /**
  * Disable position-compare sync output.
@@ -341,11 +363,8 @@ void eQEP::disableSyncOutput() {
  * /param pin Defines the pins to sync output. Index or Strobe.
 **/
 void eQEP::enableSyncOutput(SOPin pin) {
-  setDecoderControl(
-    // Ensure the pin is off
-    (getDecoderControl() & ~EQEP_QDECCTL_SOEN)
-      // Then turn it back on again
-      | ((uint16_t)pin << 12));
+  reg::QDECCTL_::SPSEL::set(eqep_addr, pin);
+  reg::QDECCTL_::SOEN::set(eqep_addr, 1);
 }
 /**
  * External clock rate. Default (2x).
@@ -441,11 +460,7 @@ void eQEP::setControl(uint16_t value) {
  * Set the Emulation Control bits.
 **/
 void eQEP::setEmulationControl(ECB mode) {
-  setControl(
-    // Ensure both bits are off
-    (getControl() & ~(EQEP_QEPCTL_ECB(3)))
-      // Then set whichever need to be on again
-      | EQEP_QEPCTL_ECB((uint16_t)mode));
+  reg::QEPCTL_::ECB::set(eqep_addr, mode);
 }
 /**
  * Position Counter Reset Mode enum.
@@ -462,11 +477,7 @@ void eQEP::setEmulationControl(ECB mode) {
  * Sets the condition for reseting the position counter.
 **/
 void eQEP::setPositionCounterResetMode(PCRM mode) {
-  setControl(
-    // Ensure both bits are off
-    (getControl() & ~(EQEP_QEPCTL_PCRM(3)))
-      // Then set whichever need to be on again
-      | EQEP_QEPCTL_PCRM((uint16_t)mode));
+  reg::QEPCTL_::PCRM::set(eqep_addr, mode);
 }
 /**
  * Strobe event initialization enum.
@@ -494,11 +505,7 @@ void eQEP::setPositionCounterResetMode(PCRM mode) {
  * Sets when a strobe event should initialize the position counter
 **/
 void eQEP::setStrobeEventInit(SEI mode) {
-  setControl(
-    // Ensure both bits are off
-    (getControl() & ~(EQEP_QEPCTL_SEI(3)))
-      // Then set whichever need to be on again
-      | EQEP_QEPCTL_SEI((uint16_t)mode));
+  reg::QEPCTL_::SEI::set(eqep_addr, mode);
 }
 /**
  * Index Event Initialization of position counter enum
@@ -523,11 +530,7 @@ void eQEP::setStrobeEventInit(SEI mode) {
  * Sets when an index event should initialize the position counter
 **/
 void eQEP::setIndexEventInit(IEI mode) {
-  setControl(
-    // Ensure both bits are off
-    (getControl() & ~(EQEP_QEPCTL_IEI(3)))
-      // Then set whichever need to be on again
-      | EQEP_QEPCTL_IEI((uint16_t)mode));
+  reg::QEPCTL_::IEI::set(eqep_addr, mode);
 }
 /**
  * Software initialization of position counter. Call this function to reset
@@ -561,11 +564,7 @@ void eQEP::resetPositionCounter() {
  * Set which strobe event should latch the position counter
 **/
 void eQEP::setStrobeEventPositionLatch(SEL mode) {
-  setControl(
-    // Ensure the bit is off
-    (getControl() & ~(EQEP_QEPCTL_SEL))
-      // Then set whichever need to be on again
-      | ((uint16_t)mode << 6));
+  reg::QEPCTL_::SEL::set(eqep_addr, mode);
 }
 /**
  * Strobe event latch of position counter
@@ -591,11 +590,7 @@ void eQEP::setStrobeEventPositionLatch(SEL mode) {
  * Set which index event should latch the position counter
 **/
 void eQEP::setIndexEventPositionLatch(IEL mode) {
-  setControl(
-    // Ensure both bits are off
-    (getControl() & ~(EQEP_QEPCTL_IEL(3)))
-      // Then set whichever need to be on again
-      | EQEP_QEPCTL_IEL((uint16_t)mode));  
+  reg::QEPCTL_::IEL::set(eqep_addr, mode);
 }
 /**
  * Quadrature position counter enable/software reset
@@ -638,25 +633,19 @@ void eQEP::enableeQEP() {
  * eQEP capture latch mode
 **/
 void eQEP::setCaptureLatchMode(CLM mode) {
-  setControl(
-    // Ensure the bits is
-    (getControl() & ~(EQEP_QEPCTL_QCLM))
-      // Then set on again
-      | ((uint16_t)mode << 2));
+  reg::QEPCTL_::QCLM::set(eqep_addr, mode);
 }
 /**
  * Enables the unit timer
 **/
 void eQEP::enableUnitTimer() {
-  setControl(
-    getControl() | EQEP_QEPCTL_UTE);
+  reg::QEPCTL_::UTE::set(eqep_addr, 1);
 }
 /**
  * Disables the unit timer
 **/
 void eQEP::disableUnitTimer() {
-  setControl(
-    getControl() & ~EQEP_QEPCTL_UTE);
+  reg::QEPCTL_::UTE::set(eqep_addr, 0);
 }
 /**
  * Enables the watchdog timer
@@ -713,9 +702,7 @@ void eQEP::enableCaptureUnit() {
  * must be disabled before changing the prescaler. @see disableCaptureUnit()
 **/
 void eQEP::setCaptureTimeClockPrescaler(int value) {
-  setCaptureControl(
-    (getCaptureControl() & ~EQEP_QCAPCTL_CCPS(7))
-      | EQEP_QCAPCTL_CCPS(value));
+  reg::QCAPCTL_::CCPS::set(eqep_addr, value);
 }
 /**
  * Unit position event prescaler.
@@ -728,9 +715,7 @@ void eQEP::setCaptureTimeClockPrescaler(int value) {
  * must be disabled before changing the prescaler. @see disableCaptureUnit()
 **/
 void eQEP::setPositionEventPrescaler(int value) {
-  setCaptureControl(
-    (getCaptureControl() & ~EQEP_QCAPCTL_UPPS(0xF))
-      | EQEP_QCAPCTL_UPPS(value));
+  reg::QCAPCTL_::UPPS::set(eqep_addr, value);
 }
 
 // eQEP Position-Compare Control Register
@@ -995,20 +980,6 @@ void eQEP::disablePositionCounterErrorInterrupt() {
 }
 
 // eQEP Interrupt Flag Register
-/**
- * Get the status of all of the interrupt flags.
-**/
-uint16_t eQEP::getInterruptFlag() {
-  return getHelper16(EQEP_QFLG);
-}
-/**
- * Unit Time Out Interrupt flag.
- *
- * \return Set by eQEP unit timer period match.
-**/
-bool eQEP::getUnitTimeoutInterruptFlag() {
-  return getInterruptFlag() & EQEP_INT_UTO;
-}
 /**
  * Index Event Latch Interrupt flag.
  *
@@ -1106,26 +1077,12 @@ bool eQEP::getGlobalInterruptStatusFlag() {
 uint16_t eQEP::getInterruptClear() {
   return getHelper16(EQEP_QCLR);
 }
-/**
- * Clear triggered interrupts
- *
- * \param Set bits indicating the interrupts to clear
-**/
-void eQEP::setInterruptClear(uint16_t value) {
-  setHelper(EQEP_QCLR, value);
-}
 /**
  * Clear all of the interrupts
 **/
 void eQEP::clearInterrupts() {
   setInterruptClear(EQEP_INT_ENABLE_ALL);
 }
-/**
- * Clear the Unit Time Out Interrupt flag.
-**/
-void eQEP::clearUnitTimeoutInterruptFlag() {
-  setInterruptClear(EQEP_INT_UTO);
-}
 /**
  * Clear the Index Event Latch Interrupt
 **/
@@ -1275,18 +1232,6 @@ void eQEP::forcePositionCounterErrorInterruptFlag() {
 }
 
 // eQEP Status Register
-/**
- * Get the status of the eQEP functions.
-**/
-uint16_t eQEP::getStatus() {
-  return getHelper16(EQEP_QEPSTS);
-}
-/**
- * Set the status of the eQEP functions. Only some bits may be set.
-**/
-void eQEP::setStatus(uint16_t value) {
-  setHelper(EQEP_QEPSTS, value);
-}
 /**
  * Unit position event flag
  *
@@ -1430,17 +1375,6 @@ void eQEP::setCapturePeriod(uint16_t value) {
   setHelper(EQEP_QCPRD, value);
 }
 // eQEP Capture Timer Latch Register
-/**
- * The eQEP capture timer value can be latched into this register on two
- * events viz., unit timeout event, reading the eQEP position counter.
- *
- * @see setCaptureLatchMode()
- * @see setCaptureTimeClockPrescaler()
- * @see enableCaptureUnit()
-**/
-uint16_t eQEP::getCaptureTimerLatch() {
-  return getHelper16(EQEP_QCTMRLAT);
-}
 // eQEP Capture Period Latch Register
 /**
  * eQEP capture period value can be latched into this register on two events
@@ -1450,17 +1384,6 @@ uint16_t eQEP::getCaptureTimerLatch() {
  * @see setCaptureTimeClockPrescaler()
  * @see enableCaptureUnit()
 **/
-uint16_t eQEP::getCapturePeriodLatch() {
-  return getHelper16(EQEP_QCPRDLAT);
-}
-/**
- * eQEP capture period value can be latched into this register on two events
- * viz., unit timeout event, reading the eQEP position counter.
- *
- * @see setCaptureLatchMode()
- * @see setCaptureTimeClockPrescaler()
- * @see enableCaptureUnit()
-**/
 void eQEP::setCapturePeriodLatch(uint16_t value) {
   setHelper(EQEP_QCPRDLAT, value);
 }
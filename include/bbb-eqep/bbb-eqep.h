@@ -28,6 +28,8 @@
 #include <unistd.h>
 #include <fcntl.h>
 #include <inttypes.h>
+#include <string>
+#include "eqep-regs.h"
 
 namespace BBB
 {
@@ -124,6 +126,16 @@ namespace BBB
 #define eQEP_BLOCK_LENGTH  0x7F  ///< Total memory length set aside for eQEP
 #define PWM_BLOCK_LENGTH   0x25F ///< Length of the whole PWM subsystem
 
+/**
+ * Environment variable that selects the memory backing the eQEP registers.
+ * Unset or EQEP_MEM_DEVMEM maps the real registers.  EQEP_MEM_ANON gives each
+ * eQEP its own anonymous memory.  Any other value is a file, eg: in /dev/shm,
+ * holding the PWMSS pages of all three eQEPs that a simulator can write into.
+**/
+#define EQEP_MEM_ENV    "BBB_EQEP_MEM"
+#define EQEP_MEM_DEVMEM "/dev/mem" ///< Real hardware registers
+#define EQEP_MEM_ANON   "anon"     ///< Anonymous memory, private to the process
+
 /** Beaglebone Black eQEP control and access class
   * This class allows for easy setup of all of the TI Sitara's eQEP registers.
   * Also, all of the registers can be easy accessed through this class.
@@ -140,12 +152,13 @@ private:
   
   uint8_t *pwm_addr; /**< Pointer to the parent PWM memory section */
   uint8_t *eqep_addr; /**< Pointer to the EQEP memory section */
-  volatile uint32_t *position_p; /**< Direct register access pointer */
+  bool emulated; /**< Registers are plain memory, write-1-to-clear is done in
+                      software */
   
   /**
    * Maps the pwm register.
   **/
-  void map_pwm_register();
+  void map_pwm_register(const std::string& backend);
   /**
    * Intializes the PWM subsystem
   **/
@@ -153,19 +166,27 @@ private:
   /**
    * Writes the 32 bit value to the register at offset.
   **/
-  void setHelper(int offset, uint32_t value);
+  void setHelper(int offset, uint32_t value) {
+    *(volatile uint32_t*)(eqep_addr + offset) = value;
+  }
   /**
    * Writes the 16 bit value to the register at offset.
   **/
-  void setHelper(int offset, uint16_t value);
+  void setHelper(int offset, uint16_t value) {
+    *(volatile uint16_t*)(eqep_addr + offset) = value;
+  }
   /**
    * Gets the 32 bit value in the register at offset.
   **/
-  uint32_t getHelper32(int offset);
+  uint32_t getHelper32(int offset) {
+    return *(volatile uint32_t*)(eqep_addr + offset);
+  }
   /**
    * Gets the 16 bit value in the register at offset.
   **/
-  uint16_t getHelper16(int offset);
+  uint16_t getHelper16(int offset) {
+    return *(volatile uint16_t*)(eqep_addr + offset);
+  }
 	
 public:
   /**
@@ -184,6 +205,28 @@ public:
    * Destructor
   **/
   ~eQEP();
+
+  /**
+   * Memory backend selected by the BBB_EQEP_MEM environment variable.
+   *
+   * @see EQEP_MEM_ENV
+  **/
+  static std::string memoryBackend();
+  /**
+   * Offset of the PWMSS page holding an eQEP within a backend.  The physical
+   * address for /dev/mem, or the page number within a simulator file.
+   *
+   * /param eQEP_address eQEP number (0-2) or starting address
+  **/
+  static off_t memoryOffset(const std::string& backend, int eQEP_address);
+  /**
+   * Length of a simulator file holding all three eQEPs.
+  **/
+  static off_t memoryFileLength();
+  /**
+   * True if the registers are plain memory rather than hardware.
+  **/
+  bool isEmulated();
   
   /**
    * Returns the mmaped pointer to the PWM subsystem.
@@ -1223,6 +1266,61 @@ public:
   uint32_t getRevisionID();  
 };
 
+// Registers read on every sample are defined here so they inline to a single
+// load from the mapped registers
+inline uint32_t eQEP::getPosition() {
+  return reg::QPOSCNT::read(eqep_addr);
+}
+
+inline void eQEP::setPosition(uint32_t position) {
+  reg::QPOSCNT::write(eqep_addr, position);
+}
+
+inline uint32_t eQEP::getPositionCounterLatch() {
+  return reg::QPOSLAT::read(eqep_addr);
+}
+
+inline uint16_t eQEP::getInterruptFlag() {
+  return reg::QFLG::read(eqep_addr);
+}
+
+inline bool eQEP::getUnitTimeoutInterruptFlag() {
+  return reg::Interrupt<reg::QFLG>::UTO::isSet(eqep_addr);
+}
+
+inline void eQEP::setInterruptClear(uint16_t value) {
+  reg::QCLR::write(eqep_addr, value);
+  if (emulated) {
+    reg::QFLG::write(eqep_addr, reg::QFLG::read(eqep_addr) & ~value);
+  }
+}
+
+inline void eQEP::clearUnitTimeoutInterruptFlag() {
+  // QCLR is write-1-to-clear, don't read-modify-write it
+  setInterruptClear(reg::Interrupt<reg::QCLR>::UTO::mask);
+}
+
+inline uint16_t eQEP::getStatus() {
+  return reg::QEPSTS::read(eqep_addr);
+}
+
+inline void eQEP::setStatus(uint16_t value) {
+  if (emulated) {
+    // Only the sticky flags are writable, and writing 1 clears them
+    value &= EQEP_QEPSTS_UPEVNT | EQEP_QEPSTS_COEF | EQEP_QEPSTS_CDEF | EQEP_QEPSTS_FIMF;
+    value = reg::QEPSTS::read(eqep_addr) & ~value;
+  }
+  reg::QEPSTS::write(eqep_addr, value);
+}
+
+inline uint16_t eQEP::getCaptureTimerLatch() {
+  return reg::QCTMRLAT::read(eqep_addr);
+}
+
+inline uint16_t eQEP::getCapturePeriodLatch() {
+  return reg::QCPRDLAT::read(eqep_addr);
+}
+
 } /* BBB */
 
 #endif /* end of include guard: BBB_EQEP_H */
@@ -0,0 +1,180 @@
+/**
+ * This library provides fast access to the Beaglebone Black's onboard eQEP modules.
+ * Copyright (C) 2014 James Zapico <james.zapico@gmail.com>
+ * 
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+/*! \file eqep-regs.h
+ * \brief Beaglebone Black eQEP register map.
+ * Describes each eQEP register (offset and width) and its bitfields as types,
+ * so accesses compile to a single volatile load or store at a constant offset
+ * from the mapped eQEP base.
+**/
+
+#ifndef BBB_EQEP_REGS_H
+#define BBB_EQEP_REGS_H
+
+#include <stdint.h>
+
+namespace BBB
+{
+namespace reg
+{
+
+/**
+ * A memory mapped register of type T at Offset bytes from the eQEP base.
+**/
+template <unsigned Offset, typename T>
+struct Register {
+  typedef T type;
+  static const unsigned offset = Offset;
+
+  static inline T read(uint8_t* base) {
+    return *reinterpret_cast<volatile T*>(base + Offset);
+  }
+  static inline void write(uint8_t* base, T value) {
+    *reinterpret_cast<volatile T*>(base + Offset) = value;
+  }
+};
+
+/**
+ * Width bits starting at bit Shift of register Reg.
+ *
+ * set() is a read-modify-write of the whole register, so it must not be used
+ * on registers with write-1-to-clear bits (QEPSTS, QCLR).  Write mask to
+ * those registers directly instead.
+**/
+template <typename Reg, unsigned Shift, unsigned Width>
+struct Field {
+  typedef typename Reg::type type;
+  static const type mask = (type)(((1u << Width) - 1) << Shift);
+
+  /**
+   * The field value v shifted into place, for building whole register values.
+  **/
+  static inline type value(unsigned v) {
+    return (type)((v << Shift) & mask);
+  }
+  static inline unsigned get(uint8_t* base) {
+    return (Reg::read(base) & mask) >> Shift;
+  }
+  static inline bool isSet(uint8_t* base) {
+    return (Reg::read(base) & mask) != 0;
+  }
+  static inline void set(uint8_t* base, unsigned v) {
+    Reg::write(base, (type)((Reg::read(base) & ~mask) | value(v)));
+  }
+};
+
+typedef Register<0x00, uint32_t> QPOSCNT;  ///< Position Counter
+typedef Register<0x04, uint32_t> QPOSINIT; ///< Position Counter Initialization
+typedef Register<0x08, uint32_t> QPOSMAX;  ///< Maximum Position Count
+typedef Register<0x0c, uint32_t> QPOSCMP;  ///< Position-Compare
+typedef Register<0x10, uint32_t> QPOSILAT; ///< Index Position Latch
+typedef Register<0x14, uint32_t> QPOSSLAT; ///< Strobe Position Latch
+typedef Register<0x18, uint32_t> QPOSLAT;  ///< Position Counter Latch
+typedef Register<0x1c, uint32_t> QUTMR;    ///< Unit Timer
+typedef Register<0x20, uint32_t> QUPRD;    ///< Unit Period
+typedef Register<0x24, uint16_t> QWDTMR;   ///< Watchdog Timer
+typedef Register<0x26, uint16_t> QWDPRD;   ///< Watchdog Period
+typedef Register<0x28, uint16_t> QDECCTL;  ///< Decoder Control
+typedef Register<0x2a, uint16_t> QEPCTL;   ///< Control
+typedef Register<0x2c, uint16_t> QCAPCTL;  ///< Capture Control
+typedef Register<0x2e, uint16_t> QPOSCTL;  ///< Position-Compare Control
+typedef Register<0x30, uint16_t> QEINT;    ///< Interrupt Enable
+typedef Register<0x32, uint16_t> QFLG;     ///< Interrupt Flag
+typedef Register<0x34, uint16_t> QCLR;     ///< Interrupt Clear
+typedef Register<0x36, uint16_t> QFRC;     ///< Interrupt Force
+typedef Register<0x38, uint16_t> QEPSTS;   ///< Status
+typedef Register<0x3a, uint16_t> QCTMR;    ///< Capture Timer
+typedef Register<0x3c, uint16_t> QCPRD;    ///< Capture Period
+typedef Register<0x3e, uint16_t> QCTMRLAT; ///< Capture Timer Latch
+typedef Register<0x40, uint16_t> QCPRDLAT; ///< Capture Period Latch
+typedef Register<0x5c, uint32_t> REVID;    ///< Revision ID
+
+namespace QDECCTL_ {
+typedef Field<QDECCTL, 14, 2> QSRC;  ///< Position counter source selection
+typedef Field<QDECCTL, 13, 1> SOEN;  ///< Sync output enable
+typedef Field<QDECCTL, 12, 1> SPSEL; ///< Sync output pin selection
+typedef Field<QDECCTL, 11, 1> XCR;   ///< External clock rate
+typedef Field<QDECCTL, 10, 1> SWAP;  ///< Swap quadrature clock inputs
+typedef Field<QDECCTL, 9, 1>  IGATE; ///< Index pulse gating option
+typedef Field<QDECCTL, 8, 1>  QAP;   ///< QEPA input polarity
+typedef Field<QDECCTL, 7, 1>  QBP;   ///< QEPB input polarity
+typedef Field<QDECCTL, 6, 1>  QIP;   ///< QEPI input polarity
+typedef Field<QDECCTL, 5, 1>  QSP;   ///< QEPS input polarity
+}
+
+namespace QEPCTL_ {
+typedef Field<QEPCTL, 14, 2> ECB;  ///< Emulation control
+typedef Field<QEPCTL, 12, 2> PCRM; ///< Position counter reset mode
+typedef Field<QEPCTL, 10, 2> SEI;  ///< Strobe event initialization of position counter
+typedef Field<QEPCTL, 8, 2>  IEI;  ///< Index event initialization of position counter
+typedef Field<QEPCTL, 7, 1>  SWI;  ///< Software initialization of position counter
+typedef Field<QEPCTL, 6, 1>  SEL;  ///< Strobe event latch of position counter
+typedef Field<QEPCTL, 4, 2>  IEL;  ///< Index event latch of position counter
+typedef Field<QEPCTL, 3, 1>  PHEN; ///< Quadrature position counter enable/software reset
+typedef Field<QEPCTL, 2, 1>  QCLM; ///< Capture latch mode
+typedef Field<QEPCTL, 1, 1>  UTE;  ///< Unit timer enable
+typedef Field<QEPCTL, 0, 1>  WDE;  ///< Watchdog enable
+}
+
+namespace QCAPCTL_ {
+typedef Field<QCAPCTL, 15, 1> CEN;  ///< Capture enable
+typedef Field<QCAPCTL, 4, 3>  CCPS; ///< Capture timer clock prescaler
+typedef Field<QCAPCTL, 0, 4>  UPPS; ///< Unit position event prescaler
+}
+
+namespace QPOSCTL_ {
+typedef Field<QPOSCTL, 15, 1> PCSHDW; ///< Position compare shadow enable
+typedef Field<QPOSCTL, 14, 1> PCLOAD; ///< Position compare shadow load mode
+typedef Field<QPOSCTL, 13, 1> PCPOL;  ///< Polarity of sync output
+typedef Field<QPOSCTL, 12, 1> PCE;    ///< Position compare enable
+typedef Field<QPOSCTL, 0, 12> PCSPW;  ///< Sync output pulse width
+}
+
+/**
+ * Bit layout shared by QEINT, QFLG, QCLR and QFRC.
+**/
+template <typename Reg>
+struct Interrupt {
+  typedef Field<Reg, 11, 1> UTO; ///< Unit time out
+  typedef Field<Reg, 10, 1> IEL; ///< Index event latch
+  typedef Field<Reg, 9, 1>  SEL; ///< Strobe event latch
+  typedef Field<Reg, 8, 1>  PCM; ///< Position compare match
+  typedef Field<Reg, 7, 1>  PCR; ///< Position compare ready
+  typedef Field<Reg, 6, 1>  PCO; ///< Position counter overflow
+  typedef Field<Reg, 5, 1>  PCU; ///< Position counter underflow
+  typedef Field<Reg, 4, 1>  WTO; ///< Watchdog time out
+  typedef Field<Reg, 3, 1>  QDC; ///< Quadrature direction change
+  typedef Field<Reg, 2, 1>  PHE; ///< Quadrature phase error
+  typedef Field<Reg, 1, 1>  PCE; ///< Position counter error
+  typedef Field<Reg, 0, 1>  INT; ///< Global interrupt status
+};
+
+namespace QEPSTS_ {
+typedef Field<QEPSTS, 7, 1> UPEVNT; ///< Unit position event flag
+typedef Field<QEPSTS, 6, 1> FDF;    ///< Direction on the first index marker
+typedef Field<QEPSTS, 5, 1> QDF;    ///< Quadrature direction flag
+typedef Field<QEPSTS, 4, 1> QDLF;   ///< Direction latch flag
+typedef Field<QEPSTS, 3, 1> COEF;   ///< Capture overflow error flag
+typedef Field<QEPSTS, 2, 1> CDEF;   ///< Capture direction error flag
+typedef Field<QEPSTS, 1, 1> FIMF;   ///< First index marker flag
+typedef Field<QEPSTS, 0, 1> PCEF;   ///< Position counter error flag
+}
+
+} /* reg */
+} /* BBB */
+
+#endif /* BBB_EQEP_REGS_H */
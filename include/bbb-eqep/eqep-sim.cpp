@@ -0,0 +1,175 @@
+/**
+ * This library provides fast access to the Beaglebone Black's onboard eQEP modules.
+ * Copyright (C) 2014 James Zapico <james.zapico@gmail.com>
+ * 
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <stdexcept>
+
+#include "eqep-sim.h"
+
+#define EQEP_SIM_SYSCLK 100e6 ///< SYSCLKOUT that the unit and capture timers count
+
+namespace BBB
+{
+eQEPSim::eQEPSim(int eQEP_address):
+eQEPFd(-1), pwm_addr(NULL), captureTicks(0), eventCounts(0), unitTicks(0),
+direction(0)
+{
+  std::string backend = eQEP::memoryBackend();
+  if (backend == EQEP_MEM_DEVMEM || backend == EQEP_MEM_ANON) {
+    throw std::runtime_error("eQEPSim needs " EQEP_MEM_ENV " set to a simulator file");
+  }
+  eQEPFd = open(backend.c_str(), O_RDWR | O_CREAT, 0666);
+  struct stat st;
+  if (eQEPFd < 0 || fstat(eQEPFd, &st) != 0
+      || (st.st_size < eQEP::memoryFileLength()
+          && ftruncate(eQEPFd, eQEP::memoryFileLength()) != 0)) {
+    if (eQEPFd >= 0) {
+      close(eQEPFd);
+    }
+    throw std::runtime_error("Unable to open simulator file " + backend);
+  }
+  off_t offset = eQEP::memoryOffset(backend, eQEP_address);
+  pwm_addr = (uint8_t*)mmap(NULL, PWM_BLOCK_LENGTH,
+    PROT_READ | PROT_WRITE, MAP_SHARED, eQEPFd, offset);
+  if (pwm_addr == MAP_FAILED) {
+    close(eQEPFd);
+    throw std::runtime_error("Unable to map simulator file " + backend);
+  }
+  int address = (eQEP_address < 3) ? eQEP0 + 0x2000 * eQEP_address : eQEP_address;
+  eqep_addr = pwm_addr + (address & (getpagesize()-1));
+}
+
+eQEPSim::eQEPSim(eQEP& target):
+eQEPFd(-1), pwm_addr(NULL), eqep_addr(target.getEQEPPointer()), captureTicks(0),
+eventCounts(0), unitTicks(0), direction(0)
+{
+  if (!target.isEmulated()) {
+    throw std::runtime_error("eQEPSim can't drive hardware registers");
+  }
+}
+
+eQEPSim::~eQEPSim()
+{
+  if (pwm_addr != NULL) {
+    munmap(pwm_addr, PWM_BLOCK_LENGTH);
+  }
+  if (eQEPFd >= 0) {
+    close(eQEPFd);
+  }
+}
+
+void eQEPSim::setCount(uint32_t count) {
+  reg::QPOSCNT::write(eqep_addr, count);
+}
+
+uint32_t eQEPSim::getCount() {
+  return reg::QPOSCNT::read(eqep_addr);
+}
+
+/**
+ * Copy the position counter and capture registers into their latches, as
+ * the hardware does on a unit timeout (QCLM = 1) or QPOSCNT read (QCLM = 0).
+**/
+void eQEPSim::latch() {
+  if (reg::QEPCTL_::QCLM::get(eqep_addr)) {
+    reg::QPOSLAT::write(eqep_addr, reg::QPOSCNT::read(eqep_addr));
+  }
+  reg::QCTMRLAT::write(eqep_addr, reg::QCTMR::read(eqep_addr));
+  reg::QCPRDLAT::write(eqep_addr, reg::QCPRD::read(eqep_addr));
+}
+
+void eQEPSim::step(int32_t delta, double dt) {
+  uint16_t status = reg::QEPSTS::read(eqep_addr);
+
+  // Software initialisation of the position counter, the bit clears itself
+  if (reg::QEPCTL_::SWI::isSet(eqep_addr)) {
+    reg::QPOSCNT::write(eqep_addr, reg::QPOSINIT::read(eqep_addr));
+    reg::QEPCTL_::SWI::set(eqep_addr, 0);
+  }
+
+  // Position counter, rolls over at QPOSMAX in both directions
+  uint64_t modulus = (uint64_t)reg::QPOSMAX::read(eqep_addr) + 1;
+  int64_t count = ((int64_t)reg::QPOSCNT::read(eqep_addr) + delta) % (int64_t)modulus;
+  if (count < 0) {
+    count += modulus;
+  }
+  reg::QPOSCNT::write(eqep_addr, (uint32_t)count);
+
+  if (delta != 0) {
+    int dir = (delta > 0) ? 1 : -1;
+    if (direction != 0 && dir != direction && eventCounts > 0) {
+      status |= EQEP_QEPSTS_CDEF; // direction changed between unit position events
+    }
+    direction = dir;
+    status = (dir > 0) ? (status | EQEP_QEPSTS_QDF) : (status & ~EQEP_QEPSTS_QDF);
+  }
+
+  // Capture unit, measures capture timer ticks between unit position events
+  if (reg::QCAPCTL_::CEN::isSet(eqep_addr)) {
+    double captureHz = EQEP_SIM_SYSCLK / (1 << reg::QCAPCTL_::CCPS::get(eqep_addr));
+    double countsPerEvent = 1 << reg::QCAPCTL_::UPPS::get(eqep_addr);
+    captureTicks += dt * captureHz;
+    eventCounts += abs(delta);
+    if (eventCounts >= countsPerEvent && delta != 0) {
+      double ticksPerEvent = countsPerEvent / (abs(delta) / dt) * captureHz;
+      if (ticksPerEvent > 0xFFFF) {
+        status |= EQEP_QEPSTS_COEF;
+        ticksPerEvent = 0xFFFF;
+      }
+      reg::QCPRD::write(eqep_addr, (uint16_t)ticksPerEvent);
+      eventCounts = fmod(eventCounts, countsPerEvent);
+      captureTicks = eventCounts / countsPerEvent * ticksPerEvent;
+      status |= EQEP_QEPSTS_UPEVNT;
+    }
+    if (captureTicks > 0xFFFF) {
+      status |= EQEP_QEPSTS_COEF;
+      captureTicks = 0xFFFF;
+    }
+    reg::QCTMR::write(eqep_addr, (uint16_t)captureTicks);
+  }
+  reg::QEPSTS::write(eqep_addr, status);
+
+  // Reads of QPOSCNT can't be trapped, so keep the CPU read latches current
+  if (!reg::QEPCTL_::QCLM::get(eqep_addr)) {
+    latch();
+  }
+
+  // Unit timer, latches and sets UTO each time it reaches QUPRD
+  if (reg::QEPCTL_::UTE::isSet(eqep_addr)) {
+    uint32_t period = reg::QUPRD::read(eqep_addr);
+    if ((uint32_t)unitTicks != reg::QUTMR::read(eqep_addr)) {
+      unitTicks = reg::QUTMR::read(eqep_addr); // eQEP reset the timer
+    }
+    unitTicks += dt * EQEP_SIM_SYSCLK;
+    if (period > 0 && unitTicks >= period) {
+      unitTicks = fmod(unitTicks, period);
+      latch();
+      reg::QFLG::write(eqep_addr, reg::QFLG::read(eqep_addr)
+        | reg::Interrupt<reg::QFLG>::UTO::mask | reg::Interrupt<reg::QFLG>::INT::mask);
+    }
+    reg::QUTMR::write(eqep_addr, (uint32_t)unitTicks);
+  }
+}
+
+} /* BBB */
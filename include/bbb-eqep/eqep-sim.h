@@ -0,0 +1,91 @@
+/**
+ * This library provides fast access to the Beaglebone Black's onboard eQEP modules.
+ * Copyright (C) 2014 James Zapico <james.zapico@gmail.com>
+ * 
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+/*! \file eqep-sim.h
+ * \brief Simulated eQEP register writer.
+ * Drives the registers of an eQEP that is backed by memory instead of
+ * hardware, so the eQEP class can be used off target.
+**/
+
+#ifndef BBB_EQEP_SIM_H
+#define BBB_EQEP_SIM_H
+
+#include "bbb-eqep.h"
+
+namespace BBB
+{
+
+/** Simulated eQEP hardware
+  * Writes quadrature counts into the registers an eQEP instance reads, and
+  * emulates the parts of the eQEP the encoder code relies on: position
+  * counter rollover at QPOSMAX, the direction flag, the capture unit (period
+  * between unit position events, capture timer and their overflow/direction
+  * error flags), CPU read and unit timeout latching, and the unit timer.
+  *
+  * The registers must be backed by memory, see EQEP_MEM_ENV.
+**/
+class eQEPSim
+{
+private:
+  int eQEPFd; /**< File descriptor of the simulator file, -1 if not owned */
+  uint8_t *pwm_addr; /**< Mapped PWMSS page, NULL if not owned */
+  uint8_t *eqep_addr; /**< Pointer to the eQEP registers */
+  double captureTicks; /**< Capture timer ticks since the last unit position event */
+  double eventCounts; /**< Counts moved since the last unit position event */
+  double unitTicks; /**< Unit timer, kept as a double so short steps add up */
+  int direction; /**< Direction of the last movement, 1, -1 or 0 */
+
+  void latch();
+
+public:
+  /**
+   * Attach to the registers eQEP(eQEP_address) maps from the simulator file
+   * named by BBB_EQEP_MEM.  The file is created if it doesn't exist.
+   *
+   * /param eQEP_address eQEP number (0-2) or starting address
+  **/
+  eQEPSim(int eQEP_address);
+  /**
+   * Drive the registers of an eQEP in the same process, eg: one using the
+   * anonymous backend.
+  **/
+  eQEPSim(eQEP& target);
+  /**
+   * Destructor
+  **/
+  ~eQEPSim();
+
+  /**
+   * Set the position counter, as if the encoder had jumped there
+  **/
+  void setCount(uint32_t count);
+  /**
+   * Current position counter
+  **/
+  uint32_t getCount();
+  /**
+   * Move the encoder and advance the eQEP timers.
+   *
+   * /param delta counts moved, positive in the QDF forward direction
+   * /param dt time taken in seconds
+  **/
+  void step(int32_t delta, double dt);
+};
+
+} /* BBB */
+
+#endif /* BBB_EQEP_SIM_H */
@@ -0,0 +1,117 @@
+/**
+ *! @file controlPipeline.h
+ *! Single thread sense -> compute -> actuate control pipeline
+ *!
+ *! @author Troy Dack
+ *! @date Copyright (C) 2015
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ **/
+
+#ifndef INCLUDE_CONTROLPIPELINE_H_
+#define INCLUDE_CONTROLPIPELINE_H_
+
+#include <periodicScheduler.h>
+#include <multiEQEP.h>
+#include <Pololu/pololuSMC.h>
+#include <pendulumState.h>
+#include <atomic>
+
+/*!
+ * @brief Values passed between the encoders, controller and motor
+ */
+struct controlSignals {
+	pendulumStateBuffer state;		/*!< Pendulum state read by the controller */
+	std::atomic<double> motorSpeed;	/*!< Controller output */
+	double setAngle;				/*!< Controller set point */
+	std::atomic<double> cutoffAngle;	/*!< Pendulum angle in degrees beyond which the motor is stopped, 0 for none */
+
+	controlSignals();
+};
+
+const int MOTOR_DEADBAND = 350;	/*!< @brief Motor doesn't move unless |speed| > MOTOR_DEADBAND */
+const double MOTOR_CUTOFF_ANGLE = 30;	/*!< @brief Default pendulum angle in degrees beyond which the motor is stopped */
+
+/*!
+ * @brief Convert controller output to a motor speed command
+ *  Adds the deadband offset the motor needs before it will move, clamps to
+ *  the SMC range and stops the motor if the pendulum is too far from vertical.
+ *
+ * @param[in] motorSpeed controller output
+ * @param[in] pendulumAngleDeg pendulum angle in degrees
+ * @param[in] cutoffDeg stop the motor if |pendulumAngleDeg| is larger than this, 0 for no limit
+ * @return speed to send to the SMC
+ */
+int motorCommand(double motorSpeed, double pendulumAngleDeg, double cutoffDeg = MOTOR_CUTOFF_ANGLE);
+
+/*!
+ * @brief Runs encoder read, controller and motor command in order, once per tick
+ *
+ * Every tick sees encoder values read in that same tick and the motor is
+ * commanded before the tick ends, so end to end latency is bounded by one
+ * period.  The encoders are not run by the scheduler; the pipeline samples
+ * them directly.
+ */
+class controlPipeline : public periodicTask {
+
+public:
+	/*!
+	 * @param[in] eqeps encoders, with their state bound to signals->state
+	 * @param[in] ctrl controller bound to signals
+	 * @param[in] smc motor controller
+	 * @param[in,out] signals values the controller reads from and writes to
+	 */
+	controlPipeline(multiEQEP* eqeps, periodicTask* ctrl, Pololu::SMC* smc, controlSignals* signals);
+
+	/*!
+	 * @brief Sense, compute and actuate for one sample period
+	 *
+	 * @param[in] info timing information for this tick
+	 */
+	void tick(const tickInfo& info);
+
+	/*!
+	 * @brief Encoder read to serial write latency in nanoseconds for the last tick
+	 */
+	int64_t getLastLatency();
+
+	/*!
+	 * @brief Encoder read to serial write latency statistics
+	 *  overruns counts ticks whose latency was longer than the period
+	 */
+	latenessStats getLatencyStats();
+
+	/*!
+	 * @brief Last speed sent to the motor
+	 */
+	int getSetSpeed();
+
+private:
+	multiEQEP *encoders;
+	periodicTask *controller;
+	Pololu::SMC *SMC;
+	controlSignals *io;
+
+	std::atomic<int> setSpeed;
+	std::atomic<uint64_t> ticks;
+	std::atomic<uint64_t> overruns;
+	std::atomic<int64_t> last;
+	std::atomic<int64_t> min;
+	std::atomic<int64_t> max;
+	std::atomic<int64_t> total;
+};
+
+#endif /* INCLUDE_CONTROLPIPELINE_H_ */
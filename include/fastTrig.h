@@ -0,0 +1,90 @@
+/**
+ *! @file fastTrig.h
+ *! Fast sine and cosine approximations for the control loop
+ *!
+ *! @author Troy Dack
+ *! @date Copyright (C) 2015
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ **/
+
+#ifndef INCLUDE_FASTTRIG_H_
+#define INCLUDE_FASTTRIG_H_
+
+#include <cmath>
+
+/*!
+ * @brief Wrap an angle into [-pi, pi)
+ *
+ * @param[in] angle angle in radians
+ * @return the same angle in [-pi, pi)
+ */
+inline double wrapAngle(double angle) {
+	const double twoPi = 2 * M_PI;
+	if (angle >= -M_PI && angle < M_PI) {
+		return angle;	// the usual case, no division
+	}
+	return angle - twoPi * std::floor((angle + M_PI) / twoPi);
+}
+
+/*!
+ * @brief wrapAngle() for the difference of two angles less than a turn apart
+ *  Needs no floor or division, so it also works for the fixed point types.
+ *
+ * @param[in] angle angle in radians, in [-3 pi, 3 pi)
+ * @return the same angle in [-pi, pi)
+ */
+template <typename T>
+inline T wrapDifference(T angle) {
+	const T pi(M_PI);
+	const T twoPi(2 * M_PI);
+	if (angle >= pi) {
+		return angle - twoPi;
+	} else if (angle < -pi) {
+		return angle + twoPi;
+	}
+	return angle;
+}
+
+/*!
+ * @brief Sine without a libm call
+ *
+ * A parabola through sin's zeros and peaks, corrected by a second parabola
+ * of its own error.  Absolute error is at most 0.0011, which is well inside the
+ * encoder resolution, and it costs a handful of multiplies with no branches
+ * once the angle is in [-pi, pi).
+ *
+ * @param[in] angle angle in radians
+ */
+inline double fastSin(double angle) {
+	const double b = 4 / M_PI;
+	const double c = -4 / (M_PI * M_PI);
+	const double p = 0.225;
+	double x = wrapAngle(angle);
+	double y = b * x + c * x * std::abs(x);
+	return p * (y * std::abs(y) - y) + y;
+}
+
+/*!
+ * @brief Cosine without a libm call, see fastSin()
+ *
+ * @param[in] angle angle in radians
+ */
+inline double fastCos(double angle) {
+	return fastSin(angle + M_PI / 2);
+}
+
+#endif /* INCLUDE_FASTTRIG_H_ */
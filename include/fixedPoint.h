@@ -0,0 +1,180 @@
+/**
+ *! @file fixedPoint.h
+ *! Saturating Q format fixed point numbers
+ *!
+ *! @author Troy Dack
+ *! @date Copyright (C) 2015
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ **/
+
+#ifndef INCLUDE_FIXEDPOINT_H_
+#define INCLUDE_FIXEDPOINT_H_
+
+#include <cstdint>
+#include <ostream>
+
+/*!
+ * @brief Signed Q(31-FracBits).FracBits fixed point number in 32 bits
+ *
+ * Addition, subtraction, negation and multiplication saturate at the largest
+ * and smallest representable values instead of wrapping, so an out of range
+ * intermediate gives a clamped output rather than a sign flip.  Products are
+ * formed in 64 bits and rounded to nearest.  Every operation is a fixed,
+ * short sequence of integer instructions, so its cost does not depend on
+ * the values, unlike the VFP on the Cortex-A8.
+ *
+ * Each conversion from double and each product rounds by at most half an
+ * lsb, 2^-(FracBits+1).  There is deliberately no division; divide when the
+ * constants are computed, in double.
+ */
+template <int FracBits>
+class fixed {
+	static_assert(FracBits > 0 && FracBits < 31, "fixed needs 1 to 30 fractional bits");
+
+public:
+	static const int32_t ONE = (int32_t)1 << FracBits;	/*!< Raw value of 1.0 */
+
+	fixed() = default;
+
+	/*!
+	 * @brief Nearest fixed point value to v, saturated to the range
+	 */
+	explicit fixed(double v) : raw(fromDouble(v)) {}
+
+	/*!
+	 * @brief Value with the given raw representation
+	 */
+	static fixed fromRaw(int32_t r) {
+		fixed f;
+		f.raw = r;
+		return f;
+	}
+
+	/*!
+	 * @brief Largest representable value, just under 2^(31-FracBits)
+	 */
+	static fixed max() {
+		return fromRaw(INT32_MAX);
+	}
+
+	/*!
+	 * @brief Smallest representable value, -2^(31-FracBits)
+	 */
+	static fixed min() {
+		return fromRaw(INT32_MIN);
+	}
+
+	int32_t rawValue() const {
+		return raw;
+	}
+
+	double toDouble() const {
+		return raw * (1.0 / ONE);
+	}
+
+	fixed operator+(fixed b) const {
+		return fromRaw(saturate((int64_t)raw + b.raw));
+	}
+
+	fixed operator-(fixed b) const {
+		return fromRaw(saturate((int64_t)raw - b.raw));
+	}
+
+	fixed operator-() const {
+		return fromRaw(saturate(-(int64_t)raw));
+	}
+
+	fixed operator*(fixed b) const {
+		int64_t p = (int64_t)raw * b.raw + ((int64_t)1 << (FracBits - 1));
+		return fromRaw(saturate(p >> FracBits));
+	}
+
+	fixed& operator+=(fixed b) {
+		return *this = *this + b;
+	}
+
+	fixed& operator-=(fixed b) {
+		return *this = *this - b;
+	}
+
+	fixed& operator*=(fixed b) {
+		return *this = *this * b;
+	}
+
+	bool operator<(fixed b) const {
+		return raw < b.raw;
+	}
+
+	bool operator>(fixed b) const {
+		return raw > b.raw;
+	}
+
+	bool operator<=(fixed b) const {
+		return raw <= b.raw;
+	}
+
+	bool operator>=(fixed b) const {
+		return raw >= b.raw;
+	}
+
+	bool operator==(fixed b) const {
+		return raw == b.raw;
+	}
+
+	bool operator!=(fixed b) const {
+		return raw != b.raw;
+	}
+
+private:
+	// Compiles to compares and conditional moves, no branches
+	static int32_t saturate(int64_t v) {
+		v = v > INT32_MAX ? INT32_MAX : v;
+		v = v < INT32_MIN ? INT32_MIN : v;
+		return (int32_t)v;
+	}
+
+	static int32_t fromDouble(double v) {
+		double scaled = v * ONE;
+		if (scaled >= INT32_MAX) {
+			return INT32_MAX;
+		} else if (scaled <= INT32_MIN) {
+			return INT32_MIN;
+		}
+		return (int32_t)(scaled + (scaled >= 0 ? 0.5 : -0.5));
+	}
+
+	int32_t raw;
+};
+
+/*!
+ * @brief Value of a control law number as a double, for either numeric type
+ */
+inline double toDouble(double v) {
+	return v;
+}
+
+template <int FracBits>
+inline double toDouble(fixed<FracBits> v) {
+	return v.toDouble();
+}
+
+template <int FracBits>
+std::ostream& operator<<(std::ostream& out, fixed<FracBits> v) {
+	return out << v.toDouble();
+}
+
+#endif /* INCLUDE_FIXEDPOINT_H_ */
@@ -0,0 +1,131 @@
+/**
+ *! @file latencyHistogram.h
+ *! Lock-free histogram of execution times for percentile reporting
+ *!
+ *! @author Troy Dack
+ *! @date Copyright (C) 2015
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ **/
+
+#ifndef INCLUDE_LATENCYHISTOGRAM_H_
+#define INCLUDE_LATENCYHISTOGRAM_H_
+
+#include <atomic>
+#include <cstdint>
+
+/*!
+ * @brief Histogram of durations in nanoseconds, for percentiles
+ *
+ * Buckets are spaced four per power of two, so any percentile is reported to
+ * within 19% with a fixed 1kB of counters and no allocation.  One thread
+ * records, any thread can read percentiles while it does.
+ */
+class latencyHistogram {
+
+public:
+	static const int SUB_BUCKETS = 4;					/*!< Buckets per power of two */
+	static const int BUCKETS = 64 * SUB_BUCKETS;
+
+	latencyHistogram() : count(0), maximum(0) {
+		for (int i = 0; i < BUCKETS; i++) {
+			buckets[i].store(0, std::memory_order_relaxed);
+		}
+	}
+
+	/*!
+	 * @brief Record a duration.  Only one thread may call this.
+	 *
+	 * @param[in] ns duration in nanoseconds
+	 */
+	void record(int64_t ns) {
+		if (ns < 0) {
+			ns = 0;
+		}
+		std::atomic<uint32_t>& b = buckets[bucket(ns)];
+		b.store(b.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+		if (ns > maximum.load(std::memory_order_relaxed)) {
+			maximum.store(ns, std::memory_order_relaxed);
+		}
+		count.store(count.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+	}
+
+	/*!
+	 * @brief Duration below which a fraction of the recorded durations fall
+	 *
+	 * @param[in] p fraction, eg: 0.99 for the 99th percentile
+	 * @return upper bound of the bucket holding the percentile in nanoseconds, 0 if empty
+	 */
+	int64_t percentile(double p) const {
+		uint64_t n = count.load(std::memory_order_acquire);
+		if (n == 0) {
+			return 0;
+		}
+		uint64_t target = (uint64_t)(p * n);
+		if (target >= n) {
+			target = n - 1;
+		}
+		uint64_t seen = 0;
+		for (int i = 0; i < BUCKETS; i++) {
+			seen += buckets[i].load(std::memory_order_relaxed);
+			if (seen > target) {
+				int64_t upper = upperBound(i);
+				int64_t max = maximum.load(std::memory_order_relaxed);
+				return upper < max ? upper : max;
+			}
+		}
+		return maximum.load(std::memory_order_relaxed);
+	}
+
+	/*!
+	 * @brief Number of durations recorded
+	 */
+	uint64_t samples() const {
+		return count.load(std::memory_order_acquire);
+	}
+
+	/*!
+	 * @brief Longest duration recorded in nanoseconds
+	 */
+	int64_t max() const {
+		return maximum.load(std::memory_order_relaxed);
+	}
+
+private:
+	static int bucket(int64_t ns) {
+		if (ns < SUB_BUCKETS) {
+			return (int)ns;
+		}
+		int e = 63 - __builtin_clzll((uint64_t)ns);	// ns is in [2^e, 2^(e+1))
+		int sub = (int)((ns >> (e - 2)) & (SUB_BUCKETS - 1));
+		return (e - 1) * SUB_BUCKETS + sub;
+	}
+
+	static int64_t upperBound(int i) {
+		if (i < SUB_BUCKETS) {
+			return i;
+		}
+		int e = i / SUB_BUCKETS + 1;
+		int sub = i % SUB_BUCKETS;
+		return ((int64_t)(SUB_BUCKETS + sub + 1) << (e - 2)) - 1;
+	}
+
+	std::atomic<uint32_t> buckets[BUCKETS];
+	std::atomic<uint64_t> count;
+	std::atomic<int64_t> maximum;
+};
+
+#endif /* INCLUDE_LATENCYHISTOGRAM_H_ */
@@ -0,0 +1,377 @@
+/**
+ *! @file matrix.h
+ *! Fixed size matrix and vector arithmetic for state space control
+ *!
+ *! @author Troy Dack
+ *! @date Copyright (C) 2015
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ **/
+
+#ifndef INCLUDE_MATRIX_H_
+#define INCLUDE_MATRIX_H_
+
+#include <cmath>
+#include <cstring>
+
+// Vector kernels, define MATRIX_SCALAR to build the plain C++ versions only
+#if !defined(MATRIX_SCALAR) && defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define MATRIX_NEON
+#elif !defined(MATRIX_SCALAR) && defined(__SSE2__)
+#include <emmintrin.h>
+#define MATRIX_SSE2
+#endif
+
+/*!
+ * @brief Row and vector kernels used by matrix
+ *
+ * Each works on N contiguous elements.  N is a compile time constant so the
+ * loops unroll completely for the small sizes used in the controllers.  The
+ * generic versions are plain C++; float has NEON and SSE2 versions when
+ * available.  double always uses the plain loops: ARMv7 NEON has no double
+ * lanes, and on x86 SSE2 pairs of doubles were no faster than the loops the
+ * compiler unrolls.
+ */
+namespace matrixKernel {
+
+template <int N, typename T>
+inline T dot(const T* a, const T* b) {
+	T sum = T(0);
+	for (int i = 0; i < N; i++) {
+		sum += a[i] * b[i];
+	}
+	return sum;
+}
+
+/*!
+ * @brief y += a * x
+ */
+template <int N, typename T>
+inline void axpy(T a, const T* x, T* y) {
+	for (int i = 0; i < N; i++) {
+		y[i] += a * x[i];
+	}
+}
+
+#if defined(MATRIX_NEON)
+template <int N>
+inline float dot(const float* a, const float* b) {
+	float32x4_t acc = vdupq_n_f32(0);
+	int i = 0;
+	for (; i + 4 <= N; i += 4) {
+		acc = vmlaq_f32(acc, vld1q_f32(a + i), vld1q_f32(b + i));
+	}
+	float32x2_t pair = vadd_f32(vget_low_f32(acc), vget_high_f32(acc));
+	float sum = vget_lane_f32(vpadd_f32(pair, pair), 0);
+	for (; i < N; i++) {
+		sum += a[i] * b[i];
+	}
+	return sum;
+}
+
+template <int N>
+inline void axpy(float a, const float* x, float* y) {
+	int i = 0;
+	for (; i + 4 <= N; i += 4) {
+		vst1q_f32(y + i, vmlaq_n_f32(vld1q_f32(y + i), vld1q_f32(x + i), a));
+	}
+	for (; i < N; i++) {
+		y[i] += a * x[i];
+	}
+}
+#endif
+
+#if defined(MATRIX_SSE2)
+template <int N>
+inline float dot(const float* a, const float* b) {
+	__m128 acc = _mm_setzero_ps();
+	int i = 0;
+	for (; i + 4 <= N; i += 4) {
+		acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+	}
+	acc = _mm_add_ps(acc, _mm_movehl_ps(acc, acc));
+	acc = _mm_add_ss(acc, _mm_shuffle_ps(acc, acc, 1));
+	float sum = _mm_cvtss_f32(acc);
+	for (; i < N; i++) {
+		sum += a[i] * b[i];
+	}
+	return sum;
+}
+
+template <int N>
+inline void axpy(float a, const float* x, float* y) {
+	__m128 va = _mm_set1_ps(a);
+	int i = 0;
+	for (; i + 4 <= N; i += 4) {
+		_mm_storeu_ps(y + i, _mm_add_ps(_mm_loadu_ps(y + i), _mm_mul_ps(va, _mm_loadu_ps(x + i))));
+	}
+	for (; i < N; i++) {
+		y[i] += a * x[i];
+	}
+}
+#endif
+
+} /* namespace matrixKernel */
+
+/*!
+ * @brief Dense R x C matrix with the size fixed at compile time
+ *
+ * Stored row major on the stack (or inline in the owning object) and 16 byte
+ * aligned for the vector kernels.  Nothing allocates, so matrices can be used
+ * freely on the control thread.  Column vectors are matrix<N, 1>, see vec.
+ */
+template <int R, int C, typename T = double>
+class matrix {
+
+public:
+	static const int ROWS = R;
+	static const int COLS = C;
+
+	/*!
+	 * @brief Uninitialised matrix, use zeros() or identity() for a known value
+	 *  Value initialisation, eg: matrix<2, 2>(), gives zeros.
+	 */
+	matrix() = default;
+
+	/*!
+	 * @brief Matrix from R * C values in row major order
+	 */
+	explicit matrix(const T* values) {
+		memcpy(data, values, sizeof(data));
+	}
+
+	static matrix zeros() {
+		matrix m;
+		for (int i = 0; i < R * C; i++) {
+			m.data[i] = T(0);
+		}
+		return m;
+	}
+
+	static matrix identity() {
+		matrix m = zeros();
+		for (int i = 0; i < R && i < C; i++) {
+			m(i, i) = T(1);
+		}
+		return m;
+	}
+
+	inline T& operator()(int r, int c) {
+		return data[r * C + c];
+	}
+
+	inline const T& operator()(int r, int c) const {
+		return data[r * C + c];
+	}
+
+	/*!
+	 * @brief Element i in row major order, for vectors this is element i
+	 */
+	inline T& operator[](int i) {
+		return data[i];
+	}
+
+	inline const T& operator[](int i) const {
+		return data[i];
+	}
+
+	inline T* row(int r) {
+		return data + r * C;
+	}
+
+	inline const T* row(int r) const {
+		return data + r * C;
+	}
+
+	matrix& operator+=(const matrix& b) {
+		for (int i = 0; i < R * C; i++) {
+			data[i] += b.data[i];
+		}
+		return *this;
+	}
+
+	matrix& operator-=(const matrix& b) {
+		for (int i = 0; i < R * C; i++) {
+			data[i] -= b.data[i];
+		}
+		return *this;
+	}
+
+	matrix& operator*=(T s) {
+		for (int i = 0; i < R * C; i++) {
+			data[i] *= s;
+		}
+		return *this;
+	}
+
+	matrix operator+(const matrix& b) const {
+		matrix m = *this;
+		return m += b;
+	}
+
+	matrix operator-(const matrix& b) const {
+		matrix m = *this;
+		return m -= b;
+	}
+
+	matrix operator-() const {
+		matrix m = *this;
+		return m *= T(-1);
+	}
+
+	matrix operator*(T s) const {
+		matrix m = *this;
+		return m *= s;
+	}
+
+	/*!
+	 * @brief Matrix product, each output row is a sum of scaled rows of b
+	 */
+	template <int K>
+	matrix<R, K, T> operator*(const matrix<C, K, T>& b) const {
+		matrix<R, K, T> m;
+		if (K == 1) {
+			// Matrix times vector, one dot product per row
+			for (int r = 0; r < R; r++) {
+				m[r] = matrixKernel::dot<C>(row(r), &b[0]);
+			}
+		} else {
+			m = matrix<R, K, T>::zeros();
+			for (int r = 0; r < R; r++) {
+				for (int c = 0; c < C; c++) {
+					matrixKernel::axpy<K>((*this)(r, c), b.row(c), m.row(r));
+				}
+			}
+		}
+		return m;
+	}
+
+	/*!
+	 * @brief Copy with every element converted to another number type
+	 *  eg: a matrix designed in double for a law that steps in fixed point
+	 */
+	template <typename U>
+	matrix<R, C, U> as() const {
+		matrix<R, C, U> m;
+		for (int i = 0; i < R * C; i++) {
+			m[i] = U(data[i]);
+		}
+		return m;
+	}
+
+	matrix<C, R, T> transpose() const {
+		matrix<C, R, T> m;
+		for (int r = 0; r < R; r++) {
+			for (int c = 0; c < C; c++) {
+				m(c, r) = (*this)(r, c);
+			}
+		}
+		return m;
+	}
+
+	/*!
+	 * @brief Sum of the products of the elements, the dot product for vectors
+	 */
+	T dot(const matrix& b) const {
+		return matrixKernel::dot<R * C>(data, b.data);
+	}
+
+	/*!
+	 * @brief Largest absolute element
+	 */
+	T maxAbs() const {
+		T m = T(0);
+		for (int i = 0; i < R * C; i++) {
+			if (std::abs(data[i]) > m) {
+				m = std::abs(data[i]);
+			}
+		}
+		return m;
+	}
+
+private:
+	T data[R * C] __attribute__((aligned(16)));
+};
+
+template <int N, typename T = double>
+using vec = matrix<N, 1, T>;	/*!< @brief Column vector */
+
+template <int R, int C, typename T>
+inline matrix<R, C, T> operator*(T s, const matrix<R, C, T>& m) {
+	return m * s;
+}
+
+/*!
+ * @brief Solve A x = b by Gaussian elimination with partial pivoting
+ *
+ * @param[in] A square matrix
+ * @param[in] b right hand side, one column per system
+ * @param[out] x solution
+ * @return False if A is singular
+ */
+template <int N, int K, typename T>
+bool solve(matrix<N, N, T> A, matrix<N, K, T> b, matrix<N, K, T>& x) {
+	for (int c = 0; c < N; c++) {
+		int pivot = c;
+		for (int r = c + 1; r < N; r++) {
+			if (std::abs(A(r, c)) > std::abs(A(pivot, c))) {
+				pivot = r;
+			}
+		}
+		if (A(pivot, c) == 0) {
+			return false;
+		}
+		if (pivot != c) {
+			for (int i = 0; i < N; i++) {
+				T t = A(c, i); A(c, i) = A(pivot, i); A(pivot, i) = t;
+			}
+			for (int i = 0; i < K; i++) {
+				T t = b(c, i); b(c, i) = b(pivot, i); b(pivot, i) = t;
+			}
+		}
+		for (int r = c + 1; r < N; r++) {
+			T f = -A(r, c) / A(c, c);
+			matrixKernel::axpy<N>(f, A.row(c), A.row(r));
+			matrixKernel::axpy<K>(f, b.row(c), b.row(r));
+		}
+	}
+	// Back substitute
+	for (int r = N - 1; r >= 0; r--) {
+		for (int i = 0; i < K; i++) {
+			T sum = b(r, i);
+			for (int c = r + 1; c < N; c++) {
+				sum -= A(r, c) * x(c, i);
+			}
+			x(r, i) = sum / A(r, r);
+		}
+	}
+	return true;
+}
+
+/*!
+ * @brief Inverse of a square matrix
+ *
+ * @param[in] A matrix to invert
+ * @param[out] inv inverse of A
+ * @return False if A is singular
+ */
+template <int N, typename T>
+bool inverse(const matrix<N, N, T>& A, matrix<N, N, T>& inv) {
+	return solve(A, matrix<N, N, T>::identity(), inv);
+}
+
+#endif /* INCLUDE_MATRIX_H_ */
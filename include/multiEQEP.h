@@ -0,0 +1,181 @@
+/**
+ *! @file multiEQEP.h
+ *! Reads several eQEPs together and publishes one time aligned sample
+ *!
+ *! @author Troy Dack
+ *! @date Copyright (C) 2015
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ **/
+
+#ifndef INCLUDE_MULTIEQEP_H_
+#define INCLUDE_MULTIEQEP_H_
+
+#include <atomic>
+#include "bbb-eqep/bbb-eqep.h"
+#include "pendulumState.h"
+#include "periodicScheduler.h"
+#include "positionUnwrapper.h"
+#include "spscRing.h"
+#include "velocityEstimator.h"
+
+const int MULTI_EQEP_MAX = 3; //!< @brief The AM335x has three eQEP modules
+const int EQEP_SAMPLE_MS = 10;	//!< @brief Sample period when running as a thread
+
+/*!
+ * @brief Every encoder read in one pass
+ */
+struct encoderSnapshot {
+	uint64_t timestamp;						/*!< CLOCK_MONOTONIC time of the pass in nanoseconds */
+	int count;								/*!< Number of encoders */
+	encoderState encoder[MULTI_EQEP_MAX];	/*!< Encoder values, indexed by addEncoder() id */
+};
+
+typedef seqlock<encoderSnapshot> encoderSnapshotBuffer; /*!< @brief Published multi encoder snapshot */
+
+/*!
+ * @brief Raw register values of one encoder from one pass, for filtering and logging
+ */
+struct rawEncoderSample {
+	uint64_t timestamp;		/*!< CLOCK_MONOTONIC time of the pass in nanoseconds */
+	uint32_t position;		/*!< Raw position counter */
+	uint16_t capturePeriod;	/*!< QCPRDLAT */
+	uint16_t captureTimer;	/*!< QCTMRLAT */
+	uint16_t status;		/*!< QEPSTS */
+	uint8_t encoder;		/*!< Encoder id returned by addEncoder() */
+};
+
+const int RAW_SAMPLE_RING_SIZE = 1024; //!< @brief About 5s of history for two encoders at 100Hz
+
+typedef spscRing<rawEncoderSample, RAW_SAMPLE_RING_SIZE> rawSampleRing; /*!< @brief Raw sample history */
+
+/*!
+ * @brief Acquisition engine for all of the eQEPs
+ *
+ * Owns the BBB::eQEP instances and reads the position, capture and status
+ * registers of every encoder back to back in one pass.  The whole pass gets a
+ * single timestamp and is published as one snapshot, so the controller always
+ * sees pendulum and motor values taken at the same instant.
+ *
+ * Run it as a periodicScheduler task (no thread of its own), or call sample()
+ * directly, eg: from controlPipeline.
+ */
+class multiEQEP : public periodicTask {
+
+public:
+	/*!
+	 * @param[in] samplePeriodMs period sample() will be called at, in milliseconds
+	 */
+	multiEQEP(int samplePeriodMs);
+
+	~multiEQEP();
+
+	/*!
+	 * @brief Open and configure an eQEP.  Call before sampling starts.
+	 *
+	 * @param[in] eqep_number eQEP # to use (0, 1, 2)
+	 * @param[in] encoder_ppr Pulses per revolution for encoder
+	 * @return encoder id, or -1 if MULTI_EQEP_MAX encoders have already been added
+	 */
+	int addEncoder(int eqep_number, double encoder_ppr);
+
+	/*!
+	 * @brief Also publish each pass as a pendulum state vector
+	 *  The pendulum angle is wrapped to [-pi, pi) so it is measured the short
+	 *  way from vertical however many times the pendulum has gone over the top.
+	 *
+	 * @param[out] out buffer to publish to, eg: controlSignals::state
+	 * @param[in] pendulum id of the pendulum encoder
+	 * @param[in] motor id of the motor encoder
+	 */
+	void bindState(pendulumStateBuffer* out, int pendulum, int motor);
+
+	/*!
+	 * @brief Also push every encoder's raw values into a ring buffer
+	 *  sample() is the only producer.  Records are dropped, not waited for,
+	 *  if the consumer falls behind.
+	 *
+	 * @param[in] ring ring to fill, or NULL to stop
+	 */
+	void setRawLog(rawSampleRing* ring);
+
+	/*!
+	 * @brief Read every encoder once, called by the scheduler each period
+	 */
+	void tick(const tickInfo& info);
+
+	/*!
+	 * @brief Read every encoder once and publish the results
+	 *
+	 * @return False if no new sample was published
+	 */
+	bool sample();
+
+	encoderSnapshot getSnapshot(); // consistent snapshot of all encoders
+
+	encoderState getState(int id);
+
+	double getAngleDeg(int id);
+
+	void setPosition(int id, int64_t position);
+
+	void setDeg(int id, double deg);
+
+	void setVelocityMode(velocityEstimator::mode mode); // choose difference, capture or auto velocity
+
+	velocityNoise getVelocityNoise(int id); // estimator in use and noise statistics
+
+	/*!
+	 * @brief Latch every encoder on its hardware unit timer
+	 *  The timers are started together, and re-phased on the next sample() so
+	 *  they latch just before each scheduler tick.  That first sample is not
+	 *  published.
+	 */
+	void setUnitTimerSampling();
+
+	void setReadSampling(); // sample when the eQEPs are read (default)
+
+private:
+	struct channel {
+		BBB::eQEP *eqep;
+		double ppr;						// Pulse per revolution
+		int64_t lastPos;				// position at previous sample
+		velocityEstimator *estimator;
+		positionUnwrapper unwrap;		// 64 bit count, owned by the sampling thread
+		std::atomic<int64_t> target;	// position requested by setPosition()
+		std::atomic<bool> rebase;		// position was changed, restart the count at target
+		std::atomic<bool> resync;		// restart velocity estimate
+	};
+
+	bool waitForLatch(uint64_t& timestamp); // wait for the unit timers to latch
+
+	channel encoders[MULTI_EQEP_MAX];
+	int count;
+	int periodMs;
+	encoderSnapshotBuffer snapshot;
+
+	pendulumStateBuffer *stateOut;
+	std::atomic<rawSampleRing*> rawOut;
+	int pendulumId;
+	int motorId;
+
+	bool unitTimerLatch; // sample on the hardware unit timer instead of on read
+	bool rephase; // align the unit timers to the next sample() call
+	uint64_t latchTime; // hardware time of the last latch in nanoseconds
+	uint64_t lastWake; // CLOCK_MONOTONIC time the last latch was collected
+};
+
+#endif /* INCLUDE_MULTIEQEP_H_ */
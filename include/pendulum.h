@@ -32,8 +32,8 @@
 #include <BlackLib/BlackPWM/BlackPWM.h>
 #include <BlackLib/BlackGPIO/BlackGPIO.h>
 
-// Threaded eQEP implementation
-#include <threadedEQEP.h>
+// Reads all of the eQEPs in one pass
+#include <multiEQEP.h>
 
 // Pololu Serial Motor Controller class
 #include <Pololu/pololuSMC.h>
@@ -69,6 +69,11 @@ const double MOTOR_TEETH = 40.0;	/*!< @brief Number of teeth on motor pulley */
 const double ENCODER_TEETH = 12.0;	/*!< @brief Number of teeth on encoder pulley */
 const double ENCODER_PPR = 4 * 400.0;	/*!< @brief Encoder pulses per revolution (x4 mode) */
 const double MOTOR_PPR = 4 * 400.0 * MOTOR_TEETH / ENCODER_TEETH; /*!< @brief Motor pulses per revolution (scaled */
+const int SAMPLE_TIME = 20; /*!< @brief Controller sample period in milliseconds */
+const int TRANSFER_TIME = 200; /*!< @brief Time in milliseconds to blend outputs over when the controller is switched */
+const int STATUS_TIME = 100; /*!< @brief Time in milliseconds between status lines */
+const char* const LQR_WEIGHTS_FILE = "lqr_weights"; /*!< @brief q1 q2 q3 q4 r read on SIGUSR2 to redesign the LQR */
+
 /**
  * /dev/ttyO2 - serial comms to SMC
  *
@@ -0,0 +1,72 @@
+/**
+ *! @file pendulumState.h
+ *! State vector shared between the encoders, controllers and main loop
+ *!
+ *! @author Troy Dack
+ *! @date Copyright (C) 2015
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ **/
+
+#ifndef INCLUDE_PENDULUMSTATE_H_
+#define INCLUDE_PENDULUMSTATE_H_
+
+#include <seqlock.h>
+#include <matrix.h>
+#include <cstdint>
+
+/*!
+ * @brief Snapshot of a single encoder
+ */
+struct encoderState {
+	int64_t position;	/*!< Unwrapped position count */
+	int delta;			/*!< Change in position since the previous sample */
+	int wraps;			/*!< Net position counter rollovers, positive for QPOSMAX -> 0 */
+	double angle;		/*!< Angle in radians */
+	double velocity;	/*!< Angular velocity */
+	uint64_t timestamp;	/*!< CLOCK_MONOTONIC time of the sample in nanoseconds */
+};
+
+/*!
+ * @brief Snapshot of the full pendulum state vector
+ */
+struct pendulumState {
+	double pAngle;		/*!< Pendulum angle in radians, 0 = vertical, in [-pi, pi) */
+	double mAngle;		/*!< Motor angle in radians */
+	double pVelocity;	/*!< Pendulum angular velocity */
+	double mVelocity;	/*!< Motor angular velocity */
+	uint64_t timestamp;	/*!< CLOCK_MONOTONIC time of the sample in nanoseconds */
+};
+
+const int STATE_SIZE = 4;	/*!< @brief Number of elements in the state vector */
+typedef vec<STATE_SIZE> stateVector;	/*!< @brief State as a column vector [pAngle mAngle pVelocity mVelocity] */
+
+/*!
+ * @brief State as a column vector, in the same order as the members of pendulumState
+ */
+inline stateVector toVector(const pendulumState& s) {
+	stateVector x;
+	x[0] = s.pAngle;
+	x[1] = s.mAngle;
+	x[2] = s.pVelocity;
+	x[3] = s.mVelocity;
+	return x;
+}
+
+typedef seqlock<encoderState> encoderStateBuffer;	/*!< @brief Published encoder snapshot */
+typedef seqlock<pendulumState> pendulumStateBuffer;	/*!< @brief Published pendulum state snapshot */
+
+#endif /* INCLUDE_PENDULUMSTATE_H_ */
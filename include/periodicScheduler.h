@@ -0,0 +1,161 @@
+/**
+ *! @file periodicScheduler.h
+ *! Absolute deadline periodic task scheduler
+ *!
+ *! @author Troy Dack
+ *! @date Copyright (C) 2015
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ **/
+
+#ifndef INCLUDE_PERIODICSCHEDULER_H_
+#define INCLUDE_PERIODICSCHEDULER_H_
+
+#include <BlackLib/BlackThread/BlackThread.h>
+#include <atomic>
+#include <cstdint>
+#include <time.h>
+
+/*!
+ * @brief Information passed to a periodic task each time it is run
+ */
+struct tickInfo {
+	uint64_t tick;				/*!< Number of ticks since the scheduler started */
+	struct timespec deadline;	/*!< Absolute CLOCK_MONOTONIC time the tick was due */
+	int64_t lateness;			/*!< Nanoseconds between the deadline and the actual wakeup */
+	double dt;					/*!< Nominal period of the task in seconds */
+};
+
+/*!
+ * @brief Interface for work that is run by periodicScheduler
+ */
+class periodicTask {
+public:
+	virtual ~periodicTask() {}
+
+	/*!
+	 * @brief Called by the scheduler once per period
+	 *
+	 * @param[in] info timing information for this tick
+	 */
+	virtual void tick(const tickInfo& info) = 0;
+};
+
+/*!
+ * @brief Wakeup lateness statistics for a task
+ */
+struct latenessStats {
+	uint64_t ticks;		/*!< Number of times the task has run */
+	uint64_t overruns;	/*!< Number of periods skipped because a tick ran too long */
+	int64_t min;		/*!< Minimum lateness in nanoseconds */
+	int64_t max;		/*!< Maximum lateness in nanoseconds */
+	double mean;		/*!< Mean lateness in nanoseconds */
+};
+
+/*!
+ * @brief Runs registered tasks on exact period boundaries
+ *
+ * The scheduler thread sleeps with clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME)
+ * until the next deadline, so the CPU is idle between ticks and deadlines do not
+ * drift with the time taken by each task.  If a task overruns its period the
+ * missed ticks are skipped (and counted) rather than run back to back.
+ */
+class periodicScheduler : public BlackLib::BlackThread {
+
+public:
+	static const int MAX_TASKS = 8;	/*!< Maximum number of tasks that can be registered */
+
+	periodicScheduler();
+
+	/*!
+	 * @brief Register a task to be run every periodMs milliseconds
+	 *  Tasks must be added before the scheduler is started with run()
+	 *
+	 * @param[in] task task to run
+	 * @param[in] periodMs period in milliseconds
+	 * @return task id used for getStats(), or -1 if the task could not be added
+	 */
+	int addTask(periodicTask* task, int periodMs);
+
+	/*!
+	 * @brief Register a task to be run every period_ns nanoseconds
+	 *
+	 * @param[in] task task to run
+	 * @param[in] period_ns period in nanoseconds
+	 * @return task id used for getStats(), or -1 if the task could not be added
+	 */
+	int addTaskNs(periodicTask* task, int64_t period_ns);
+
+	/*!
+	 * @brief Thread's start handler function.
+	 */
+	void onStartHandler();
+
+	/*!
+	 * @brief Stops the thread running
+	 */
+	void stop();
+
+	/*!
+	 * @brief Get wakeup lateness statistics for a task
+	 *
+	 * @param[in] id task id returned by addTask()
+	 */
+	latenessStats getStats(int id);
+
+	/*!
+	 * @brief Lateness in nanoseconds of the most recent wakeup of a task
+	 *
+	 * @param[in] id task id returned by addTask()
+	 */
+	int64_t getLastLateness(int id);
+
+private:
+	struct entry {
+		periodicTask *task;
+		int64_t period;				// period in nanoseconds
+		struct timespec next;		// next absolute deadline
+		std::atomic<uint64_t> ticks;
+		std::atomic<uint64_t> overruns;
+		std::atomic<int64_t> last;
+		std::atomic<int64_t> min;
+		std::atomic<int64_t> max;
+		std::atomic<int64_t> total;
+	};
+
+	void record(entry& e, int64_t lateness);
+
+	std::atomic<bool> bExit; 	/*!< flag to tell thread to quit */
+	entry tasks[MAX_TASKS];
+	int nTasks;
+};
+
+/*!
+ * @brief Add nanoseconds to a timespec, normalising the result
+ */
+void timespecAdd(struct timespec& ts, int64_t ns);
+
+/*!
+ * @brief Difference a - b in nanoseconds
+ */
+int64_t timespecDiff(const struct timespec& a, const struct timespec& b);
+
+/*!
+ * @brief Current CLOCK_MONOTONIC time in nanoseconds
+ */
+uint64_t monotonicNow();
+
+#endif /* INCLUDE_PERIODICSCHEDULER_H_ */
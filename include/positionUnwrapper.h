@@ -0,0 +1,82 @@
+/**
+ *! @file positionUnwrapper.h
+ *! 64 bit position count from the wrapping eQEP position counter
+ *!
+ *! @author Troy Dack
+ *! @date Copyright (C) 2015
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ **/
+
+#ifndef INCLUDE_POSITIONUNWRAPPER_H_
+#define INCLUDE_POSITIONUNWRAPPER_H_
+
+#include <cstdint>
+
+/*!
+ * @brief Extends the eQEP position counter to a signed 64 bit count
+ *
+ * QPOSCNT counts from 0 to QPOSMAX and rolls over in both directions.  Each
+ * new reading is compared with the last, modulo QPOSMAX + 1, and the shortest
+ * signed difference is added to a 64 bit count.  This is correct as long as the
+ * encoder moves less than half the counter range between updates.
+ *
+ * Owned by the sampling thread.  The count is shared with other threads
+ * through the published encoderState.
+ */
+class positionUnwrapper {
+
+public:
+	/*!
+	 * @param[in] maxPosition QPOSMAX, the counter rolls over to 0 after this value
+	 */
+	positionUnwrapper(uint32_t maxPosition = 0xFFFFFFFF);
+
+	void setMaxPosition(uint32_t maxPosition);
+
+	/*!
+	 * @brief Add a new counter reading
+	 *
+	 * @param[in] raw QPOSCNT (or QPOSLAT)
+	 * @return unwrapped position
+	 */
+	int64_t update(uint32_t raw);
+
+	/*!
+	 * @brief Restart the count at position, eg: after the counter was set to toRaw(position)
+	 */
+	void reset(int64_t position);
+
+	/*!
+	 * @brief Counter value that corresponds to an unwrapped position
+	 */
+	uint32_t toRaw(int64_t position) const;
+
+	int64_t position() const;
+
+	/*!
+	 * @brief Net number of rollovers, positive for QPOSMAX -> 0
+	 */
+	int64_t wraps() const;
+
+private:
+	uint64_t modulus;	// QPOSMAX + 1
+	uint32_t last;		// previous counter reading
+	int64_t count;		// unwrapped position
+	int64_t rollovers;
+};
+
+#endif /* INCLUDE_POSITIONUNWRAPPER_H_ */
@@ -0,0 +1,123 @@
+/**
+ *! @file seqlock.h
+ *! Single writer, multiple reader lock-free value snapshot
+ *!
+ *! @author Troy Dack
+ *! @date Copyright (C) 2015
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ **/
+
+#ifndef INCLUDE_SEQLOCK_H_
+#define INCLUDE_SEQLOCK_H_
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+
+const int CACHE_LINE_SIZE = 64; /*!< @brief Cortex-A8 L1/L2 cache line size in bytes */
+
+/*!
+ * @brief Sequence lock protected copy of a value
+ *
+ * One thread publishes new values, any number of threads read consistent
+ * snapshots without taking a lock.  The writer never waits; a reader that
+ * overlaps a write simply retries.  The sequence number doubles as a version
+ * count so readers can tell whether a value is new.
+ *
+ * T must be trivially copyable.  The payload is stored as relaxed atomic words
+ * so concurrent access is well defined.  The sequence and payload are padded
+ * by a cache line either side so they never share a line with a neighbouring
+ * member, even when the owning object is allocated with plain new.
+ */
+template <typename T>
+class seqlock {
+
+public:
+	seqlock() : seq(0) {
+		T empty = T();
+		store(empty);
+	}
+
+	/*!
+	 * @brief Publish a new value.  Only one thread may call this.
+	 *
+	 * @param[in] value value to publish
+	 */
+	void publish(const T& value) {
+		uint32_t s = seq.load(std::memory_order_relaxed);
+		seq.store(s + 1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+		store(value);
+		seq.store(s + 2, std::memory_order_release);
+	}
+
+	/*!
+	 * @brief Read a consistent snapshot of the value
+	 *
+	 * @param[out] value snapshot
+	 * @return version of the snapshot (number of times publish() has been called)
+	 */
+	uint32_t read(T& value) const {
+		uint32_t words[WORDS];
+		uint32_t s0, s1;
+		do {
+			s0 = seq.load(std::memory_order_acquire);
+			for (int i = 0; i < WORDS; i++) {
+				words[i] = data[i].load(std::memory_order_relaxed);
+			}
+			std::atomic_thread_fence(std::memory_order_acquire);
+			s1 = seq.load(std::memory_order_relaxed);
+		} while ((s0 & 1) || s0 != s1);
+		memcpy(&value, words, sizeof(T));
+		return s0 >> 1;
+	}
+
+	/*!
+	 * @brief Read a consistent snapshot of the value
+	 */
+	T read() const {
+		T value;
+		read(value);
+		return value;
+	}
+
+	/*!
+	 * @brief Number of times publish() has been called
+	 */
+	uint32_t version() const {
+		return seq.load(std::memory_order_acquire) >> 1;
+	}
+
+private:
+	static const int WORDS = (sizeof(T) + sizeof(uint32_t) - 1) / sizeof(uint32_t);
+
+	void store(const T& value) {
+		uint32_t words[WORDS];
+		words[WORDS - 1] = 0;
+		memcpy(words, &value, sizeof(T));
+		for (int i = 0; i < WORDS; i++) {
+			data[i].store(words[i], std::memory_order_relaxed);
+		}
+	}
+
+	char padBefore[CACHE_LINE_SIZE];
+	std::atomic<uint32_t> seq;
+	std::atomic<uint32_t> data[WORDS];
+	char padAfter[CACHE_LINE_SIZE];
+};
+
+#endif /* INCLUDE_SEQLOCK_H_ */
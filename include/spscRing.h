@@ -0,0 +1,121 @@
+/**
+ *! @file spscRing.h
+ *! Single producer, single consumer lock-free ring buffer
+ *!
+ *! @author Troy Dack
+ *! @date Copyright (C) 2015
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ **/
+
+#ifndef INCLUDE_SPSCRING_H_
+#define INCLUDE_SPSCRING_H_
+
+#include <seqlock.h>
+#include <atomic>
+#include <cstdint>
+
+/*!
+ * @brief Fixed capacity single producer, single consumer ring buffer
+ *
+ * One thread pushes records, one other thread pops them, individually or in
+ * batches.  Neither side takes a lock, waits or allocates.  If the ring is full
+ * the producer drops the new record and counts it rather than waiting for the
+ * consumer.
+ *
+ * The head and tail indices run freely and are masked on access, so N must be
+ * a power of two.  Each index lives on its own cache line so the producer and
+ * consumer don't invalidate each other's line on every operation.
+ */
+template <typename T, int N>
+class spscRing {
+	static_assert(N > 0 && (N & (N - 1)) == 0, "spscRing size must be a power of two");
+
+public:
+	spscRing() : head(0), drops(0), tail(0) {}
+
+	/*!
+	 * @brief Add a record.  Only the producer thread may call this.
+	 *
+	 * @param[in] value record to add
+	 * @return False if the ring was full and the record was dropped
+	 */
+	bool push(const T& value) {
+		uint32_t h = head.load(std::memory_order_relaxed);
+		if (h - tail.load(std::memory_order_acquire) >= (uint32_t)N) {
+			drops.store(drops.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+			return false;
+		}
+		buffer[h & (N - 1)] = value;
+		head.store(h + 1, std::memory_order_release);
+		return true;
+	}
+
+	/*!
+	 * @brief Remove the oldest record.  Only the consumer thread may call this.
+	 *
+	 * @param[out] value oldest record
+	 * @return False if the ring was empty
+	 */
+	bool pop(T& value) {
+		return pop(&value, 1) == 1;
+	}
+
+	/*!
+	 * @brief Remove up to max of the oldest records.  Only the consumer thread may call this.
+	 *
+	 * @param[out] values array of at least max records
+	 * @param[in] max maximum number of records to remove
+	 * @return number of records removed
+	 */
+	int pop(T* values, int max) {
+		uint32_t t = tail.load(std::memory_order_relaxed);
+		uint32_t available = head.load(std::memory_order_acquire) - t;
+		int n = (available < (uint32_t)max) ? (int)available : max;
+		for (int i = 0; i < n; i++) {
+			values[i] = buffer[(t + i) & (N - 1)];
+		}
+		tail.store(t + n, std::memory_order_release);
+		return n;
+	}
+
+	/*!
+	 * @brief Number of records waiting to be popped
+	 */
+	int size() const {
+		return (int)(head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire));
+	}
+
+	/*!
+	 * @brief Number of records dropped because the ring was full
+	 */
+	uint32_t dropped() const {
+		return drops.load(std::memory_order_relaxed);
+	}
+
+	static const int capacity = N; /*!< Maximum number of records held */
+
+private:
+	char padBefore[CACHE_LINE_SIZE];
+	std::atomic<uint32_t> head;		// next slot to write, owned by the producer
+	std::atomic<uint32_t> drops;
+	char padMiddle[CACHE_LINE_SIZE];
+	std::atomic<uint32_t> tail;		// next slot to read, owned by the consumer
+	char padAfter[CACHE_LINE_SIZE];
+	T buffer[N];
+};
+
+#endif /* INCLUDE_SPSCRING_H_ */
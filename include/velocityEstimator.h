@@ -0,0 +1,137 @@
+/**
+ *! @file velocityEstimator.h
+ *! Encoder velocity estimation from position difference and eQEP capture period
+ *!
+ *! @author Troy Dack
+ *! @date Copyright (C) 2015
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ **/
+
+#ifndef INCLUDE_VELOCITYESTIMATOR_H_
+#define INCLUDE_VELOCITYESTIMATOR_H_
+
+#include <seqlock.h>
+#include <atomic>
+#include <cstdint>
+
+const double EQEP_SYSCLK_HZ = 100e6; /*!< @brief PWMSS functional clock (SYSCLKOUT) in Hz */
+const int EQEP_UPPS = 2;		//!< @brief Unit position event every 2^2 = 4 counts (one quadrature cycle)
+const int EQEP_CCPS = 7;		//!< @brief Capture timer clock = SYSCLKOUT/2^7 = 781.25kHz
+
+/*!
+ * @brief Raw values read from an eQEP in one sample
+ */
+struct eqepSample {
+	int64_t position;		/*!< Unwrapped QPOSCNT (or QPOSLAT) */
+	uint16_t capturePeriod;	/*!< QCPRDLAT, capture timer ticks between unit position events */
+	uint16_t captureTimer;	/*!< QCTMRLAT, capture timer ticks since the last unit position event */
+	uint16_t status;		/*!< QEPSTS */
+	uint64_t timestamp;		/*!< CLOCK_MONOTONIC time of the sample in nanoseconds */
+};
+
+/*!
+ * @brief Noise statistics of the velocity estimators
+ *
+ * Noise is estimated from the sample to sample change in each estimate,
+ * var(v[k] - v[k-1]) / 2, which is the measurement noise variance when the
+ * true velocity changes slowly compared to the sample rate.
+ */
+struct velocityNoise {
+	int active;					/*!< Estimator used for the last sample (velocityEstimator::mode) */
+	double differenceVariance;	/*!< Noise variance of the position difference estimate (rad/s)^2 */
+	double captureVariance;		/*!< Noise variance of the capture period estimate (rad/s)^2 */
+	uint32_t switches;			/*!< Number of times the auto mode changed estimator */
+	uint32_t captureErrors;		/*!< Samples where the capture unit flagged overflow or direction change */
+};
+
+/*!
+ * @brief Velocity estimator for one eQEP
+ *
+ * The position difference estimate (counts moved / time between samples) is
+ * accurate at speed but quantised to one count per sample period when slow.
+ * The capture unit measures the time between unit position events with the
+ * capture timer, which is accurate when slow but quantised to one timer tick
+ * when fast.  In Auto mode the estimator uses whichever is better for the
+ * current speed, with hysteresis around the crossover.
+ */
+class velocityEstimator {
+
+public:
+	enum mode {
+		Difference = 0,	/*!< Position difference over the sample period */
+		Capture = 1,	/*!< eQEP capture period */
+		Auto = 2		/*!< Capture when slow, difference when fast */
+	};
+
+	/*!
+	 * @param[in] encoder_ppr encoder pulses per revolution (x4 mode)
+	 * @param[in] upps unit position event prescaler, an event every 2^upps counts
+	 * @param[in] ccps capture timer prescaler, capture clock = SYSCLKOUT/2^ccps
+	 * @param[in] samplePeriod nominal time between samples in seconds, used to
+	 * 					set the Auto mode crossover speed
+	 */
+	velocityEstimator(double encoder_ppr, int upps, int ccps, double samplePeriod);
+
+	/*!
+	 * @brief Update the estimate with a new sample
+	 *
+	 * @param[in] s raw eQEP values
+	 * @return velocity in radians/second
+	 */
+	double update(const eqepSample& s);
+
+	/*!
+	 * @brief Forget the previous sample, eg: after the position counter was changed
+	 */
+	void reset();
+
+	void setMode(mode m);
+
+	mode getMode();
+
+	/*!
+	 * @brief Set the Auto mode crossover speed
+	 *
+	 * @param[in] countsPerSecond speed above which the difference estimate is used
+	 */
+	void setCrossover(double countsPerSecond);
+
+	/*!
+	 * @brief Estimator choice and noise statistics
+	 */
+	velocityNoise getNoise();
+
+private:
+	double capture(const eqepSample& s, bool& valid);
+
+	double ppr;					// Pulse per revolution
+	double countsPerEvent;		// quadrature counts per unit position event
+	double captureHz;			// capture timer clock
+	double crossover;			// Auto mode crossover in counts/second
+	int current;				// estimator used for the last sample
+	bool first;
+
+	eqepSample last;
+	double lastDifference;
+	double lastCapture;
+
+	velocityNoise noise;		// owned by the sampling thread
+	seqlock<velocityNoise> published;
+	std::atomic<int> selected;	// mode requested with setMode()
+};
+
+#endif /* INCLUDE_VELOCITYESTIMATOR_H_ */
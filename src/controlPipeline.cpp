@@ -0,0 +1,114 @@
+/**
+ *! @file controlPipeline.cpp
+ *! Single thread sense -> compute -> actuate control pipeline
+ *!
+ *! @author Troy Dack
+ *! @date Copyright (C) 2015
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ **/
+
+#include <controlPipeline.h>
+#include <cmath>
+#include <limits>
+
+controlSignals::controlSignals()
+	: motorSpeed(0.0)
+	, setAngle(0.0)
+	, cutoffAngle(MOTOR_CUTOFF_ANGLE)
+{
+}
+
+int motorCommand(double motorSpeed, double pendulumAngleDeg, double cutoffDeg) {
+	// Motor doesn't move unless speed > MOTOR_DEADBAND
+	int setSpeed = ( motorSpeed > 0 ? 1 : -1) * MOTOR_DEADBAND + (int)motorSpeed;
+	if (setSpeed > Pololu::SMC_MAX_SPEED) {
+		setSpeed = Pololu::SMC_MAX_SPEED;
+	} else if (setSpeed < -Pololu::SMC_MAX_SPEED) {
+		setSpeed = -Pololu::SMC_MAX_SPEED;
+	}
+	// stop the motor if we deviate too far from vertical
+	return (cutoffDeg > 0 && std::abs(pendulumAngleDeg) > cutoffDeg) ? 0 : setSpeed;
+}
+
+controlPipeline::controlPipeline(multiEQEP* eqeps, periodicTask* ctrl, Pololu::SMC* smc,
+								 controlSignals* signals)
+	: encoders(eqeps)
+	, controller(ctrl)
+	, SMC(smc)
+	, io(signals)
+	, setSpeed(0)
+	, ticks(0)
+	, overruns(0)
+	, last(0)
+	, min(std::numeric_limits<int64_t>::max())
+	, max(0)
+	, total(0)
+{
+}
+
+void controlPipeline::tick(const tickInfo& info) {
+	struct timespec start, end;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	// Sense, the encoders publish straight to io->state
+	encoders->sample();
+	pendulumState x = io->state.read();
+
+	// Compute
+	controller->tick(info);
+
+	// Actuate
+	int speed = motorCommand(io->motorSpeed.load(), x.pAngle * 180 / M_PI, io->cutoffAngle.load());
+	SMC->SetTargetSpeed(speed);
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	// Only this thread writes the statistics, so relaxed load/store pairs are enough
+	int64_t latency = timespecDiff(end, start);
+	setSpeed.store(speed, std::memory_order_relaxed);
+	last.store(latency, std::memory_order_relaxed);
+	if (latency < min.load(std::memory_order_relaxed)) {
+		min.store(latency, std::memory_order_relaxed);
+	}
+	if (latency > max.load(std::memory_order_relaxed)) {
+		max.store(latency, std::memory_order_relaxed);
+	}
+	if (latency > (int64_t)(info.dt * 1e9)) {
+		overruns.store(overruns.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	}
+	total.store(total.load(std::memory_order_relaxed) + latency, std::memory_order_relaxed);
+	ticks.store(ticks.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+int64_t controlPipeline::getLastLatency() {
+	return last.load();
+}
+
+latenessStats controlPipeline::getLatencyStats() {
+	latenessStats s;
+	s.ticks = ticks.load(std::memory_order_acquire);
+	s.overruns = overruns.load();
+	s.min = (s.ticks > 0) ? min.load() : 0;
+	s.max = max.load();
+	s.mean = (s.ticks > 0) ? (double)total.load() / s.ticks : 0.0;
+	return s;
+}
+
+int controlPipeline::getSetSpeed() {
+	return setSpeed.load();
+}
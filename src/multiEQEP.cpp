@@ -0,0 +1,327 @@
+/**
+ *! @file multiEQEP.cpp
+ *! Reads several eQEPs together and publishes one time aligned sample
+ *!
+ *! @author Troy Dack
+ *! @date Copyright (C) 2015
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ **/
+
+#include <multiEQEP.h>
+#include <fastTrig.h>
+#include <math.h>
+#include <stdexcept>
+
+const int64_t LATCH_MARGIN_NS = 200000; // unit timers latch 200us before each sample() call
+
+/**
+ * multiEQEP acquisition engine.  Encoders are added with addEncoder().
+ *
+ * @param samplePeriodMs period sample() will be called at, in milliseconds
+ */
+multiEQEP::multiEQEP(int samplePeriodMs)
+	: count(0)
+	, periodMs(samplePeriodMs)
+	, stateOut(NULL)
+	, rawOut(NULL)
+	, pendulumId(0)
+	, motorId(0)
+	, unitTimerLatch(false)
+	, rephase(false)
+	, latchTime(0)
+	, lastWake(0)
+{
+	for (int i = 0; i < MULTI_EQEP_MAX; i++) {
+		encoders[i].eqep = NULL;
+		encoders[i].estimator = NULL;
+		encoders[i].target.store(0);
+		encoders[i].rebase.store(false);
+		encoders[i].resync.store(true);
+	}
+}
+
+multiEQEP::~multiEQEP() {
+	for (int i = 0; i < count; i++) {
+		delete encoders[i].eqep;
+		delete encoders[i].estimator;
+	}
+}
+
+int multiEQEP::addEncoder(int eqep_number, double encoder_ppr) {
+	if (count >= MULTI_EQEP_MAX) {
+		return -1;
+	}
+	channel& c = encoders[count];
+	try {
+		c.eqep = new BBB::eQEP(eqep_number);
+	}
+	catch (std::runtime_error& err) {
+		throw std::runtime_error("Failed to access eQEP");
+	}
+	c.eqep->resetPositionCounter();				// reset eQEP
+	c.eqep->positionCounterSourceSelection(0);	// set Quadrature mode
+	c.eqep->enablePositionCompareShadow();		// enable Shadow
+	c.eqep->setCaptureLatchMode(BBB::eQEP::CLMCPU);
+	c.eqep->setCaptureTimeClockPrescaler(EQEP_CCPS);
+	c.eqep->setPositionEventPrescaler(EQEP_UPPS);
+	c.eqep->enableCaptureUnit();
+	c.eqep->setUnitPeriod((uint32_t)(EQEP_SYSCLK_HZ / 1000 * periodMs));
+	if (c.eqep->getMaxPos() == 0) {
+		c.eqep->setMaxPos(0xFFFFFFFF); // use the full counter range
+	}
+	c.unwrap.setMaxPosition(c.eqep->getMaxPos());
+	c.unwrap.reset(0);
+	c.ppr = encoder_ppr;
+	c.lastPos = 0;
+	c.estimator = new velocityEstimator(encoder_ppr, EQEP_UPPS, EQEP_CCPS, periodMs / 1000.0);
+	c.resync.store(true);
+	return count++;
+}
+
+void multiEQEP::bindState(pendulumStateBuffer* out, int pendulum, int motor) {
+	pendulumId = pendulum;
+	motorId = motor;
+	stateOut = out;
+}
+
+void multiEQEP::setRawLog(rawSampleRing* ring) {
+	rawOut.store(ring);
+}
+
+void multiEQEP::tick(const tickInfo& info) {
+	sample();
+}
+
+/**
+ * Spin until the unit timers have latched a new sample.  The latch is due
+ * LATCH_MARGIN_NS before the call, so the spin gives up 2 * LATCH_MARGIN_NS
+ * after that and re-phases the timers on the next call, rather than holding
+ * the scheduler thread for a period.  All of the timers were started together
+ * so only the first one is watched.
+ *
+ * @param timestamp set to the hardware time of the latch
+ * @return true if a new latch was collected
+ */
+bool multiEQEP::waitForLatch(uint64_t& timestamp) {
+	int64_t periodNs = (int64_t)periodMs * 1000000;
+	uint64_t now = monotonicNow();
+
+	if (rephase) {
+		// Restart the timers part way through a period so they time out
+		// LATCH_MARGIN_NS before the next call, which is one period from now
+		uint32_t margin = (uint32_t)(EQEP_SYSCLK_HZ * LATCH_MARGIN_NS / 1e9);
+		for (int i = 0; i < count; i++) {
+			encoders[i].eqep->setUnitTimer(margin);
+		}
+		for (int i = 0; i < count; i++) {
+			encoders[i].eqep->clearUnitTimeoutInterruptFlag();
+		}
+		latchTime = now - LATCH_MARGIN_NS;
+		lastWake = now;
+		rephase = false;
+		return false;
+	}
+
+	uint64_t timeout = latchTime + periodNs + 2 * LATCH_MARGIN_NS;
+	while (!encoders[0].eqep->getUnitTimeoutInterruptFlag()) {
+		now = monotonicNow();
+		if (now > timeout) {
+			rephase = true;	// the timers have drifted from the ticks
+			return false;
+		}
+	}
+	for (int i = 0; i < count; i++) {
+		encoders[i].eqep->clearUnitTimeoutInterruptFlag();
+	}
+	// dt is always a whole number of hardware periods, count any we slept through
+	uint64_t periods = (now - lastWake + periodNs / 2) / periodNs;
+	latchTime += (periods > 0 ? periods : 1) * periodNs;
+	lastWake = now;
+	timestamp = latchTime;
+	return true;
+}
+
+/**
+ * sample - read every eQEP once and publish position, change in position and
+ * velocity for all of them.
+ *
+ * The registers are read in one pass before any processing so the encoders
+ * are as close together in time as the bus allows.
+ */
+bool multiEQEP::sample() {
+	eqepSample raw[MULTI_EQEP_MAX];
+	uint32_t counter[MULTI_EQEP_MAX];
+	bool rebase[MULTI_EQEP_MAX];
+	uint64_t timestamp;
+
+	if (count == 0) {
+		return false;
+	}
+	// Taken before the read so a setPosition() during the pass waits for the next one
+	for (int i = 0; i < count; i++) {
+		rebase[i] = encoders[i].rebase.exchange(false);
+	}
+	if (unitTimerLatch) {
+		// Position, capture timer & period were latched together by the unit timers
+		if (!waitForLatch(timestamp)) {
+			for (int i = 0; i < count; i++) {
+				if (rebase[i]) {
+					encoders[i].rebase.store(true);
+				}
+			}
+			return false;
+		}
+		for (int i = 0; i < count; i++) {
+			counter[i] = encoders[i].eqep->getPositionCounterLatch();
+			raw[i].capturePeriod = encoders[i].eqep->getCapturePeriodLatch();
+			raw[i].captureTimer = encoders[i].eqep->getCaptureTimerLatch();
+			raw[i].status = encoders[i].eqep->getStatus();
+		}
+	} else {
+		// Reading QPOSCNT latches the capture timer & period of that eQEP
+		timestamp = monotonicNow();
+		for (int i = 0; i < count; i++) {
+			counter[i] = encoders[i].eqep->getPosition();
+		}
+		for (int i = 0; i < count; i++) {
+			raw[i].capturePeriod = encoders[i].eqep->getCapturePeriodLatch();
+			raw[i].captureTimer = encoders[i].eqep->getCaptureTimerLatch();
+			raw[i].status = encoders[i].eqep->getStatus();
+		}
+	}
+
+	encoderSnapshot snap;
+	snap.timestamp = timestamp;
+	snap.count = count;
+	for (int i = 0; i < count; i++) {
+		channel& c = encoders[i];
+		raw[i].timestamp = timestamp;
+		// Clear the sticky capture flags so they apply to the next sample only
+		if (raw[i].status & (EQEP_QEPSTS_COEF | EQEP_QEPSTS_CDEF | EQEP_QEPSTS_UPEVNT)) {
+			c.eqep->setStatus(EQEP_QEPSTS_COEF | EQEP_QEPSTS_CDEF | EQEP_QEPSTS_UPEVNT);
+		}
+		if (rebase[i]) {
+			c.unwrap.reset(c.target.load());
+		}
+		raw[i].position = c.unwrap.update(counter[i]);
+		if (c.resync.exchange(false) || rebase[i]) {
+			c.lastPos = raw[i].position;
+			c.estimator->reset();
+		}
+		encoderState& st = snap.encoder[i];
+		st.position = raw[i].position;
+		st.delta = (int)(raw[i].position - c.lastPos);
+		st.wraps = (int)c.unwrap.wraps();
+		st.angle = raw[i].position / c.ppr * 2 * M_PI;
+		st.velocity = c.estimator->update(raw[i]); // velocity in radians/second
+		st.timestamp = timestamp;
+		c.lastPos = raw[i].position;
+	}
+	snapshot.publish(snap);
+
+	rawSampleRing *ring = rawOut.load(std::memory_order_acquire);
+	if (ring != NULL) {
+		for (int i = 0; i < count; i++) {
+			rawEncoderSample r;
+			r.timestamp = timestamp;
+			r.position = counter[i];
+			r.capturePeriod = raw[i].capturePeriod;
+			r.captureTimer = raw[i].captureTimer;
+			r.status = raw[i].status;
+			r.encoder = i;
+			ring->push(r);
+		}
+	}
+
+	if (stateOut != NULL) {
+		pendulumState x;
+		x.pAngle = wrapAngle(snap.encoder[pendulumId].angle);
+		x.pVelocity = snap.encoder[pendulumId].velocity;
+		x.mAngle = snap.encoder[motorId].angle;
+		x.mVelocity = snap.encoder[motorId].velocity;
+		x.timestamp = timestamp;
+		stateOut->publish(x);
+	}
+	return true;
+}
+
+encoderSnapshot multiEQEP::getSnapshot() {
+	return snapshot.read();
+}
+
+encoderState multiEQEP::getState(int id) {
+	return snapshot.read().encoder[id];
+}
+
+double multiEQEP::getAngleDeg(int id) {
+	return getState(id).angle * 180 / M_PI;
+}
+
+/**
+ * Set the position.  position may be negative or larger than the counter, the
+ * hardware counter is set to position modulo QPOSMAX + 1.  The next sample()
+ * restarts the 64 bit count at position and restarts the velocity estimate so
+ * the jump in position doesn't appear as a velocity spike.
+ */
+void multiEQEP::setPosition(int id, int64_t position) {
+	encoders[id].target.store(position);
+	encoders[id].eqep->setPosition(encoders[id].unwrap.toRaw(position));
+	encoders[id].rebase.store(true);
+}
+
+void multiEQEP::setDeg(int id, double deg) {
+	int64_t posn = int64_t(encoders[id].ppr / 360 * deg);
+	setPosition(id, posn);
+}
+
+void multiEQEP::setVelocityMode(velocityEstimator::mode mode) {
+	for (int i = 0; i < count; i++) {
+		encoders[i].estimator->setMode(mode);
+	}
+}
+
+velocityNoise multiEQEP::getVelocityNoise(int id) {
+	return encoders[id].estimator->getNoise();
+}
+
+void multiEQEP::setUnitTimerSampling() {
+	for (int i = 0; i < count; i++) {
+		encoders[i].eqep->disableUnitTimer();
+		encoders[i].eqep->setCaptureLatchMode(BBB::eQEP::CLMUnitTime);
+		encoders[i].eqep->setUnitTimer(0);
+	}
+	for (int i = 0; i < count; i++) {
+		encoders[i].eqep->enableUnitTimer();
+	}
+	for (int i = 0; i < count; i++) {
+		encoders[i].eqep->clearUnitTimeoutInterruptFlag();
+		encoders[i].resync.store(true);
+	}
+	unitTimerLatch = true;
+	rephase = true;
+}
+
+void multiEQEP::setReadSampling() {
+	unitTimerLatch = false;
+	for (int i = 0; i < count; i++) {
+		encoders[i].eqep->setCaptureLatchMode(BBB::eQEP::CLMCPU);
+		encoders[i].eqep->disableUnitTimer();
+		encoders[i].target.store(0);
+		encoders[i].rebase.store(false);
+		encoders[i].resync.store(true);
+	}
+}
@@ -10,24 +10,103 @@
  *
  **/
 
-#define DEBUG
-
 #include <pendulum.h>
 #include <overlays.h>
+#include <periodicScheduler.h>
+#include <controlPipeline.h>
+#include <Controller/registry.h>
+#include <Controller/lqrTuner.h>
+#include <Model/pendulumSim.h>
+#include <Pololu/commandChannel.h>
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <fstream>
+#include <sstream>
 #include <thread>
 
-// Conditional defines determine which controller will be used
-#ifdef PENDULUM_CTRL_LQR
-#include <Controller/lqr.h>
+/*!
+ * @brief Run time options from the command line
+ */
+struct runOptions {
+	std::string controller;		/*!< Name of the controller to start with */
+	bool pipeline;				/*!< Run sense, compute and actuate in order on the controller thread */
+	bool unitTimer;				/*!< Latch both encoders on the eQEP unit timer */
+	bool rawLog;				/*!< Write every raw encoder sample to eqep_raw.csv */
+	double supplyVoltage;		/*!< Motor supply voltage */
+	std::string smcTTY;			/*!< tty the SMC is on */
+	int baud;					/*!< SMC serial baud rate */
+	bool crc;					/*!< Append CRC-7 to SMC commands */
+	int telemetryMs;			/*!< Time between SMC telemetry rounds, 0 for none */
+	bool pollCurrent;			/*!< Include motor current in the telemetry */
+	bool design;				/*!< Design the LQR gains from the model instead of the tuned gains */
+	Model::lqrWeights weights;	/*!< LQR design weights */
+};
+
+/*!
+ * @brief Controllers switched by SIGUSR1
+ */
+Controller::registry *controllers = NULL;
+
+/*!
+ * @brief Set by SIGUSR2 to reload the LQR weights
+ */
+volatile sig_atomic_t reloadWeights = 0;
+
+/*!
+ * @brief SIGUSR1 handler, switches to the next controller at the next tick
+ */
+void nextController(int sig) {
+	if (controllers != NULL) {
+		controllers->next();
+	}
+}
 
-#elif PENDULUM_CTRL_VELOCITY
-#include <Controller/velocity.h>
+/*!
+ * @brief SIGUSR2 handler, the main loop reloads the LQR weights
+ */
+void requestWeights(int sig) {
+	reloadWeights = 1;
+}
 
-#else //Use basic controller by default
-#define PENDULUM_CTRL_BASIC
-#include <Controller/basic.h>
+/*!
+ * @brief Parse LQR weights
+ *
+ * @param text q1..q4 and r separated by commas or white space
+ * @param[out] weights parsed weights, unchanged if text is not valid
+ * @return True if five weights were read
+ */
+bool parseWeights(std::string text, Model::lqrWeights& weights) {
+	std::replace(text.begin(), text.end(), ',', ' ');
+	std::istringstream in(text);
+	Model::lqrWeights w;
+	for (int i = 0; i < STATE_SIZE; i++) {
+		in >> w.q[i];
+	}
+	in >> w.r;
+	if (in.fail()) {
+		return false;
+	}
+	weights = w;
+	return true;
+}
 
-#endif
+/*!
+ * @brief Write any raw encoder samples waiting in the ring to a CSV file
+ *
+ * @param ring raw sample ring filled by multiEQEP
+ * @param out file to write to
+ */
+void drainRawLog(rawSampleRing* ring, std::ostream& out) {
+	rawEncoderSample batch[64];
+	int n;
+	while ((n = ring->pop(batch, 64)) > 0) {
+		for (int i = 0; i < n; i++) {
+			out << batch[i].timestamp << "," << (int)batch[i].encoder << "," << batch[i].position << ","
+				<< batch[i].capturePeriod << "," << batch[i].captureTimer << "," << batch[i].status << "\n";
+		}
+	}
+}
 
 /*!
  * @brief Main controller loop
@@ -38,20 +117,33 @@
  * @param ki Integral constant for PID controller
  * @param kd Derivative constant for PID controller
  * @param dir Direction (0 or 1) that controller should operate in.
+ * @param opts command line options
  */
-void controller(double kp, double ki, double kd, int dir) {
-
-	std::cout << "Raise the pendulum" << std::endl;
+void controller(double kp, double ki, double kd, int dir, const runOptions& opts) {
+	bool pipeline = opts.pipeline;
 
 	// Variables that will be used to pass data to/from controller
-	double pendulumAngle = 0;
-	double pendulumAngleDeg = 0;
-	double pendulumVelocity =0;
-	double motorAngle = 0;
-	double motorAngleDeg = 0;
-	double motorVelocity =0;
-	double motorSpeed = 0;
-	double setAngle = 0;
+	controlSignals signals;
+
+	// Every controller is built in, pick the one to start with
+	controllers = new Controller::registry();
+	Controller::addBuiltinControllers(*controllers, &signals.state, &signals.motorSpeed, &signals.setAngle,
+									  &signals.cutoffAngle, kp, ki, kd, dir, Model::measuredParameters(), opts.weights,
+									  opts.design);
+	if (!controllers->select(controllers->find(opts.controller))) {
+		std::cout << "Unknown controller " << opts.controller << ", choose from: " << controllers->names() << std::endl;
+		delete controllers;
+		controllers = NULL;
+		return;
+	}
+
+	// The swing up controller raises the pendulum itself
+	bool swinging = (controllers->find(opts.controller) == controllers->find("swingup"));
+	if (!swinging) {
+		std::cout << "Raise the pendulum" << std::endl;
+	}
+
+	pendulumState state;
 	int setSpeed;
 
 	// Measure time in processing loop
@@ -63,120 +155,342 @@ void controller(double kp, double ki, double kd, int dir) {
 	now = std::chrono::high_resolution_clock::now();
 	timeChange = (now - lastTime);
 
-	// Create new EQEPs object to monitor the pendulum & motor position
-	threadedEQEP *pendulumEQEP = new threadedEQEP(PENDULUM_EQEP, ENCODER_PPR);
-	threadedEQEP *motorEQEP = new threadedEQEP(MOTOR_EQEP, MOTOR_PPR);
-
-	pendulumEQEP->setPriority(BlackLib::BlackThread::PriorityNORMAL);
-	motorEQEP->setPriority(BlackLib::BlackThread::PriorityNORMAL);
-
-	// Create a new controller
-#ifdef PENDULUM_CTRL_LQR
-	Controller::lqr *ctrl = new Controller::lqr(&pendulumAngle, &pendulumVelocity,
-										&motorAngle, &motorVelocity,
-										&motorSpeed, &setAngle,
-										-23.1455, 126.3112, -5.7435, 7.5213, // LQR constants
-										dir);
-#elif PENDULUM_CTRL_VELOCITY
-	Controller::velocity *ctrl = new Controller::velocity(&pendulumAngle,&pendulumVelocity, &motorSpeed, &setAngle, kp, ki, kd, dir);
-#else
-	Controller::basic *ctrl = new Controller::basic(&pendulumAngle, &motorSpeed, &setAngle, kp, ki, kd, dir);
-#endif
+	// Read the pendulum & motor position together and publish them to the controller
+	multiEQEP *encoders = new multiEQEP(pipeline ? SAMPLE_TIME : EQEP_SAMPLE_MS);
+	int pendulumEQEP = encoders->addEncoder(PENDULUM_EQEP, ENCODER_PPR);
+	int motorEQEP = encoders->addEncoder(MOTOR_EQEP, MOTOR_PPR);
+	encoders->bindState(&signals.state, pendulumEQEP, motorEQEP);
 
 	// Create a Simple Motor Controller object
-	Pololu::SMC *SMC = new Pololu::SMC(POLOLU_TTY);
+	Pololu::SMC *SMC = new Pololu::SMC(opts.smcTTY.c_str(), opts.baud, opts.crc);
 	// Stop the motor
 	SMC->SetTargetSpeed(0);
-
-	// Start the EQEP threads running
-	pendulumEQEP->run();
-	motorEQEP->run();
+	// The main loop posts a speed each control period, only the newest is written.
+	// The pipeline writes once per tick from the control thread instead.
+	Pololu::commandChannel *motor = pipeline ? NULL : new Pololu::commandChannel(SMC);
+	// The channel polls the SMC between speed commands
+	Pololu::telemetryPoller *telemetry = NULL;
+	if (motor != NULL && opts.telemetryMs > 0) {
+		telemetry = new Pololu::telemetryPoller(opts.telemetryMs, Pololu::TELEMETRY_DEPTH, opts.pollCurrent);
+		motor->setTelemetry(telemetry);
+	}
 
 	// Wait until the pendulum is @ 180 +-1 deg
 	// Assumes pendulum starts hanging vertically down
-	while (abs(pendulumEQEP->getAngleDeg()) < 179 || abs(pendulumEQEP->getAngleDeg() > 181))  {
-		std::cout << pendulumEQEP->getAngleDeg() << "\r" << std::flush;
-	}
+	double angle;
+	do {
+		encoders->sample();
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		angle = encoders->getAngleDeg(pendulumEQEP);
+		std::cout << angle << "\r" << std::flush;
+	} while (!swinging && (std::abs(angle) < 179 || std::abs(angle) > 181));
 
 	// Set controller parameters
-	ctrl->SetOutputLimits(-3200.0,3200.0);
-	ctrl->SetSampleTime(20); // sample time in milliseconds
-	ctrl->SetMode(1); // Automatic
+	controllers->SetOutputLimits(-3200.0,3200.0);
+	controllers->SetSampleTime(SAMPLE_TIME); // sample time in milliseconds
+	controllers->SetTransferTicks(TRANSFER_TIME / SAMPLE_TIME); // blend outputs when switched
+	controllers->SetSupplyVoltage(opts.supplyVoltage);
+
+	// LQR gains can be redesigned while running, SIGUSR2 reloads the weights
+	Controller::lqrTuner *tuner = new Controller::lqrTuner(controllers->get(controllers->find("lqr")));
+
+	// Controller is run by the scheduler on exact sample period boundaries
+	periodicScheduler *scheduler = new periodicScheduler();
+	scheduler->setPriority(BlackLib::BlackThread::PriorityHIGHEST);
+	controlPipeline *fused = NULL;
+	int ctrlTask;
+	if (pipeline) {
+		fused = new controlPipeline(encoders, controllers, SMC, &signals);
+		ctrlTask = scheduler->addTask(fused, SAMPLE_TIME);
+	} else {
+		// Encoders first so a controller tick on the same deadline sees the new sample
+		scheduler->addTask(encoders, EQEP_SAMPLE_MS);
+		ctrlTask = scheduler->addTask(controllers, SAMPLE_TIME);
+	}
 
-	std::cout << ctrl->name() << " controller running ...." << std::endl;
+	int shown = controllers->active();
+	std::cout << controllers->get(shown)->name() << " controller running" << (pipeline ? " (pipeline)" : "")
+			  << ", SIGUSR1 switches controller ...." << std::endl;
 
 	// Reset pendulum position to make vertical zero
-	pendulumEQEP->setPosition(180-abs(pendulumEQEP->getAngleDeg()));
-	motorEQEP->setPosition(0);
+	if (swinging) {
+		encoders->setDeg(pendulumEQEP, 180 + angle);	// still hanging down
+	} else {
+		encoders->setPosition(pendulumEQEP, 180-std::abs(angle));
+	}
+	encoders->setPosition(motorEQEP, 0);
+	// Start the controllers from the zeroed angles, the estimate can't follow a half turn jump
+	encoders->sample();
+	controllers->SetMode(1); // Automatic
+
+	// Latch the encoders in hardware just before each tick
+	if (opts.unitTimer) {
+		encoders->setUnitTimerSampling();
+	}
+
+	// Raw sample history is filled by the scheduler thread and written out here
+	rawSampleRing *rawRing = NULL;
+	std::ofstream rawFile;
+	if (opts.rawLog) {
+		rawFile.open("eqep_raw.csv");
+		rawFile << "timestamp_ns,encoder,position,capture_period,capture_timer,status\n";
+		rawRing = new rawSampleRing();
+		encoders->setRawLog(rawRing);
+	}
 
 	// start the controller thread
-	ctrl->run();
+	std::signal(SIGUSR1, nextController);
+	std::signal(SIGUSR2, requestWeights);
+	scheduler->run();
+	tuner->run();
+	if (motor != NULL) {
+		motor->setPriority(BlackLib::BlackThread::PriorityHIGH);
+		motor->run();
+	}
 	start = lastTime = std::chrono::high_resolution_clock::now();
+	// Without the pipeline the main loop posts the motor command once per control period
+	struct timespec nextTick;
+	clock_gettime(CLOCK_MONOTONIC, &nextTick);
+	int statusTicks = 0;
 
 	// Let the threads run for about 90 seconds
 	do {
 		now = std::chrono::high_resolution_clock::now();
 		timeChange = (now - lastTime);
-		// Get pendulum angle and velocity
-		pendulumAngle = pendulumEQEP->getAngle();
-		pendulumAngleDeg = pendulumAngle * 180 / M_PI; // convert radian to degrees
-		pendulumVelocity = pendulumEQEP->getVelocity();
-		// Get motor angle and velocity
-		motorAngle = motorEQEP->getAngle();
-		motorAngleDeg = motorAngle * 180 / M_PI; // convert radian to degrees
-		motorVelocity = motorEQEP->getVelocity();
-
-		// Motor doesn't move unless speed > 350
-		setSpeed = ( motorSpeed > 0 ? 1 : -1) * 350 + (int)motorSpeed;
-		if (setSpeed > 3200) {
-			setSpeed = 3200;
-		} else if (setSpeed < -3200) {
-			setSpeed = -3200;
+		if (pipeline) {
+			// Controller thread does all the work, just report on it
+			std::cout << "setSpeed: " << fused->getSetSpeed() << " latency: "
+					  << fused->getLastLatency() / 1000 << "us   \r" << std::flush;
+			std::this_thread::sleep_for(std::chrono::milliseconds(STATUS_TIME));
+		} else {
+			// Encoders are published to the controller by the scheduler
+			state = signals.state.read();
+
+			setSpeed = motorCommand(signals.motorSpeed.load(), state.pAngle * 180 / M_PI, signals.cutoffAngle.load());
+			motor->post(setSpeed);
+
+			if (--statusTicks <= 0) {
+				statusTicks = STATUS_TIME / SAMPLE_TIME;
+				std::cout << "setSpeed: " << setSpeed;
+				Pololu::smcTelemetry smcState;
+				if (telemetry != NULL && telemetry->read(smcState) > 0) {
+					std::cout << " VIN: " << smcState.vin / 1000.0 << "V " << smcState.temperature / 10.0 << "C";
+					if (smcState.errorStatus != 0) {
+						std::cout << " SMC errors: 0x" << std::hex << smcState.errorStatus << std::dec;
+					}
+				}
+				std::cout << "   \r" << std::flush;
+			}
+
+			// The controller produces one output per period, leave the CPU to it and the writer until the next
+			timespecAdd(nextTick, (int64_t)SAMPLE_TIME * 1000000);
+			struct timespec current;
+			clock_gettime(CLOCK_MONOTONIC, &current);
+			if (timespecDiff(current, nextTick) > 0) {
+				nextTick = current;	// fell behind, don't post a burst to catch up
+			}
+			while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &nextTick, NULL) == EINTR) {
+			}
 		}
 
-		std::cout << "setSpeed: " << setSpeed << "\r" << std::flush;
+		if (rawRing != NULL) {
+			drainRawLog(rawRing, rawFile);
+		}
 
-		// stop the motor if we deviate too far from vertical
-		SMC->SetTargetSpeed( ((abs(pendulumAngleDeg) > 30) ? 0 : setSpeed) );
+		if (reloadWeights) {
+			reloadWeights = 0;
+			std::ifstream file(LQR_WEIGHTS_FILE);
+			std::stringstream text;
+			text << file.rdbuf();
+			Model::lqrWeights weights;
+			if (parseWeights(text.str(), weights)) {
+				tuner->request(weights);
+				std::cout << std::endl << "Redesigning LQR gains" << std::endl;
+			} else {
+				std::cout << std::endl << "Could not read q1 q2 q3 q4 r from " << LQR_WEIGHTS_FILE << std::endl;
+			}
+		}
+
+		if (controllers->active() != shown) {
+			shown = controllers->active();
+			std::cout << std::endl << "Switched to " << controllers->get(shown)->name() << " controller" << std::endl;
+		}
 
 		lastTime = now;
 		runTime = (now - start);
 	} while (runTime.count() < 90);
 
+	scheduler->stop();
+	WAIT_THREAD_FINISH(scheduler);
+	if (motor != NULL) {
+		motor->postStop();
+		motor->stop();
+		WAIT_THREAD_FINISH(motor);
+		Pololu::channelStats sent = motor->getStats();
+		std::cout << std::endl << "Motor commands posted " << sent.posted << ", sent " << sent.sent
+				  << ", superseded " << sent.superseded << std::endl;
+		delete motor;
+	}
+	if (telemetry != NULL) {
+		Pololu::telemetryStats polled = telemetry->getStats();
+		std::cout << "SMC telemetry rounds " << polled.rounds << ", " << polled.timeouts << " timeouts, "
+				  << polled.strays << " stray bytes" << std::endl;
+		if (polled.dropped & Pololu::TELEMETRY_CURRENT) {
+			std::cout << "SMC doesn't report motor current, try --no-current" << std::endl;
+		}
+		delete telemetry;
+	}
+	if (opts.crc) {
+		// The SMC ignores a command whose CRC doesn't match and records it
+		int serialErrors = SMC->GetSerialErrors();
+		if (serialErrors != (int)Pololu::SERIAL_ERROR && (serialErrors & Pololu::ERR_CRC)) {
+			std::cout << "SMC rejected corrupted commands" << std::endl;
+		}
+	}
+	std::signal(SIGUSR1, SIG_DFL);
+	std::signal(SIGUSR2, SIG_DFL);
+	tuner->stop();
+	WAIT_THREAD_FINISH(tuner);
+	if (tuner->designs() + tuner->failures() > 0) {
+		std::cout << "LQR redesigned " << tuner->designs() << " times, " << tuner->failures() << " failed" << std::endl;
+	}
+	delete tuner;
 	SMC->SetTargetSpeed(0);
-	ctrl->stop();
-	pendulumEQEP->stop();
-	motorEQEP->stop();
 
-	// Don't quit until all threads are finished
-	WAIT_THREAD_FINISH(ctrl);
-	WAIT_THREAD_FINISH(pendulumEQEP);
-	WAIT_THREAD_FINISH(motorEQEP);
+	latenessStats stats = scheduler->getStats(ctrlTask);
+	std::cout << std::endl << controllers->get(controllers->active())->name() << " ran " << stats.ticks << " times, "
+			  << stats.overruns << " overruns, wakeup lateness (us) min/mean/max: "
+			  << stats.min / 1000.0 << "/" << stats.mean / 1000.0 << "/" << stats.max / 1000.0 << std::endl;
+	if (controllers->switches() > 0) {
+		std::cout << "Controller switched " << controllers->switches() << " times" << std::endl;
+	}
+	for (int id = 0; id < controllers->size(); id++) {
+		const latencyHistogram& steps = controllers->get(id)->GetStepTimes();
+		if (steps.samples() > 0) {
+			std::cout << controllers->get(id)->name() << " step time (us) p50/p90/p99/max: "
+					  << steps.percentile(0.5) / 1000.0 << "/" << steps.percentile(0.9) / 1000.0 << "/"
+					  << steps.percentile(0.99) / 1000.0 << "/" << steps.max() / 1000.0
+					  << " over " << steps.samples() << " ticks" << std::endl;
+		}
+	}
+	velocityNoise noise = encoders->getVelocityNoise(pendulumEQEP);
+	std::cout << "Pendulum velocity noise (rad/s) difference: " << sqrt(noise.differenceVariance)
+			  << " capture: " << sqrt(noise.captureVariance) << ", using "
+			  << (noise.active == velocityEstimator::Capture ? "capture" : "difference")
+			  << " (" << noise.switches << " switches)" << std::endl;
+	if (pipeline) {
+		stats = fused->getLatencyStats();
+		std::cout << "Encoder to motor latency (us) min/mean/max: "
+				  << stats.min / 1000.0 << "/" << stats.mean / 1000.0 << "/" << stats.max / 1000.0
+				  << ", " << stats.overruns << " ticks over period" << std::endl;
+		delete fused;
+	}
 
-	delete ctrl;
-	delete pendulumEQEP;
-	delete motorEQEP;
+	delete scheduler;
+	delete controllers;
+	controllers = NULL;
+	if (rawRing != NULL) {
+		drainRawLog(rawRing, rawFile);
+		std::cout << "Raw encoder samples dropped: " << rawRing->dropped() << std::endl;
+		encoders->setRawLog(NULL);
+		delete rawRing;
+	}
+	delete encoders;
 
 	SMC->SetTargetSpeed(0);
 	std::cout << "Done!" << std::endl;
 	return;
 }
 
+/*!
+ * @brief Remove a command line option with a value from args
+ *
+ * @param args command line arguments
+ * @param option option to look for including the =, eg: --controller=
+ * @param value value to use if the option is not present
+ * @return Value of the option
+ */
+std::string takeValue(std::vector<std::string>& args, const std::string& option, const std::string& value) {
+	for (std::vector<std::string>::iterator opt = args.begin(); opt != args.end(); ++opt) {
+		if (opt->compare(0, option.size(), option) == 0) {
+			std::string found = opt->substr(option.size());
+			args.erase(opt);
+			return found;
+		}
+	}
+	return value;
+}
+
+/*!
+ * @brief Remove a command line option from args
+ *
+ * @param args command line arguments
+ * @param option option to look for, eg: --pipeline
+ * @return True if the option was present
+ */
+bool takeOption(std::vector<std::string>& args, const std::string& option) {
+	std::vector<std::string>::iterator opt = std::find(args.begin(), args.end(), option);
+	if (opt == args.end()) {
+		return false;
+	}
+	args.erase(opt);
+	return true;
+}
+
 int main(int argc, char const *argv[]) {
 	std::vector<std::string> args(argv +1, argv + argc);
 
-	std::cout << "Checking overlays are loaded... \n" << std::flush;
+	runOptions opts;
+	// --pipeline runs sense, compute and actuate on one thread
+	opts.pipeline = takeOption(args, "--pipeline");
+	// --unit-timer latches both encoders on the eQEP unit timer
+	opts.unitTimer = takeOption(args, "--unit-timer");
+	// --raw-log writes every raw encoder sample to eqep_raw.csv
+	opts.rawLog = takeOption(args, "--raw-log");
+	// --controller=NAME picks the control law to start with, eg: --controller=lqr
+	opts.controller = takeValue(args, "--controller=", "basic");
+	// --supply=VOLTS is the motor supply voltage
+	opts.supplyVoltage = atof(takeValue(args, "--supply=", "0").c_str());
+	if (opts.supplyVoltage <= 0) {
+		opts.supplyVoltage = Controller::SUPPLY_VOLTAGE;
+	}
+	// --smc-tty=PATH talks to the SMC on another tty, eg: the pty bench/rig_sim prints
+	opts.smcTTY = takeValue(args, "--smc-tty=", POLOLU_TTY);
+	// --baud=RATE is the SMC serial baud rate, up to 115200
+	opts.baud = atoi(takeValue(args, "--baud=", std::to_string(Pololu::SMC_DEFAULT_BAUD)).c_str());
+	// --crc appends a CRC-7 byte to every SMC command, CRC must be enabled on the SMC too
+	opts.crc = takeOption(args, "--crc");
+	// --telemetry=MS polls the SMC's status, voltage and temperature every MS milliseconds, 0 for never
+	opts.telemetryMs = atoi(takeValue(args, "--telemetry=", std::to_string(Pololu::TELEMETRY_PERIOD_MS)).c_str());
+	// --no-current leaves motor current out of the telemetry, for firmware that doesn't measure it
+	opts.pollCurrent = !takeOption(args, "--no-current");
+	// --design designs the LQR gains from the model instead of using the tuned gains
+	opts.design = takeOption(args, "--design");
+	// --lqr-weights=q1,q2,q3,q4,r sets the LQR design weights, implies --design
+	std::string weights = takeValue(args, "--lqr-weights=", "");
+	if (!weights.empty() && !parseWeights(weights, opts.weights)) {
+		std::cout << "--lqr-weights needs five numbers: q1,q2,q3,q4,r" << std::endl;
+		return 0;
+	}
+	opts.design = opts.design || !weights.empty();
 
-	if (checkOverlays()) {
-		std::cout << "OK" << std::endl;
+	// Encoders backed by a simulator (BBB_EQEP_MEM) don't need the overlays
+	if (BBB::eQEP::memoryBackend() != EQEP_MEM_DEVMEM) {
+		std::cout << "Using simulated eQEPs from " << BBB::eQEP::memoryBackend() << std::endl;
 	} else {
-		return 0;
+		std::cout << "Checking overlays are loaded... \n" << std::flush;
+
+		if (checkOverlays()) {
+			std::cout << "OK" << std::endl;
+		} else {
+			return 0;
+		}
 	}
 
 	if (args.size() == 4) {
-		controller(atof(args[0].c_str()), atof(args[1].c_str()), atof(args[2].c_str()), atoi(args[3].c_str()));
+		controller(atof(args[0].c_str()), atof(args[1].c_str()), atof(args[2].c_str()), atoi(args[3].c_str()), opts);
 	} else {
-		controller(1,0,0,0);
+		controller(1,0,0,0, opts);
 	}
 
 	return 0;
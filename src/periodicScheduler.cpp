@@ -0,0 +1,167 @@
+/**
+ *! @file periodicScheduler.cpp
+ *! Absolute deadline periodic task scheduler
+ *!
+ *! @author Troy Dack
+ *! @date Copyright (C) 2015
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ **/
+
+#include <periodicScheduler.h>
+#include <errno.h>
+#include <limits>
+
+const int64_t NSEC_PER_SEC = 1000000000LL;
+
+void timespecAdd(struct timespec& ts, int64_t ns) {
+	ns += ts.tv_nsec;
+	ts.tv_sec += ns / NSEC_PER_SEC;
+	ts.tv_nsec = ns % NSEC_PER_SEC;
+	if (ts.tv_nsec < 0) {
+		ts.tv_sec--;
+		ts.tv_nsec += NSEC_PER_SEC;
+	}
+}
+
+int64_t timespecDiff(const struct timespec& a, const struct timespec& b) {
+	return (int64_t)(a.tv_sec - b.tv_sec) * NSEC_PER_SEC + (a.tv_nsec - b.tv_nsec);
+}
+
+uint64_t monotonicNow() {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t)now.tv_sec * NSEC_PER_SEC + now.tv_nsec;
+}
+
+periodicScheduler::periodicScheduler()
+	: bExit(false)
+	, nTasks(0)
+{
+}
+
+int periodicScheduler::addTask(periodicTask* task, int periodMs) {
+	return addTaskNs(task, (int64_t)periodMs * 1000000LL);
+}
+
+int periodicScheduler::addTaskNs(periodicTask* task, int64_t period_ns) {
+	if (nTasks >= MAX_TASKS || task == NULL || period_ns <= 0) {
+		return -1;
+	}
+	if (isRunning()) {
+		return -1;
+	}
+	entry& e = tasks[nTasks];
+	e.task = task;
+	e.period = period_ns;
+	e.ticks.store(0);
+	e.overruns.store(0);
+	e.last.store(0);
+	e.min.store(std::numeric_limits<int64_t>::max());
+	e.max.store(0);
+	e.total.store(0);
+	return nTasks++;
+}
+
+void periodicScheduler::record(entry& e, int64_t lateness) {
+	// Only the scheduler thread writes these, so relaxed load/store pairs are enough
+	e.last.store(lateness, std::memory_order_relaxed);
+	if (lateness < e.min.load(std::memory_order_relaxed)) {
+		e.min.store(lateness, std::memory_order_relaxed);
+	}
+	if (lateness > e.max.load(std::memory_order_relaxed)) {
+		e.max.store(lateness, std::memory_order_relaxed);
+	}
+	e.total.store(e.total.load(std::memory_order_relaxed) + lateness, std::memory_order_relaxed);
+	e.ticks.store(e.ticks.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+/**
+ * onStartHandler - main thread routine.
+ *
+ * Sleeps until the earliest deadline of all registered tasks, runs that task
+ * then advances its deadline by exactly one period.
+ */
+void periodicScheduler::onStartHandler() {
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	for (int i = 0; i < nTasks; i++) {
+		tasks[i].next = now;
+		timespecAdd(tasks[i].next, tasks[i].period);
+	}
+
+	while (!bExit.load() && nTasks > 0) {
+		// Find the task with the earliest deadline
+		int idx = 0;
+		for (int i = 1; i < nTasks; i++) {
+			if (timespecDiff(tasks[i].next, tasks[idx].next) < 0) {
+				idx = i;
+			}
+		}
+		entry& e = tasks[idx];
+
+		while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &e.next, NULL) == EINTR) {
+			if (bExit.load()) {
+				return;
+			}
+		}
+		clock_gettime(CLOCK_MONOTONIC, &now);
+
+		tickInfo info;
+		info.tick = e.ticks.load(std::memory_order_relaxed);
+		info.deadline = e.next;
+		info.lateness = timespecDiff(now, e.next);
+		info.dt = (double)e.period / NSEC_PER_SEC;
+
+		e.task->tick(info);
+		record(e, info.lateness);
+
+		// Advance to the next period boundary, skipping any we have already missed
+		timespecAdd(e.next, e.period);
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		while (timespecDiff(now, e.next) > 0) {
+			timespecAdd(e.next, e.period);
+			e.overruns.store(e.overruns.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+		}
+	}
+	return;
+}
+
+void periodicScheduler::stop() {
+	bExit.store(true);
+}
+
+latenessStats periodicScheduler::getStats(int id) {
+	latenessStats s = {0, 0, 0, 0, 0.0};
+	if (id < 0 || id >= nTasks) {
+		return s;
+	}
+	entry& e = tasks[id];
+	s.ticks = e.ticks.load(std::memory_order_acquire);
+	s.overruns = e.overruns.load();
+	s.min = (s.ticks > 0) ? e.min.load() : 0;
+	s.max = e.max.load();
+	s.mean = (s.ticks > 0) ? (double)e.total.load() / s.ticks : 0.0;
+	return s;
+}
+
+int64_t periodicScheduler::getLastLateness(int id) {
+	if (id < 0 || id >= nTasks) {
+		return 0;
+	}
+	return tasks[id].last.load();
+}
@@ -0,0 +1,77 @@
+/**
+ *! @file positionUnwrapper.cpp
+ *! 64 bit position count from the wrapping eQEP position counter
+ *!
+ *! @author Troy Dack
+ *! @date Copyright (C) 2015
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ **/
+
+#include <positionUnwrapper.h>
+
+positionUnwrapper::positionUnwrapper(uint32_t maxPosition)
+	: last(0)
+	, count(0)
+	, rollovers(0)
+{
+	setMaxPosition(maxPosition);
+}
+
+void positionUnwrapper::setMaxPosition(uint32_t maxPosition) {
+	modulus = (uint64_t)maxPosition + 1;
+	reset(count);
+}
+
+int64_t positionUnwrapper::update(uint32_t raw) {
+	// Shortest signed distance from last to raw on a circle of modulus counts
+	int64_t delta = ((int64_t)raw - (int64_t)last) % (int64_t)modulus;
+	if (delta >= (int64_t)(modulus / 2)) {
+		delta -= modulus;
+	} else if (delta < -(int64_t)(modulus / 2)) {
+		delta += modulus;
+	}
+	if (delta > 0 && raw < last) {
+		rollovers++;
+	} else if (delta < 0 && raw > last) {
+		rollovers--;
+	}
+	count += delta;
+	last = raw;
+	return count;
+}
+
+void positionUnwrapper::reset(int64_t position) {
+	count = position;
+	last = toRaw(position);
+	rollovers = 0;
+}
+
+uint32_t positionUnwrapper::toRaw(int64_t position) const {
+	int64_t raw = position % (int64_t)modulus;
+	if (raw < 0) {
+		raw += modulus;
+	}
+	return (uint32_t)raw;
+}
+
+int64_t positionUnwrapper::position() const {
+	return count;
+}
+
+int64_t positionUnwrapper::wraps() const {
+	return rollovers;
+}
@@ -0,0 +1,150 @@
+/**
+ *! @file velocityEstimator.cpp
+ *! Encoder velocity estimation from position difference and eQEP capture period
+ *!
+ *! @author Troy Dack
+ *! @date Copyright (C) 2015
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ **/
+
+#include <velocityEstimator.h>
+#include <bbb-eqep/bbb-eqep.h>
+#include <cmath>
+
+const double NOISE_ALPHA = 0.05;		// smoothing factor for the noise estimates
+const double CROSSOVER_HYSTERESIS = 0.2;	// +-20% band around the crossover speed
+
+velocityEstimator::velocityEstimator(double encoder_ppr, int upps, int ccps, double samplePeriod)
+	: ppr(encoder_ppr)
+	, countsPerEvent((double)(1 << upps))
+	, captureHz(EQEP_SYSCLK_HZ / (1 << ccps))
+	, current(Difference)
+	, first(true)
+	, lastDifference(0.0)
+	, lastCapture(0.0)
+	, selected(Auto)
+{
+	// Difference resolution is 1 count/samplePeriod, capture resolution at speed v
+	// is v^2/(captureHz * countsPerEvent).  They are equal at the crossover.
+	crossover = sqrt(captureHz * countsPerEvent / samplePeriod);
+	noise.active = current;
+	noise.differenceVariance = 0.0;
+	noise.captureVariance = 0.0;
+	noise.switches = 0;
+	noise.captureErrors = 0;
+	published.publish(noise);
+}
+
+/**
+ * Velocity in counts/second from the capture period.  valid is set false if
+ * the capture unit can't give a usable value for this sample.
+ */
+double velocityEstimator::capture(const eqepSample& s, bool& valid) {
+	valid = true;
+	if (s.status & EQEP_QEPSTS_CDEF) {
+		// Direction changed between unit position events
+		valid = false;
+		return 0.0;
+	}
+	if (s.status & EQEP_QEPSTS_COEF) {
+		// Capture timer overflowed, slower than we can measure
+		return 0.0;
+	}
+	// If it's been longer since the last event than the last period we're slowing down
+	uint16_t period = (s.captureTimer > s.capturePeriod) ? s.captureTimer : s.capturePeriod;
+	if (period == 0) {
+		valid = false;
+		return 0.0;
+	}
+	if (period == 0xFFFF) {
+		return 0.0;
+	}
+	double v = countsPerEvent * captureHz / period;
+	return (s.status & EQEP_QEPSTS_QDF) ? v : -v;
+}
+
+double velocityEstimator::update(const eqepSample& s) {
+	if (first) {
+		last = s;
+		first = false;
+		return 0.0;
+	}
+
+	double scale = 2.0 * M_PI / ppr; // counts to radians
+	double dt = (s.timestamp - last.timestamp) / 1e9;
+	int delta = (int)(s.position - last.position);
+
+	double vDifference = (dt > 0) ? delta / dt * scale : lastDifference;
+	bool valid;
+	double vCapture = capture(s, valid) * scale;
+	if (!valid) {
+		noise.captureErrors++;
+		vCapture = vDifference;
+	}
+
+	// Update noise estimates for both, whichever is in use
+	double d = vDifference - lastDifference;
+	noise.differenceVariance += NOISE_ALPHA * (d * d / 2 - noise.differenceVariance);
+	d = vCapture - lastCapture;
+	noise.captureVariance += NOISE_ALPHA * (d * d / 2 - noise.captureVariance);
+
+	// Choose the estimator to use
+	int next = selected.load(std::memory_order_relaxed);
+	if (next == Auto) {
+		double speed = fabs(vDifference) / scale;
+		next = current;
+		if (current == Capture && speed > crossover * (1 + CROSSOVER_HYSTERESIS)) {
+			next = Difference;
+		} else if (current == Difference && speed < crossover * (1 - CROSSOVER_HYSTERESIS)) {
+			next = Capture;
+		}
+		if (next != current) {
+			noise.switches++;
+		}
+	}
+	current = next;
+	noise.active = current;
+	published.publish(noise);
+
+	last = s;
+	lastDifference = vDifference;
+	lastCapture = vCapture;
+
+	return (current == Capture) ? vCapture : vDifference;
+}
+
+void velocityEstimator::reset() {
+	first = true;
+	lastDifference = 0.0;
+	lastCapture = 0.0;
+}
+
+void velocityEstimator::setMode(mode m) {
+	selected.store(m);
+}
+
+velocityEstimator::mode velocityEstimator::getMode() {
+	return (mode)selected.load();
+}
+
+void velocityEstimator::setCrossover(double countsPerSecond) {
+	crossover = countsPerSecond;
+}
+
+velocityNoise velocityEstimator::getNoise() {
+	return published.read();
+}